@@ -0,0 +1,42 @@
+#!/bin/bash
+#
+# ./deterministic.sh <boardsize> <playouts> <threads> <moves> <runs>
+#
+# Check that a deterministic search (thread_deterministic) plays the same
+# moves, with the same statistics, every run.
+#
+
+GTP="boardsize $1
+clear_board
+param rand_seed 5
+param thread_count $3
+param thread_deterministic 1
+param playouts_per_move $2"
+
+for i in `seq 1 $4`; do
+  if (( $i % 2 )); then
+    GTP="$GTP
+genmove b"
+  else
+    GTP="$GTP
+genmove w"
+  fi
+done
+
+echo "Running $5 deterministic searches of $4 moves for $3 threads on $1x$1 (plts:$2)"
+
+FIRST=""
+for j in `seq 1 $5`; do
+  # the playout rate is the only part of the output that depends on timing
+  RESULT=`echo -e "$GTP" | ./oakfoam --nobook 2>&1 | grep '^\[genmove\]\|^= [a-zA-Z]' | sed 's/ppms:[0-9.]* //'`
+  MOVES=`echo "$RESULT" | sed -n 's/^= //p' | tr '\n' ' '`
+  echo -e "$j:\t$MOVES"
+  if [ -z "$FIRST" ]; then
+    FIRST="$RESULT"
+  elif [ "$RESULT" != "$FIRST" ]; then
+    echo "Search differs from the first run" >&2
+    exit 1
+  fi
+done
+
+echo "All runs were identical"
@@ -6,30 +6,68 @@
 Benson::Benson(Go::Board *bd)
   : board(bd),
     size(board->getSize()),
-    safepositions(new Go::ObjectBoard<Go::Color>(size))
+    safepositions(new Go::ObjectBoard<Go::Color>(size)),
+    usedflags(new Go::BitBoard(size))
 {
   safepositions->fill(Go::EMPTY);
 }
 
 Benson::~Benson()
 {
+  freechains.splice(freechains.end(),blackchains);
+  freechains.splice(freechains.end(),whitechains);
+  freeregions.splice(freeregions.end(),blackregions);
+  freeregions.splice(freeregions.end(),whiteregions);
   delete safepositions;
-  for(std::list<Benson::Chain*>::iterator iter=blackchains.begin();iter!=blackchains.end();++iter) 
-  {
-    delete (*iter);
-  }
-  for(std::list<Benson::Chain*>::iterator iter=whitechains.begin();iter!=whitechains.end();++iter) 
+  delete usedflags;
+  for(std::list<Benson::Chain*>::iterator iter=freechains.begin();iter!=freechains.end();++iter) 
   {
     delete (*iter);
   }
-  for(std::list<Benson::Region*>::iterator iter=blackregions.begin();iter!=blackregions.end();++iter) 
+  for(std::list<Benson::Region*>::iterator iter=freeregions.begin();iter!=freeregions.end();++iter) 
   {
     delete (*iter);
   }
-  for(std::list<Benson::Region*>::iterator iter=whiteregions.begin();iter!=whiteregions.end();++iter) 
+}
+
+void Benson::reset(Go::Board *bd)
+{
+  board=bd;
+  if (board->getSize()!=size)
   {
-    delete (*iter);
+    size=board->getSize();
+    delete safepositions;
+    delete usedflags;
+    safepositions=new Go::ObjectBoard<Go::Color>(size);
+    usedflags=new Go::BitBoard(size);
   }
+  safepositions->fill(Go::EMPTY);
+  
+  freechains.splice(freechains.end(),blackchains);
+  freechains.splice(freechains.end(),whitechains);
+  freeregions.splice(freeregions.end(),blackregions);
+  freeregions.splice(freeregions.end(),whiteregions);
+}
+
+Benson::Chain *Benson::addChain(std::list<Benson::Chain*> &chains)
+{
+  if (freechains.empty())
+    chains.push_back(new Benson::Chain());
+  else
+    chains.splice(chains.end(),freechains,freechains.begin());
+  return chains.back();
+}
+
+Benson::Region *Benson::addRegion(std::list<Benson::Region*> &regions)
+{
+  if (freeregions.empty())
+    regions.push_back(new Benson::Region());
+  else
+    regions.splice(regions.end(),freeregions,freeregions.begin());
+  Benson::Region *region=regions.back();
+  region->positions.clear();
+  region->adjpositions.clear();
+  return region;
 }
 
 void Benson::solve()
@@ -84,7 +122,7 @@ void Benson::solve()
   {
     if ((*iter)->isvital && !(*iter)->hasstones)
     {
-      for(std::list<int>::iterator iter2=(*iter)->positions.begin();iter2!=(*iter)->positions.end();++iter2) 
+      for(std::vector<int>::iterator iter2=(*iter)->positions.begin();iter2!=(*iter)->positions.end();++iter2) 
       {
         safepositions->set((*iter2),Go::BLACK);
       }
@@ -95,7 +133,7 @@ void Benson::solve()
   {
     if ((*iter)->isvital && !(*iter)->hasstones)
     {
-      for(std::list<int>::iterator iter2=(*iter)->positions.begin();iter2!=(*iter)->positions.end();++iter2) 
+      for(std::vector<int>::iterator iter2=(*iter)->positions.begin();iter2!=(*iter)->positions.end();++iter2) 
       {
         if (safepositions->get((*iter2))==Go::EMPTY)
           safepositions->set((*iter2),Go::WHITE);
@@ -108,19 +146,13 @@ void Benson::solve()
 
 void Benson::updateChainsAndRegions()
 {
-  Go::BitBoard *usedflags=new Go::BitBoard(size);
-  
-  std::ourset<Go::Group*> *allgroups=board->getGroups();
-  for(std::ourset<Go::Group*>::iterator iter=allgroups->begin();iter!=allgroups->end();++iter) 
+  Go::group_set *allgroups=board->getGroups();
+  for(Go::group_set::iterator iter=allgroups->begin();iter!=allgroups->end();++iter) 
   {
-    Benson::Chain *chain=new Benson::Chain();
+    Benson::Chain *chain=this->addChain((*iter)->getColor()==Go::BLACK?blackchains:whitechains);
     chain->group=(*iter);
     chain->col=(*iter)->getColor();
     chain->vitalregions=0;
-    if (chain->col==Go::BLACK)
-      blackchains.push_back(chain);
-    else
-      whitechains.push_back(chain);
   }
   
   usedflags->clear();
@@ -128,12 +160,11 @@ void Benson::updateChainsAndRegions()
   {
     if (!usedflags->get(p) && board->getColor(p)!=Go::BLACK && board->getColor(p)!=Go::OFFBOARD)
     {
-      Benson::Region *region=new Benson::Region();
+      Benson::Region *region=this->addRegion(blackregions);
       region->col=Go::BLACK;
       region->isvital=false;
       region->hasstones=false;
-      this->spreadRegion(region,p,usedflags);
-      blackregions.push_back(region);
+      this->spreadRegion(region,p);
     }
   }
   
@@ -142,19 +173,16 @@ void Benson::updateChainsAndRegions()
   {
     if (!usedflags->get(p) && board->getColor(p)!=Go::WHITE && board->getColor(p)!=Go::OFFBOARD)
     {
-      Benson::Region *region=new Benson::Region();
+      Benson::Region *region=this->addRegion(whiteregions);
       region->col=Go::WHITE;
       region->isvital=false;
       region->hasstones=false;
-      this->spreadRegion(region,p,usedflags);
-      whiteregions.push_back(region);
+      this->spreadRegion(region,p);
     }
   }
-  
-  delete usedflags;
 }
 
-void Benson::spreadRegion(Benson::Region *region, int pos, Go::BitBoard *usedflags)
+void Benson::spreadRegion(Benson::Region *region, int pos)
 {
   if (usedflags->get(pos))
     return;
@@ -168,7 +196,7 @@ void Benson::spreadRegion(Benson::Region *region, int pos, Go::BitBoard *usedfla
     if (board->getColor(p)==region->col)
       region->adjpositions.push_back(p);
     else if (board->getColor(p)!=Go::OFFBOARD)
-      this->spreadRegion(region,p,usedflags);
+      this->spreadRegion(region,p);
   });
 }
 
@@ -177,7 +205,7 @@ bool Benson::isVitalTo(Benson::Region *region, Benson::Chain *chain) const
   if (region->col!=chain->col)
     return false;
   
-  for(std::list<int>::iterator iter=region->positions.begin();iter!=region->positions.end();++iter) 
+  for(std::vector<int>::iterator iter=region->positions.begin();iter!=region->positions.end();++iter) 
   {
     if (board->getColor((*iter))==Go::EMPTY)
     {
@@ -235,8 +263,7 @@ bool Benson::removeNonVitalChains()
     {
       std::list<Benson::Chain*>::iterator tmpiter=iter;
       --iter;
-      delete (*tmpiter);
-      blackchains.erase(tmpiter);
+      freechains.splice(freechains.end(),blackchains,tmpiter);
       removed=true;
     }
     else
@@ -249,8 +276,7 @@ bool Benson::removeNonVitalChains()
     {
       std::list<Benson::Chain*>::iterator tmpiter=iter;
       --iter;
-      delete (*tmpiter);
-      whitechains.erase(tmpiter);
+      freechains.splice(freechains.end(),whitechains,tmpiter);
       removed=true;
     }
     else
@@ -267,7 +293,7 @@ bool Benson::removeNonSurroundedRegions()
   for(std::list<Benson::Region*>::iterator iter=blackregions.begin();iter!=blackregions.end();++iter) 
   {
     bool foundmissing=false;
-    for(std::list<int>::iterator iter2=(*iter)->adjpositions.begin();iter2!=(*iter)->adjpositions.end();++iter2) 
+    for(std::vector<int>::iterator iter2=(*iter)->adjpositions.begin();iter2!=(*iter)->adjpositions.end();++iter2) 
     {
       if (!board->inGroup((*iter2)))
       {
@@ -299,8 +325,7 @@ bool Benson::removeNonSurroundedRegions()
     {
       std::list<Benson::Region*>::iterator tmpiter=iter;
       --iter;
-      delete (*tmpiter);
-      blackregions.erase(tmpiter);
+      freeregions.splice(freeregions.end(),blackregions,tmpiter);
       removed=true;
     }
   }
@@ -308,7 +333,7 @@ bool Benson::removeNonSurroundedRegions()
   for(std::list<Benson::Region*>::iterator iter=whiteregions.begin();iter!=whiteregions.end();++iter) 
   {
     bool foundmissing=false;
-    for(std::list<int>::iterator iter2=(*iter)->adjpositions.begin();iter2!=(*iter)->adjpositions.end();++iter2) 
+    for(std::vector<int>::iterator iter2=(*iter)->adjpositions.begin();iter2!=(*iter)->adjpositions.end();++iter2) 
     {
       if (!board->inGroup((*iter2)))
       {
@@ -340,8 +365,7 @@ bool Benson::removeNonSurroundedRegions()
     {
       std::list<Benson::Region*>::iterator tmpiter=iter;
       --iter;
-      delete (*tmpiter);
-      whiteregions.erase(tmpiter);
+      freeregions.splice(freeregions.end(),whiteregions,tmpiter);
       removed=true;
     }
   }
@@ -3,6 +3,7 @@
 
 #include "Go.h"
 #include <list>
+#include <vector>
 
 /** Benson Algorithm.
  * Check a board for pass-safe stones.
@@ -14,15 +15,20 @@ public:
     Benson(Go::Board *bd);
     ~Benson();
     
+    /** Prepare to solve another board.
+     * The chains, regions and boards of the last solve are kept for reuse, so repeated solves don't allocate.
+     */
+    void reset(Go::Board *bd);
     /** Perform the Benson algorithm on the board. */
     void solve();
     /** Return the board positions that are safe for each color. */
     Go::ObjectBoard<Go::Color> *getSafePositions() const { return safepositions; };
   
   private:
-    Go::Board *const board;
-    const int size;
-    Go::ObjectBoard<Go::Color> *const safepositions;
+    Go::Board *board;
+    int size;
+    Go::ObjectBoard<Go::Color> *safepositions;
+    Go::BitBoard *usedflags;
     
     struct Chain
     {
@@ -34,17 +40,21 @@ public:
     struct Region
     {
       Go::Color col;
-      std::list<int> positions;
-      std::list<int> adjpositions;
+      std::vector<int> positions;
+      std::vector<int> adjpositions;
       bool isvital;
       bool hasstones;
     };
     
     std::list<Benson::Chain*> blackchains,whitechains;
     std::list<Benson::Region*> blackregions,whiteregions;
+    std::list<Benson::Chain*> freechains;
+    std::list<Benson::Region*> freeregions;
     
+    Benson::Chain *addChain(std::list<Benson::Chain*> &chains);
+    Benson::Region *addRegion(std::list<Benson::Region*> &regions);
     void updateChainsAndRegions();
-    void spreadRegion(Benson::Region *region, int pos, Go::BitBoard *usedflags);
+    void spreadRegion(Benson::Region *region, int pos);
     bool isVitalTo(Benson::Region *region, Benson::Chain *chain) const;
     void updateVitalRegions();
     bool removeNonVitalChains();
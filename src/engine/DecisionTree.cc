@@ -4,6 +4,7 @@
 #include <cmath>
 #include <fstream>
 #include <algorithm>
+#include <stdexcept>
 #include <boost/lexical_cast.hpp>
 #include "Parameters.h"
 #include "Engine.h"
@@ -12,6 +13,14 @@
 #define WHITESPACE " \t\r\n"
 #define COMMENT "#"
 
+#define NEW_B 1
+#define NEW_W 2
+#define NEW_S 4
+#define ATTR_SIZE 1
+#define ATTR_LIB 2
+//new stones found are all at the same distance, so at most two per column and the sides
+#define NEW_MAX_MATCHES (2*BOARDSIZE_MAX+4)
+
 DecisionTree::DecisionTree(Parameters *p, DecisionTree::Type t, std::vector<std::string> *a, DecisionTree::Node *r)
 {
   params = p;
@@ -19,6 +28,7 @@ DecisionTree::DecisionTree(Parameters *p, DecisionTree::Type t, std::vector<std:
   attrs = a;
   root = r;
   this->updateLeafIds();
+  this->compileProgram();
 }
 
 DecisionTree::~DecisionTree()
@@ -70,6 +80,14 @@ float DecisionTree::getWeight(Go::Board *board, Go::Move move, bool updatetree)
   if (!board->validMove(move) || !move.isNormal())
     return -1;
 
+  if (!updatetree && program.size()>0)
+  {
+    float w = this->getProgramWeight(board,move);
+    if (params->dt_program_check)
+      this->checkProgramWeight(board,move,w);
+    return w;
+  }
+
   std::list<DecisionTree::Node*> *nodes = this->getLeafNodes(board,move,updatetree);
   float w = -1;
   if (nodes != NULL)
@@ -568,6 +586,7 @@ bool DecisionTree::updateSparseNode(DecisionTree::Node *node, Go::Board *board,
           DecisionTree::Query *query = new DecisionTree::Query(type,bestlabel,bestattrs,maxnode);
           query->setParent(node);
           node->setQuery(query);
+          this->compileProgram();
 
           /*params->engine->getGtpEngine()->getOutput()->printfDebug("DT best stat: %s",bestlabel.c_str());
           for (unsigned int j=0; j<bestattrs->size(); j++)
@@ -998,6 +1017,411 @@ std::list<DecisionTree::Node*> *DecisionTree::getSparseLeafNodes(DecisionTree::N
   }
 }
 
+void DecisionTree::compileProgram()
+{
+  program.clear();
+
+  int start = -1;
+  try
+  {
+    switch (type)
+    {
+      case SPARSE:
+        start = this->compileNode(root,1);
+        break;
+    }
+  }
+  catch (boost::bad_lexical_cast &)
+  {
+    start = -1;
+  }
+  catch (std::out_of_range &)
+  {
+    start = -1;
+  }
+
+  //trees that can't be compiled are still walked node by node
+  if (start != 0)
+    program.clear();
+}
+
+int DecisionTree::compileNode(DecisionTree::Node *node, int stones)
+{
+  int pc = program.size();
+  DecisionTree::Instruction ins;
+  ins.leaf = NULL;
+  for (int i=0; i<4; i++)
+  {
+    ins.args[i] = 0;
+    ins.next[i] = -1;
+  }
+
+  if (node->isLeaf())
+  {
+    ins.op = OP_LEAF;
+    ins.leaf = node;
+    program.push_back(ins);
+    return pc;
+  }
+
+  DecisionTree::Query *q = node->getQuery();
+  std::vector<std::string> *attrs = q->getAttrs();
+  std::vector<DecisionTree::Option*> *options = q->getOptions();
+
+  if (q->getLabel() == "NEW")
+  {
+    if (stones >= DECISIONTREE_MAX_STONES)
+    {
+      fprintf(stderr,"[DT] Warning! Tree too deep to compile\n");
+      return -1;
+    }
+    ins.op = OP_NEW;
+    ins.args[0] = (attrs->at(0).find('B')!=std::string::npos?NEW_B:0) | (attrs->at(0).find('W')!=std::string::npos?NEW_W:0) | (attrs->at(0).find('S')!=std::string::npos?NEW_S:0);
+    ins.args[1] = boost::lexical_cast<int>(attrs->at(1));
+  }
+  else if (q->getLabel() == "DIST")
+  {
+    ins.op = OP_DIST;
+    ins.args[0] = boost::lexical_cast<int>(attrs->at(0));
+    ins.args[1] = boost::lexical_cast<int>(attrs->at(1));
+    ins.args[2] = (attrs->at(2) == "=");
+    ins.args[3] = boost::lexical_cast<int>(attrs->at(3));
+    if (ins.args[0]<0 || ins.args[0]>=stones || ins.args[1]<0 || ins.args[1]>=stones)
+      return -1;
+  }
+  else if (q->getLabel() == "ATTR")
+  {
+    ins.op = OP_ATTR;
+    ins.args[0] = (attrs->at(0)=="SIZE"?ATTR_SIZE:(attrs->at(0)=="LIB"?ATTR_LIB:0));
+    ins.args[1] = boost::lexical_cast<int>(attrs->at(1));
+    ins.args[2] = (attrs->at(2) == "=");
+    ins.args[3] = boost::lexical_cast<int>(attrs->at(3));
+    if (ins.args[1]<0 || ins.args[1]>=stones)
+      return -1;
+  }
+  else
+    return -1;
+
+  program.push_back(ins);
+
+  //options are picked in the same order as getSparseLeafNodes()
+  for (unsigned int i=0; i<options->size(); i++)
+  {
+    std::string l = options->at(i)->getLabel();
+    int n = -1;
+    int s = stones;
+    if (ins.op == OP_NEW)
+    {
+      if (l=="B")
+        n = NEXT_B;
+      else if (l=="W")
+        n = NEXT_W;
+      else if (l=="S")
+        n = NEXT_S;
+      else if (l=="N" && program[pc].next[NEXT_N]==-1)
+        n = NEXT_N;
+      if (n!=-1 && n!=NEXT_N)
+        s++;
+    }
+    else
+    {
+      if (l=="Y" && program[pc].next[NEXT_Y]==-1)
+        n = NEXT_Y;
+      else if (l=="N" && program[pc].next[NEXT_N]==-1)
+        n = NEXT_N;
+    }
+    if (n == -1)
+      continue;
+
+    int next = this->compileNode(options->at(i)->getNode(),s);
+    if (next == -1)
+      return -1;
+    program[pc].next[n] = next;
+  }
+
+  return pc;
+}
+
+float DecisionTree::getProgramWeight(Go::Board *board, Go::Move move)
+{
+  int stones[DECISIONTREE_MAX_STONES];
+  bool invert = (move.getColor() != Go::BLACK);
+  stones[0] = move.getPosition();
+
+  DecisionTree::ProgramResult res;
+  res.weight = 1;
+  res.minid = -1;
+  res.minleaf = NULL;
+  if (!this->runProgram(0,board,stones,1,invert,res))
+    return -1;
+
+  if (params->dt_solo_leaf)
+    return res.minleaf->getWeight();
+  else
+    return res.weight;
+}
+
+void DecisionTree::checkProgramWeight(Go::Board *board, Go::Move move, float weight)
+{
+  std::list<DecisionTree::Node*> *nodes = this->getLeafNodes(board,move,false);
+  float w = -1;
+  if (nodes != NULL)
+  {
+    w = DecisionTree::combineNodeWeights(nodes);
+    delete nodes;
+  }
+
+  if (w != weight)
+    fprintf(stderr,"[dt] compiled weight differs for %s: %f (tree: %f)\n",move.toString(board->getSize()).c_str(),weight,w);
+}
+
+bool DecisionTree::runProgram(int pc, Go::Board *board, int *stones, int numstones, bool invert, DecisionTree::ProgramResult &res)
+{
+  while (true)
+  {
+    DecisionTree::Instruction *ins = &program[pc];
+    switch (ins->op)
+    {
+      case OP_LEAF:
+        {
+          //leaves are reached in the same order as the list of getLeafNodes()
+          DecisionTree::Node *leaf = ins->leaf;
+          int id = leaf->getLeafId();
+          res.weight *= leaf->getWeight();
+          if (res.minid==-1 || id<res.minid)
+          {
+            res.minleaf = leaf;
+            res.minid = id;
+          }
+          return true;
+        }
+      case OP_NEW:
+        {
+          int matches[NEW_MAX_MATCHES];
+          int nummatches = this->findNewStones(ins,board,stones,numstones,invert,matches);
+          if (nummatches == 0)
+          {
+            pc = ins->next[NEXT_N];
+            break;
+          }
+
+          //getSparseLeafNodes() puts the leaves of later matches first
+          for (int i=nummatches-1; i>=0; i--)
+          {
+            int p = matches[i];
+            int next;
+            if (p < 0) // side
+              next = ins->next[NEXT_S];
+            else if ((board->getColor(p)==Go::BLACK) != invert)
+              next = ins->next[NEXT_B];
+            else
+              next = ins->next[NEXT_W];
+            if (next == -1)
+              return false;
+
+            stones[numstones] = p;
+            if (!this->runProgram(next,board,stones,numstones+1,invert,res))
+              return false;
+          }
+          return true;
+        }
+      case OP_DIST:
+        {
+          int dist = DecisionTree::getDistance(board,stones[ins->args[0]],stones[ins->args[1]]);
+          bool r = (ins->args[2] ? dist==ins->args[3] : dist<ins->args[3]);
+          pc = ins->next[r?NEXT_Y:NEXT_N];
+          break;
+        }
+      case OP_ATTR:
+        {
+          int p = stones[ins->args[1]];
+          int attr = 0;
+          if (p>=0 && board->inGroup(p))
+          {
+            if (ins->args[0] == ATTR_SIZE)
+              attr = board->getGroup(p)->numOfStones();
+            else if (ins->args[0] == ATTR_LIB)
+              attr = (board->getGroup(p)->inAtari() ? 1 : board->getGroup(p)->numOfPseudoLiberties());
+          }
+          bool r = (ins->args[2] ? attr==ins->args[3] : attr<ins->args[3]);
+          pc = ins->next[r?NEXT_Y:NEXT_N];
+          break;
+        }
+    }
+
+    if (pc == -1)
+      return false;
+  }
+}
+
+int DecisionTree::findNewStones(DecisionTree::Instruction *ins, Go::Board *board, int *stones, int numstones, bool invert, int *matches)
+{
+  int center = stones[0];
+  int size = board->getSize();
+  bool B = (ins->args[0] & NEW_B);
+  bool W = (ins->args[0] & NEW_W);
+  bool S = (ins->args[0] & NEW_S);
+  int mindist = ins->args[1];
+  int n = 0;
+
+  //keep the closest new stones, in the order getSparseLeafNodes() finds them
+  if (B || W)
+  {
+    bool black = (invert?W:B);
+    bool white = (invert?B:W);
+    for (int i=0; i<size; i++)
+    {
+      for (int j=0; j<size; j++)
+      {
+        int p = Go::Position::xy2pos(i,j,size);
+        Go::Color col = board->getColor(p);
+        if ((black && col==Go::BLACK) || (white && col==Go::WHITE))
+        {
+          int dist = DecisionTree::getDistance(board,center,p);
+          if (dist > mindist)
+            continue;
+          bool found = false;
+          for (int k=0; k<numstones; k++)
+          {
+            if (stones[k] == p)
+            {
+              found = true;
+              break;
+            }
+          }
+          if (found)
+            continue;
+          if (dist < mindist)
+          {
+            mindist = dist;
+            n = 0;
+          }
+          matches[n++] = p;
+        }
+      }
+    }
+  }
+  if (S)
+  {
+    for (int p=-1; p>=-4; p--)
+    {
+      int dist = DecisionTree::getDistance(board,center,p);
+      if (dist > mindist)
+        continue;
+      bool found = false;
+      for (int k=0; k<numstones; k++)
+      {
+        if (stones[k] == p)
+        {
+          found = true;
+          break;
+        }
+      }
+      if (found)
+        continue;
+      if (dist < mindist)
+      {
+        mindist = dist;
+        n = 0;
+      }
+      matches[n++] = p;
+    }
+  }
+
+  if (n <= 1)
+    return n;
+
+  //break ties as in getSparseLeafNodes()
+  Go::Color owncol = (invert?Go::WHITE:Go::BLACK);
+  Go::Color othercol = (invert?Go::BLACK:Go::WHITE);
+  int m = 0;
+  for (int i=0; i<n; i++)
+  {
+    if (matches[i]>=0 && board->getColor(matches[i])==owncol)
+      matches[m++] = matches[i];
+  }
+  if (m == 0)
+  {
+    for (int i=0; i<n; i++)
+    {
+      if (matches[i]>=0 && board->getColor(matches[i])==othercol)
+        matches[m++] = matches[i];
+    }
+  }
+  if (m == 0)
+  {
+    for (int i=0; i<n; i++)
+    {
+      if (matches[i]<0)
+        matches[m++] = matches[i];
+    }
+  }
+  n = m;
+
+  for (int s=numstones-1; s>0 && n>1; s--)
+  {
+    int dists[NEW_MAX_MATCHES];
+    int mindist = -1;
+    for (int i=0; i<n; i++)
+    {
+      dists[i] = DecisionTree::getDistance(board,stones[s],matches[i]);
+      if (mindist==-1 || dists[i]<mindist)
+        mindist = dists[i];
+    }
+    m = 0;
+    for (int i=0; i<n; i++)
+    {
+      if (dists[i] == mindist)
+        matches[m++] = matches[i];
+    }
+    n = m;
+  }
+
+  if (n > 1)
+  {
+    int sizes[NEW_MAX_MATCHES];
+    int maxsize = 0;
+    for (int i=0; i<n; i++)
+    {
+      int p = matches[i];
+      sizes[i] = ((p>0 && board->inGroup(p)) ? board->getGroup(p)->numOfStones() : 0);
+      if (sizes[i] > maxsize)
+        maxsize = sizes[i];
+    }
+    m = 0;
+    for (int i=0; i<n; i++)
+    {
+      if (sizes[i] == maxsize)
+        matches[m++] = matches[i];
+    }
+    n = m;
+  }
+
+  if (n > 1)
+  {
+    int libs[NEW_MAX_MATCHES];
+    int maxlib = 0;
+    for (int i=0; i<n; i++)
+    {
+      int p = matches[i];
+      libs[i] = 0;
+      if (p>0 && board->inGroup(p))
+        libs[i] = (board->getGroup(p)->inAtari() ? 1 : board->getGroup(p)->numOfPseudoLiberties());
+      if (libs[i] > maxlib)
+        maxlib = libs[i];
+    }
+    m = 0;
+    for (int i=0; i<n; i++)
+    {
+      if (libs[i] == maxlib)
+        matches[m++] = matches[i];
+    }
+    n = m;
+  }
+
+  return n;
+}
+
 std::string DecisionTree::toString(bool ignorestats, int leafoffset)
 {
   std::string r = "(DT[";
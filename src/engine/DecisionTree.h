@@ -5,10 +5,15 @@
 #include <list>
 #include <vector>
 #include "Go.h"
+
+#define DECISIONTREE_MAX_STONES 32
+
 //from "Parameters.h":
 class Parameters;
 
-/** Decision Tree for Feature Ensemble Method. */
+/** Decision Tree for Feature Ensemble Method.
+ * Trees are also compiled into a flat array of instructions, which is used to find weights when the tree isn't being updated.
+ */
 class DecisionTree
 {
   public:
@@ -186,6 +191,49 @@ class DecisionTree
     Node *root;
     std::vector<Node*> leafmap;
 
+    /** Operations of a compiled tree. */
+    enum Opcode
+    {
+      OP_LEAF,
+      OP_NEW,
+      OP_DIST,
+      OP_ATTR
+    };
+
+    /** Options of a compiled query. */
+    enum Next
+    {
+      NEXT_B = 0,
+      NEXT_W = 1,
+      NEXT_S = 2,
+      NEXT_N = 3,
+      NEXT_Y = 0
+    };
+
+    /** A node of a compiled tree, with its query attributes already parsed. */
+    class Instruction
+    {
+      public:
+        Opcode op;
+        /** NEW: colours and distance, DIST: stones, equality and distance, ATTR: attribute, stone, equality and value. */
+        int args[4];
+        /** Index of the instruction for each option, or -1 if the option is missing. */
+        int next[4];
+        /** The node of a leaf, so that updated leaf weights are used. */
+        Node *leaf;
+    };
+
+    /** The leaves reached by a compiled tree. */
+    class ProgramResult
+    {
+      public:
+        float weight;
+        int minid;
+        Node *minleaf;
+    };
+
+    std::vector<Instruction> program;
+
     DecisionTree(Parameters *p, Type t, std::vector<std::string> *a, DecisionTree::Node *r);
 
     std::list<Node*> *getLeafNodes(Go::Board *board, Go::Move move, bool updatetree);
@@ -193,6 +241,13 @@ class DecisionTree
     bool updateSparseNode(Node *node, Go::Board *board, std::vector<int> *stones, bool invert);
     unsigned int getMaxNode(Node *node);
 
+    void compileProgram();
+    int compileNode(Node *node, int stones);
+    float getProgramWeight(Go::Board *board, Go::Move move);
+    void checkProgramWeight(Go::Board *board, Go::Move move, float weight);
+    bool runProgram(int pc, Go::Board *board, int *stones, int numstones, bool invert, ProgramResult &res);
+    int findNewStones(Instruction *ins, Go::Board *board, int *stones, int numstones, bool invert, int *matches);
+
     static float combineNodeWeights(std::list<Node*> *nodes);
     static int getDistance(Go::Board *board, int p1, int p2);
     static float percentageToVal(float p);
@@ -15,6 +15,9 @@
 #endif
 #include "Pattern.h"
 #include "DecisionTree.h"
+#include "Trainer.h"
+#include "Harvester.h"
+#include "MovePrediction.h"
 #ifdef HAVE_WEB
   #include "../web/Web.h"
 #endif
@@ -60,6 +63,7 @@ Engine::Engine(Gtp::Engine *ge, std::string ln) : params(new Parameters())
   params->addParameter("general","book_use",&(params->book_use),BOOK_USE);
   
   params->addParameter("general","thread_count",&(params->thread_count),THREAD_COUNT,&Engine::updateParameterWrapper,this);
+  params->addParameter("general","thread_deterministic",&(params->thread_deterministic),THREAD_DETERMINISTIC);
   params->addParameter("general","memory_usage_max",&(params->memory_usage_max),MEMORY_USAGE_MAX);
   
   params->addParameter("general","playouts_per_move",&(params->playouts_per_move),PLAYOUTS_PER_MOVE,&Engine::updateParameterWrapper,this);
@@ -67,35 +71,37 @@ Engine::Engine(Gtp::Engine *ge, std::string ln) : params(new Parameters())
   params->addParameter("general","playouts_per_move_min",&(params->playouts_per_move_min),PLAYOUTS_PER_MOVE_MIN);
   
   params->addParameter("playout","playout_criticality_random_n",&(params->playout_criticality_random_n),PLAYOUT_CRITICALITY_RANDOM_N);
-  params->addParameter("playout","playout_poolrave_enabled",&(params->playout_poolrave_enabled),PLAYOUT_POOLRAVE_ENABLED);
-  params->addParameter("playout","playout_poolrave_criticality",&(params->playout_poolrave_criticality),PLAYOUT_POOLRAVE_CRITICALITY);
+  params->addParameter("playout","playout_poolrave_enabled",&(params->playout_poolrave_enabled),PLAYOUT_POOLRAVE_ENABLED,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_poolrave_criticality",&(params->playout_poolrave_criticality),PLAYOUT_POOLRAVE_CRITICALITY,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_poolrave_p",&(params->playout_poolrave_p),PLAYOUT_POOLRAVE_P);
   params->addParameter("playout","playout_poolrave_k",&(params->playout_poolrave_k),PLAYOUT_POOLRAVE_K);
   params->addParameter("playout","playout_poolrave_min_playouts",&(params->playout_poolrave_min_playouts),PLAYOUT_POOLRAVE_MIN_PLAYOUTS);
-  params->addParameter("playout","playout_lgrf2_enabled",&(params->playout_lgrf2_enabled),PLAYOUT_LGRF2_ENABLED);
-  params->addParameter("playout","playout_lgrf1_enabled",&(params->playout_lgrf1_enabled),PLAYOUT_LGRF1_ENABLED);
+  params->addParameter("playout","playout_poolrave_refresh",&(params->playout_poolrave_refresh),PLAYOUT_POOLRAVE_REFRESH);
+  params->addParameter("playout","playout_lgrf2_enabled",&(params->playout_lgrf2_enabled),PLAYOUT_LGRF2_ENABLED,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_lgrf1_enabled",&(params->playout_lgrf1_enabled),PLAYOUT_LGRF1_ENABLED,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_lgrf_local",&(params->playout_lgrf_local),PLAYOUT_LGRF_LOCAL);
-  params->addParameter("playout","playout_lgrf2_safe_enabled",&(params->playout_lgrf2_safe_enabled),PLAYOUT_LGRF2_SAFE_ENABLED);
-  params->addParameter("playout","playout_lgrf1_safe_enabled",&(params->playout_lgrf1_safe_enabled),PLAYOUT_LGRF1_SAFE_ENABLED);
-  params->addParameter("playout","playout_lgrf1o_enabled",&(params->playout_lgrf1o_enabled),PLAYOUT_LGRF1O_ENABLED);
+  params->addParameter("playout","playout_lgrf_merge_interval",&(params->playout_lgrf_merge_interval),PLAYOUT_LGRF_MERGE_INTERVAL);
+  params->addParameter("playout","playout_lgrf2_safe_enabled",&(params->playout_lgrf2_safe_enabled),PLAYOUT_LGRF2_SAFE_ENABLED,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_lgrf1_safe_enabled",&(params->playout_lgrf1_safe_enabled),PLAYOUT_LGRF1_SAFE_ENABLED,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_lgrf1o_enabled",&(params->playout_lgrf1o_enabled),PLAYOUT_LGRF1O_ENABLED,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_avoid_lbrf1_p",&(params->playout_avoid_lbrf1_p),PLAYOUT_AVOID_LBRF1_P);
   params->addParameter("playout","playout_avoid_lbmf_p",&(params->playout_avoid_lbmf_p),PLAYOUT_AVOID_LBMF_P);
   params->addParameter("playout","playout_avoid_lbrf1_p2",&(params->playout_avoid_lbrf1_p2),PLAYOUT_AVOID_LBRF1_P2);
   params->addParameter("playout","playout_avoid_lbmf_p2",&(params->playout_avoid_lbmf_p2),PLAYOUT_AVOID_LBMF_P2);
-  params->addParameter("playout","playout_lgpf_enabled",&(params->playout_lgpf_enabled),PLAYOUT_LGPF_ENABLED);
-  params->addParameter("playout","playout_atari_enabled",&(params->playout_atari_enabled),PLAYOUT_ATARI_ENABLED);
-  params->addParameter("playout","playout_lastatari_p",&(params->playout_lastatari_p),PLAYOUT_LASTATARI_P);
+  params->addParameter("playout","playout_lgpf_enabled",&(params->playout_lgpf_enabled),PLAYOUT_LGPF_ENABLED,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_atari_enabled",&(params->playout_atari_enabled),PLAYOUT_ATARI_ENABLED,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_lastatari_p",&(params->playout_lastatari_p),PLAYOUT_LASTATARI_P,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_lastatari_leavedouble",&(params->playout_lastatari_leavedouble),PLAYOUT_LASTATARI_LEAVEDOUBLE);
   params->addParameter("playout","playout_lastatari_captureattached_p",&(params->playout_lastatari_captureattached_p),PLAYOUT_LASTATARI_CAPTUREATTACHED);
-  params->addParameter("playout","playout_lastcapture_enabled",&(params->playout_lastcapture_enabled),PLAYOUT_LASTCAPTURE_ENABLED);
-  params->addParameter("playout","playout_last2libatari_enabled",&(params->playout_last2libatari_enabled),PLAYOUT_LAST2LIBATARI_ENABLED);
+  params->addParameter("playout","playout_lastcapture_enabled",&(params->playout_lastcapture_enabled),PLAYOUT_LASTCAPTURE_ENABLED,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_last2libatari_enabled",&(params->playout_last2libatari_enabled),PLAYOUT_LAST2LIBATARI_ENABLED,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_last2libatari_complex",&(params->playout_last2libatari_complex),PLAYOUT_LAST2LIBATARI_COMPLEX);
-  params->addParameter("playout","playout_nakade_enabled",&(params->playout_nakade_enabled),PLAYOUT_NAKADE_ENABLED);
+  params->addParameter("playout","playout_nakade_enabled",&(params->playout_nakade_enabled),PLAYOUT_NAKADE_ENABLED,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_nakade4_enabled",&(params->playout_nakade4_enabled),PLAYOUT_NAKADE4_ENABLED);
   params->addParameter("playout","playout_nakade_bent4_enabled",&(params->playout_nakade_bent4_enabled),PLAYOUT_NAKADE_BENT4_ENABLED);
   params->addParameter("playout","playout_nakade5_enabled",&(params->playout_nakade5_enabled),PLAYOUT_NAKADE5_ENABLED);
-  params->addParameter("playout","playout_nearby_enabled",&(params->playout_nearby_enabled),PLAYOUT_NEARBY_ENABLED);
-  params->addParameter("playout","playout_fillboard_enabled",&(params->playout_fillboard_enabled),PLAYOUT_FILLBOARD_ENABLED);
+  params->addParameter("playout","playout_nearby_enabled",&(params->playout_nearby_enabled),PLAYOUT_NEARBY_ENABLED,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_fillboard_enabled",&(params->playout_fillboard_enabled),PLAYOUT_FILLBOARD_ENABLED,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_fillboard_n",&(params->playout_fillboard_n),PLAYOUT_FILLBOARD_N);
   params->addParameter("playout","playout_circreplace_enabled",&(params->playout_circreplace_enabled),PLAYOUT_CIRCREPLACE_ENABLED);
   params->addParameter("playout","playout_fillboard_bestcirc_enabled",&(params->playout_fillboard_bestcirc_enabled),PLAYOUT_FILLBOARD_BESTCIRC_ENABLED);
@@ -104,21 +110,28 @@ Engine::Engine(Gtp::Engine *ge, std::string ln) : params(new Parameters())
   params->addParameter("playout","playout_random_weight_territory_f0",&(params->playout_random_weight_territory_f0),PLAYOUT_RANDOM_WEIGHT_TERRITORY_F0);
   params->addParameter("playout","playout_random_weight_territory_f1",&(params->playout_random_weight_territory_f1),PLAYOUT_RANDOM_WEIGHT_TERRITORY_F1);
   params->addParameter("playout","playout_random_weight_territory_f",&(params->playout_random_weight_territory_f),PLAYOUT_RANDOM_WEIGHT_TERRITORY_F);
-  params->addParameter("playout","playout_circpattern_n",&(params->playout_circpattern_n),PLAYOUT_CIRCPATTERN_N);
-  params->addParameter("playout","playout_patterns_p",&(params->playout_patterns_p),PLAYOUT_PATTERNS_P);
+  params->addParameter("playout","playout_circpattern_n",&(params->playout_circpattern_n),PLAYOUT_CIRCPATTERN_N,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_circpattern_match",&(params->playout_circpattern_match),PLAYOUT_CIRCPATTERN_MATCH);
+  params->addParameter("playout","playout_patterns_p",&(params->playout_patterns_p),PLAYOUT_PATTERNS_P,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_patterns_gammas_p",&(params->playout_patterns_gammas_p),PLAYOUT_PATTERNS_GAMMAS_P);
-  params->addParameter("playout","playout_anycapture_p",&(params->playout_anycapture_p),PLAYOUT_ANYCAPTURE_P);
-  params->addParameter("playout","playout_features_enabled",&(params->playout_features_enabled),PLAYOUT_FEATURES_ENABLED);
+  params->addParameter("playout","playout_anycapture_p",&(params->playout_anycapture_p),PLAYOUT_ANYCAPTURE_P,&Engine::updateParameterWrapper,this);
+  params->addParameter("playout","playout_features_enabled",&(params->playout_features_enabled),PLAYOUT_FEATURES_ENABLED,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_features_incremental",&(params->playout_features_incremental),PLAYOUT_FEATURES_INCREMENTAL);
+  params->addParameter("playout","playout_features_incremental_check",&(params->playout_features_incremental_check),PLAYOUT_FEATURES_INCREMENTAL_CHECK);
   params->addParameter("playout","playout_random_chance",&(params->playout_random_chance),PLAYOUT_RANDOM_CHANCE);
+  params->addParameter("playout","playout_stats_timing",&(params->playout_stats_timing),PLAYOUT_STATS_TIMING);
+  params->addParameter("playout","playout_trace_interval",&(params->playout_trace_interval),PLAYOUT_TRACE_INTERVAL);
+  params->addParameter("playout","playout_trace_size",&(params->playout_trace_size),PLAYOUT_TRACE_SIZE);
   params->addParameter("playout","playout_random_approach_p",&(params->playout_random_approach_p),PLAYOUT_RANDOM_APPROACH_P);
   params->addParameter("playout","playout_avoid_selfatari",&(params->playout_avoid_selfatari),PLAYOUT_AVOID_SELFATARI);
   params->addParameter("playout","playout_avoid_selfatari_size",&(params->playout_avoid_selfatari_size),PLAYOUT_AVOID_SELFATARI_SIZE);
   params->addParameter("playout","playout_avoid_selfatari_complex",&(params->playout_avoid_selfatari_complex),PLAYOUT_AVOID_SELFATARI_COMPLEX);
   params->addParameter("playout","playout_useless_move",&(params->playout_useless_move),PLAYOUT_USELESS_MOVE);
-  params->addParameter("playout","playout_order",&(params->playout_order),PLAYOUT_ORDER);
+  params->addParameter("playout","playout_order",&(params->playout_order),PLAYOUT_ORDER,&Engine::updateParameterWrapper,this);
   params->addParameter("playout","playout_mercy_rule_enabled",&(params->playout_mercy_rule_enabled),PLAYOUT_MERCY_RULE_ENABLED);
   params->addParameter("playout","playout_mercy_rule_factor",&(params->playout_mercy_rule_factor),PLAYOUT_MERCY_RULE_FACTOR);
+  params->addParameter("playout","playout_settled_cutoff",&(params->playout_settled_cutoff),PLAYOUT_SETTLED_CUTOFF);
+  params->addParameter("playout","playout_settled_cutoff_empty",&(params->playout_settled_cutoff_empty),PLAYOUT_SETTLED_CUTOFF_EMPTY);
   params->addParameter("playout","playout_fill_weak_eyes",&(params->playout_fill_weak_eyes),PLAYOUT_FILL_WEAK_EYES);
   
 
@@ -159,6 +172,7 @@ Engine::Engine(Gtp::Engine *ge, std::string ln) : params(new Parameters())
   params->addParameter("tree","rave_only_first_move",&(params->rave_only_first_move),RAVE_ONLY_FIRST_MOVE);
   
   params->addParameter("tree","uct_expand_after",&(params->uct_expand_after),UCT_EXPAND_AFTER);
+  params->addParameter("tree","uct_leaf_playouts",&(params->uct_leaf_playouts),UCT_LEAF_PLAYOUTS);
   params->addParameter("tree","uct_keep_subtree",&(params->uct_keep_subtree),UCT_KEEP_SUBTREE,&Engine::updateParameterWrapper,this);
   params->addParameter("tree","uct_symmetry_use",&(params->uct_symmetry_use),UCT_SYMMETRY_USE,&Engine::updateParameterWrapper,this);
   if (params->uct_symmetry_use)
@@ -243,6 +257,8 @@ Engine::Engine(Gtp::Engine *ge, std::string ln) : params(new Parameters())
   params->addParameter("tree","mm_learn_enabled",&(params->mm_learn_enabled),false);
   params->addParameter("tree","mm_learn_delta",&(params->mm_learn_delta),MM_LEARN_DELTA);
   params->addParameter("tree","mm_learn_min_playouts",&(params->mm_learn_min_playouts),MM_LEARN_MIN_PLAYOUTS);
+  params->addParameter("tree","mm_train_sample",&(params->mm_train_sample),MM_TRAIN_SAMPLE);
+  params->addParameter("tree","mm_train_iterations",&(params->mm_train_iterations),MM_TRAIN_ITERATIONS);
 
   params->addParameter("rules","rules_positional_superko_enabled",&(params->rules_positional_superko_enabled),RULES_POSITIONAL_SUPERKO_ENABLED);
   params->addParameter("rules","rules_superko_top_ply",&(params->rules_superko_top_ply),RULES_SUPERKO_TOP_PLY);
@@ -288,6 +304,7 @@ Engine::Engine(Gtp::Engine *ge, std::string ln) : params(new Parameters())
   params->addParameter("other","dt_solo_leaf",&(params->dt_solo_leaf),true);
   params->addParameter("other","dt_output_mm",&(params->dt_output_mm),0.00);
   params->addParameter("other","dt_ordered_comparison",&(params->dt_ordered_comparison),false);
+  params->addParameter("other","dt_program_check",&(params->dt_program_check),false);
   
   #ifdef HAVE_MPI
     params->addParameter("mpi","mpi_update_period",&(params->mpi_update_period),MPI_UPDATE_PERIOD);
@@ -300,6 +317,9 @@ Engine::Engine(Gtp::Engine *ge, std::string ln) : params(new Parameters())
   
   features=new Features(params);
   features->loadGammaDefaults();
+  trainer=NULL;
+  harvester=NULL;
+  moveprediction=NULL;
   
   book=new Book(params);
   
@@ -339,6 +359,7 @@ Engine::Engine(Gtp::Engine *ge, std::string ln) : params(new Parameters())
   
   params->thread_job=Parameters::TJ_GENMOVE;
   threadpool = new Worker::Pool(params);
+  this->clearStatistics();
   
   #ifdef HAVE_MPI
     this->mpiBuildDerivedTypes();
@@ -522,6 +543,7 @@ void Engine::updateParameter(std::string id)
     {
       delete threadpool;
       threadpool = new Worker::Pool(params);
+      this->clearStatistics();
     }
   }
   else if (id=="playouts_per_move")
@@ -531,6 +553,10 @@ void Engine::updateParameter(std::string id)
     if (params->playouts_per_move<params->playouts_per_move_min)
       params->playouts_per_move_min=params->playouts_per_move;
   }
+  else if (id.compare(0,8,"playout_")==0)
+  {
+    playout->updatePolicy();
+  }
 }
 
 void Engine::addGtpCommands()
@@ -564,12 +590,21 @@ void Engine::addGtpCommands()
   gtpe->addFunctionCommand("featureprobdistribution",this,&Engine::gtpFeatureProbDistribution);
   gtpe->addFunctionCommand("listallpatterns",this,&Engine::gtpListAllPatterns);
   gtpe->addFunctionCommand("loadfeaturegammas",this,&Engine::gtpLoadFeatureGammas);
+  gtpe->addFunctionCommand("trainfeaturegammas",this,&Engine::gtpTrainFeatureGammas);
+  gtpe->addFunctionCommand("harvestpatterns",this,&Engine::gtpHarvestPatterns);
+  gtpe->addFunctionCommand("harvestcircpatterns",this,&Engine::gtpHarvestCircPatterns);
+  gtpe->addFunctionCommand("harvestcircpatternsnot",this,&Engine::gtpHarvestCircPatternsNot);
+  gtpe->addFunctionCommand("movepredictiontest",this,&Engine::gtpMovePredictionTest);
   gtpe->addFunctionCommand("savefeaturegammas",this,&Engine::gtpSaveFeatureGammas);
   gtpe->addFunctionCommand("savefeaturegammasinline",this,&Engine::gtpSaveFeatureGammasInline);
+  gtpe->addFunctionCommand("savefeaturegammasbinary",this,&Engine::gtpSaveFeatureGammasBinary);
   gtpe->addFunctionCommand("loadcircpatterns",this,&Engine::gtpLoadCircPatterns);
   gtpe->addFunctionCommand("loadcircpatternsnot",this,&Engine::gtpLoadCircPatternsNot);
   gtpe->addFunctionCommand("savecircpatternvalues",this,&Engine::gtpSaveCircPatternValues);
   gtpe->addFunctionCommand("loadcircpatternvalues",this,&Engine::gtpLoadCircPatternValues);
+  gtpe->addFunctionCommand("savecircpatternsbinary",this,&Engine::gtpSaveCircPatternsBinary);
+  gtpe->addFunctionCommand("savecircpatternsnotbinary",this,&Engine::gtpSaveCircPatternsNotBinary);
+  gtpe->addFunctionCommand("savecircpatternvaluesbinary",this,&Engine::gtpSaveCircPatternValuesBinary);
   gtpe->addFunctionCommand("listfeatureids",this,&Engine::gtpListFeatureIds);
   gtpe->addFunctionCommand("showcfgfrom",this,&Engine::gtpShowCFGFrom);
   gtpe->addFunctionCommand("showcircdistfrom",this,&Engine::gtpShowCircDistFrom);
@@ -590,6 +625,8 @@ void Engine::addGtpCommands()
   
   gtpe->addFunctionCommand("explainlastmove",this,&Engine::gtpExplainLastMove);
   gtpe->addFunctionCommand("boardstats",this,&Engine::gtpBoardStats);
+  gtpe->addFunctionCommand("playoutstats",this,&Engine::gtpPlayoutStats);
+  gtpe->addFunctionCommand("playouttrace",this,&Engine::gtpPlayoutTrace);
   gtpe->addFunctionCommand("showsymmetrytransforms",this,&Engine::gtpShowSymmetryTransforms);
   gtpe->addFunctionCommand("shownakadecenters",this,&Engine::gtpShowNakadeCenters);
   gtpe->addFunctionCommand("showtreelivegfx",this,&Engine::gtpShowTreeLiveGfx);
@@ -1739,6 +1776,95 @@ void Engine::gtpBoardStats(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
   gtpe->getOutput()->endResponse(true);
 }
 
+void Engine::gtpPlayoutStats(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  gtpe->getOutput()->startResponse(cmd);
+  gtpe->getOutput()->printf("playout stats (since last search):\n");
+  gtpe->getOutput()->printf("%-20s %12s %12s %7s %10s\n","stage","attempts","hits","hit%","time(ms)");
+  for (int s=0;s<Playout::STAGE_NUM;s++)
+  {
+    long attempts=0;
+    long hits=0;
+    double time=0;
+    for (unsigned int t=0;t<me->threadstatistics.size();t++)
+    {
+      attempts+=me->threadstatistics[t].stageattempts[s];
+      hits+=me->threadstatistics[t].stagehits[s];
+      time+=me->threadstatistics[t].stagetime[s];
+    }
+    if (attempts==0)
+      continue;
+    gtpe->getOutput()->printf("%-20s %12ld %12ld %6.2f%%",Playout::getPolicyStageName((Playout::PolicyStage)s).c_str(),attempts,hits,(float)hits*100/attempts);
+    if (me->params->playout_stats_timing)
+      gtpe->getOutput()->printf(" %10.1f\n",time/1000);
+    else
+      gtpe->getOutput()->printf(" %10s\n","-");
+  }
+  gtpe->getOutput()->endResponse(true);
+}
+
+void Engine::gtpPlayoutTrace(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=1)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 1 arg");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  std::string filename=cmd->getStringArg(0);
+  std::ofstream fout(filename.c_str(),std::ios::out|std::ios::binary);
+  if (!fout)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error writing trace: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  // header: magic, board size, stage names (length-prefixed), thread count
+  // then for each thread: entry count and the entries, see PlayoutTrace::Entry
+  fout.write("OAKTRACE",8);
+  boost::uint32_t boardsize=me->boardsize;
+  fout.write((const char *)&boardsize,sizeof(boardsize));
+  boost::uint32_t stages=Playout::STAGE_NUM+2;
+  fout.write((const char *)&stages,sizeof(stages));
+  for (int s=0;s<(int)stages;s++)
+  {
+    std::string name;
+    if (s<Playout::STAGE_NUM)
+      name=Playout::getPolicyStageName((Playout::PolicyStage)s);
+    else if (s==Playout::STAGE_NUM)
+      name="random";
+    else
+      name="tree";
+    boost::uint8_t len=name.length();
+    fout.write((const char *)&len,sizeof(len));
+    fout.write(name.c_str(),len);
+  }
+  boost::uint32_t threads=me->threadpool->getSize();
+  fout.write((const char *)&threads,sizeof(threads));
+  
+  long entries=0;
+  for (int t=0;t<(int)threads;t++)
+  {
+    PlayoutTrace *trace=me->threadpool->getThread(t)->getSettings()->trace;
+    entries+=trace->getSize();
+    trace->write(fout);
+    trace->clear();
+  }
+  fout.close();
+  
+  gtpe->getOutput()->startResponse(cmd);
+  gtpe->getOutput()->printf("wrote %ld trace entries to: %s",entries,filename.c_str());
+  gtpe->getOutput()->endResponse();
+}
+
 void Engine::gtpFeatureMatchesAt(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
 {
   Engine *me=(Engine*)instance;
@@ -1928,6 +2054,179 @@ void Engine::gtpLoadFeatureGammas(void *instance, Gtp::Engine* gtpe, Gtp::Comman
   }
 }
 
+void Engine::gtpTrainFeatureGammas(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=2)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 2 args");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  std::string listfilename=cmd->getStringArg(0);
+  std::string outfilename=cmd->getStringArg(1);
+  
+  std::vector<std::string> games;
+  if (!Go::loadSGFGameList(listfilename,games))
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error reading game list: %s",listfilename.c_str());
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  me->trainer=new Trainer(me->params,me->features,me->threadpool);
+  me->trainer->extractCompetitions(games);
+  me->trainer->train(me->params->mm_train_iterations);
+  bool success=me->trainer->saveGammaFile(outfilename);
+  
+  if (success)
+  {
+    gtpe->getOutput()->startResponse(cmd);
+    gtpe->getOutput()->printf("trained feature gammas from %d games (%d competitions, %d teams, log-likelihood: %.2f) saved to: %s",(int)games.size(),me->trainer->getCompetitionCount(),me->trainer->getTeamCount(),me->trainer->getLogLikelihood(),outfilename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+  else
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error writing gamma file: %s",outfilename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+  
+  delete me->trainer;
+  me->trainer=NULL;
+}
+
+void Engine::gtpHarvestPatterns(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=2)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 2 args");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  me->harvester=new Harvester(me->params,me->features,me->threadpool,Harvester::PATTERN3X3);
+  me->harvestPatterns(gtpe,cmd,cmd->getStringArg(0),cmd->getStringArg(1));
+}
+
+void Engine::gtpHarvestCircPatterns(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=3 || cmd->getIntArg(2)<2 || cmd->getIntArg(2)>PATTERN_CIRC_MAXSIZE)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 3 args, the last being a circular pattern size");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  me->harvester=new Harvester(me->params,me->features,me->threadpool,Harvester::CIRCULAR,cmd->getIntArg(2));
+  me->harvestPatterns(gtpe,cmd,cmd->getStringArg(0),cmd->getStringArg(1));
+}
+
+void Engine::gtpHarvestCircPatternsNot(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=3 || cmd->getIntArg(2)<2 || cmd->getIntArg(2)>PATTERN_CIRC_MAXSIZE)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 3 args, the last being a circular pattern size");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  me->harvester=new Harvester(me->params,me->features,me->threadpool,Harvester::CIRCULAR_NOT_PLAYED,cmd->getIntArg(2));
+  me->harvestPatterns(gtpe,cmd,cmd->getStringArg(0),cmd->getStringArg(1));
+}
+
+void Engine::harvestPatterns(Gtp::Engine* gtpe, Gtp::Command* cmd, std::string listfilename, std::string outfilename)
+{
+  std::vector<std::string> games;
+  if (!Go::loadSGFGameList(listfilename,games))
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error reading game list: %s",listfilename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+  else
+  {
+    harvester->harvest(games);
+    
+    if (harvester->saveCounts(outfilename))
+    {
+      gtpe->getOutput()->startResponse(cmd);
+      gtpe->getOutput()->printf("harvested %lu patterns from %d games (%lu positions) saved to: %s",harvester->getPatternCount(),harvester->getGameCount(),harvester->getPositionCount(),outfilename.c_str());
+      gtpe->getOutput()->endResponse();
+    }
+    else
+    {
+      gtpe->getOutput()->startResponse(cmd,false);
+      gtpe->getOutput()->printf("error writing pattern file: %s",outfilename.c_str());
+      gtpe->getOutput()->endResponse();
+    }
+  }
+  
+  delete harvester;
+  harvester=NULL;
+}
+
+void Engine::gtpMovePredictionTest(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=1 && cmd->numArgs()!=2)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 1 or 2 args (game list and optional output file)");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  std::string listfilename=cmd->getStringArg(0);
+  std::vector<std::string> games;
+  if (!Go::loadSGFGameList(listfilename,games))
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error reading game list: %s",listfilename.c_str());
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  me->moveprediction=new MovePrediction(me->params,me->features,me->threadpool);
+  me->moveprediction->run(games);
+  std::string json=me->moveprediction->toJSON();
+  delete me->moveprediction;
+  me->moveprediction=NULL;
+  
+  if (cmd->numArgs()==2)
+  {
+    std::string outfilename=cmd->getStringArg(1);
+    std::ofstream fout(outfilename.c_str());
+    if (!fout)
+    {
+      gtpe->getOutput()->startResponse(cmd,false);
+      gtpe->getOutput()->printf("error writing results file: %s",outfilename.c_str());
+      gtpe->getOutput()->endResponse();
+      return;
+    }
+    fout<<json<<"\n";
+    fout.close();
+  }
+  
+  gtpe->getOutput()->startResponse(cmd);
+  gtpe->getOutput()->printString(json);
+  gtpe->getOutput()->endResponse();
+}
+
 void Engine::gtpSaveFeatureGammas(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
 {
   Engine *me=(Engine*)instance;
@@ -1958,6 +2257,35 @@ void Engine::gtpSaveFeatureGammas(void *instance, Gtp::Engine* gtpe, Gtp::Comman
   }
 }
 
+void Engine::gtpSaveFeatureGammasBinary(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=1)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 1 arg (filename)");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  std::string filename=cmd->getStringArg(0);
+  bool success=me->features->saveGammaFileBinary(filename);
+  
+  if (success)
+  {
+    gtpe->getOutput()->startResponse(cmd);
+    gtpe->getOutput()->printf("saved features gamma database: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+  else
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error saving features gamma database: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+}
+
 void Engine::gtpSaveFeatureGammasInline(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
 {
   Engine *me=(Engine*)instance;
@@ -2151,6 +2479,93 @@ void Engine::gtpLoadCircPatternValues(void *instance, Gtp::Engine* gtpe, Gtp::Co
   }
 }
 
+void Engine::gtpSaveCircPatternsBinary(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=1)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 1 arg (filename)");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  std::string filename=cmd->getStringArg(0);
+  bool success=me->features->saveCircFileBinary(filename,false);
+  
+  if (success)
+  {
+    gtpe->getOutput()->startResponse(cmd);
+    gtpe->getOutput()->printf("saved circpatterns database: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+  else
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error saving circpatterns database: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+}
+
+void Engine::gtpSaveCircPatternsNotBinary(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=1)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 1 arg (filename)");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  std::string filename=cmd->getStringArg(0);
+  bool success=me->features->saveCircFileBinary(filename,true);
+  
+  if (success)
+  {
+    gtpe->getOutput()->startResponse(cmd);
+    gtpe->getOutput()->printf("saved circpatterns database: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+  else
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error saving circpatterns database: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+}
+
+void Engine::gtpSaveCircPatternValuesBinary(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
+{
+  Engine *me=(Engine*)instance;
+  
+  if (cmd->numArgs()!=1)
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("need 1 arg (filename)");
+    gtpe->getOutput()->endResponse();
+    return;
+  }
+  
+  std::string filename=cmd->getStringArg(0);
+  bool success=me->features->saveCircValueFileBinary(filename);
+  
+  if (success)
+  {
+    gtpe->getOutput()->startResponse(cmd);
+    gtpe->getOutput()->printf("saved circvalue database: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+  else
+  {
+    gtpe->getOutput()->startResponse(cmd,false);
+    gtpe->getOutput()->printf("error saving circvalue database: %s",filename.c_str());
+    gtpe->getOutput()->endResponse();
+  }
+}
+
 void Engine::gtpListFeatureIds(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd)
 {
   Engine *me=(Engine*)instance;
@@ -2306,10 +2721,7 @@ void Engine::gtpListCircularPatternsAtSize(void *instance, Gtp::Engine* gtpe, Gt
   }
   
   int pos=Go::Position::xy2pos(vert.x,vert.y,me->boardsize);
-  Pattern::Circular pattcirc=Pattern::Circular(me->getCircDict(),me->currentboard,pos,PATTERN_CIRC_MAXSIZE);
-  if (gtpcol==Gtp::WHITE)
-    pattcirc.invert();
-  pattcirc.convertToSmallestEquivalent(me->getCircDict());
+  Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(me->getCircDict(),me->currentboard,pos,PATTERN_CIRC_MAXSIZE,gtpcol==Gtp::WHITE);
   
   gtpe->getOutput()->startResponse(cmd);
   gtpe->getOutput()->printf(" %s\n",pattcirc.getSubPattern(me->getCircDict(),s).toString(me->getCircDict()).c_str());
@@ -2362,10 +2774,7 @@ void Engine::gtpListCircularPatternsAtSizeNot(void *instance, Gtp::Engine* gtpe,
 
   fprintf(stderr,"circ pattern at %s\n",Go::Position::pos2string(pos,me->boardsize).c_str());
           
-  Pattern::Circular pattcirc=Pattern::Circular(me->getCircDict(),me->currentboard,pos,PATTERN_CIRC_MAXSIZE);
-  if (gtpcol==Gtp::WHITE)
-    pattcirc.invert();
-  pattcirc.convertToSmallestEquivalent(me->getCircDict());
+  Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(me->getCircDict(),me->currentboard,pos,PATTERN_CIRC_MAXSIZE,gtpcol==Gtp::WHITE);
   
   gtpe->getOutput()->startResponse(cmd);
   gtpe->getOutput()->printf(" %s\n",pattcirc.getSubPattern(me->getCircDict(),s).toString(me->getCircDict()).c_str());
@@ -2390,10 +2799,7 @@ void Engine::gtpListAllCircularPatterns(void *instance, Gtp::Engine* gtpe, Gtp::
   {
     if (me->currentboard->validMove(Go::Move(col,p)))
     {
-      Pattern::Circular pattcirc=Pattern::Circular(me->getCircDict(),board,p,PATTERN_CIRC_MAXSIZE);
-      if (col==Go::WHITE)
-        pattcirc.invert();
-      pattcirc.convertToSmallestEquivalent(me->getCircDict());
+      Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(me->getCircDict(),board,p,PATTERN_CIRC_MAXSIZE,col==Go::WHITE);
       if (size==0)
       {
         for (int s=4;s<=PATTERN_CIRC_MAXSIZE;s++)
@@ -3699,6 +4105,7 @@ void Engine::generateMove(Go::Color col, Go::Move **move, bool playmove)
     
     params->uct_initial_playouts=startplayouts;
     params->thread_job=Parameters::TJ_GENMOVE;
+    deterministicstep=0;
     threadpool->startAll();
     threadpool->waitAll();
     
@@ -3712,11 +4119,13 @@ void Engine::generateMove(Go::Color col, Go::Move **move, bool playmove)
     std::ostringstream ssun;
     if (params->mm_learn_enabled)
       learnFromTree (currentboard,movetree,&ssun,1);
+    long stattotals[STATISTICS_NUM];
+    long statsum=this->sumStatistics(stattotals);
     ssun<<"st:(";
     for (int nn=0;nn<STATISTICS_NUM;nn++)
     {
       ssun<<(nn!=0?",":"");
-      ssun<<getStatistics (nn);
+      ssun<<stattotals[nn]*1000/(statsum+1); //+1 avoid crash
     }
     ssun<<")";
     ssun<< " ravepreset: " << (presetplayouts/presetnum);
@@ -3826,7 +4235,7 @@ void Engine::generateMove(Go::Color col, Go::Move **move, bool playmove)
     Go::Board *playoutboard=currentboard->copy();
     playoutboard->turnSymmetryOff();
     if (params->playout_features_enabled)
-      playoutboard->setFeatures(features,params->playout_features_incremental);
+      playoutboard->setFeatures(features,params->playout_features_incremental,params->playout_features_incremental_check);
     playout->getPlayoutMove(threadpool->getThreadZero()->getSettings(),playoutboard,col,**move,NULL);
     if (params->playout_useless_move)
       playout->checkUselessMove(threadpool->getThreadZero()->getSettings(),playoutboard,col,**move,(std::string *)NULL);
@@ -3840,7 +4249,7 @@ void Engine::getOnePlayoutMove(Go::Board *board, Go::Color col, Go::Move *move)
   Go::Board *playoutboard=board->copy();
   playoutboard->turnSymmetryOff();
   if (params->playout_features_enabled)
-    playoutboard->setFeatures(features,params->playout_features_incremental);
+    playoutboard->setFeatures(features,params->playout_features_incremental,params->playout_features_incremental_check);
   playout->getPlayoutMove(threadpool->getThreadZero()->getSettings(),playoutboard,col,*move,NULL);
   if (params->playout_useless_move)
     playout->checkUselessMove(threadpool->getThreadZero()->getSettings(),playoutboard,col,*move,(std::string *)NULL);
@@ -3936,10 +4345,7 @@ void Engine::makeMove(Go::Move move)
     {
       if (currentboard->validMove(Go::Move(col,p)))
       {
-        Pattern::Circular pattcirc=Pattern::Circular(this->getCircDict(),currentboard,p,PATTERN_CIRC_MAXSIZE);
-        if (col==Go::WHITE)
-          pattcirc.invert();
-        pattcirc.convertToSmallestEquivalent(this->getCircDict());
+        Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(this->getCircDict(),currentboard,p,PATTERN_CIRC_MAXSIZE,col==Go::WHITE);
         if (params->features_circ_list_size==0)
         {
           for (int s=3;s<=PATTERN_CIRC_MAXSIZE;s++)
@@ -4503,6 +4909,7 @@ void Engine::doNPlayouts(int n)
     
     params->uct_initial_playouts=(int)movetree->getPlayouts();
     params->thread_job=Parameters::TJ_DONPLTS;
+    deterministicstep=0;
     threadpool->startAll();
     threadpool->waitAll();
     if (movetree->isTerminalResult())
@@ -4550,104 +4957,142 @@ void Engine::doPlayout(Worker::Settings *settings, Go::BitBoard *firstlist, Go::
   //if (!givensecondlist)
   //  secondlist=new Go::BitBoard(boardsize);
   
-  Go::Board *playoutboard=currentboard->copy();
-  playoutboard->turnSymmetryOff();
-  if (params->playout_features_enabled)
-    playoutboard->setFeatures(features,params->playout_features_incremental);
-  if (params->rave_moves>0)
-  {
-    firstlist->clear();
-    secondlist->clear();
-    earlyfirstlist->clear();
-    earlysecondlist->clear();
-  }
+  int batchsize=(params->uct_leaf_playouts>1?params->uct_leaf_playouts:1);
+  float batchwins=0;
+  float batchplayouts=0;
+  float batchscoresum=0;
+  float batchscoresumsq=0;
+  float batchbonus=0;
+  bool playoutwin=false;
+  bool playoutjigo=false;
+  float finalscore=0;
   Go::Color playoutcol=playoutmoves.back().getColor();
+  Go::Board *playoutboard=NULL;
   
-  float finalscore;
-  playout->doPlayout(settings,playoutboard,finalscore,playouttree,playoutmoves,col,(params->rave_moves>0?firstlist:NULL),(params->rave_moves>0?secondlist:NULL),(params->rave_moves>0?earlyfirstlist:NULL),(params->rave_moves>0?earlysecondlist:NULL));
-  if (this->getTreeMemoryUsage()>(params->memory_usage_max*1024*1024) && !stopthinking)
-  {
-      gtpe->getOutput()->printfDebug("WARNING! Memory limit reached! Stopping search right now!\n");
-      this->stopThinking();
-  }
-  if (!params->rules_all_stones_alive && !params->cleanup_in_progress && playoutboard->getPassesPlayed()>=2 && (playoutboard->getMovesMade()-currentboard->getMovesMade())<=2)
+  for (int i=0;i<batchsize;i++)
   {
-    finalscore=playoutboard->territoryScore(territorymap,params->territory_threshold)-params->engine->getHandiKomi();
-  }
-  
-  bool playoutwin=Go::Board::isWinForColor(playoutcol,finalscore);
-  bool playoutjigo=(finalscore==0);
-  if (playoutjigo)
-    playouttree->addPartialResult(0.5,1,false);
-  else if (playoutwin)
-    playouttree->addWin(finalscore);
-  else
-    playouttree->addLose(finalscore);
-  
-  playoutboard->updateTerritoryMap(territorymap);
+    if (playoutboard==NULL)
+      playoutboard=currentboard->copy();
+    else
+      currentboard->copyOver(playoutboard); // reuse the board of the previous playout in this batch
+    playoutboard->turnSymmetryOff();
+    if (params->playout_features_enabled)
+      playoutboard->setFeatures(features,params->playout_features_incremental,params->playout_features_incremental_check);
+    if (params->rave_moves>0)
+    {
+      firstlist->clear();
+      secondlist->clear();
+      earlyfirstlist->clear();
+      earlysecondlist->clear();
+    }
+    
+    // the playout appends its moves to the list, so all but the last playout need a fresh copy
+    std::list<Go::Move> batchmoves;
+    if (i<(batchsize-1))
+      batchmoves=playoutmoves;
+    else
+      batchmoves.swap(playoutmoves);
+    
+    playout->doPlayout(settings,playoutboard,finalscore,playouttree,batchmoves,col,(params->rave_moves>0?firstlist:NULL),(params->rave_moves>0?secondlist:NULL),(params->rave_moves>0?earlyfirstlist:NULL),(params->rave_moves>0?earlysecondlist:NULL));
+    if (this->getTreeMemoryUsage()>(params->memory_usage_max*1024*1024) && !stopthinking)
+    {
+        gtpe->getOutput()->printfDebug("WARNING! Memory limit reached! Stopping search right now!\n");
+        this->stopThinking();
+    }
+    if (!params->rules_all_stones_alive && !params->cleanup_in_progress && playoutboard->getPassesPlayed()>=2 && (playoutboard->getMovesMade()-currentboard->getMovesMade())<=2)
+    {
+      finalscore=playoutboard->territoryScore(territorymap,params->territory_threshold)-params->engine->getHandiKomi();
+    }
+    
+    playoutwin=Go::Board::isWinForColor(playoutcol,finalscore);
+    playoutjigo=(finalscore==0);
+    batchplayouts++;
+    if (playoutjigo)
+      batchwins+=0.5;
+    else if (playoutwin)
+      batchwins++;
+    batchscoresum+=finalscore;
+    batchscoresumsq+=finalscore*finalscore;
+    
+    playoutboard->updateTerritoryMap(territorymap);
 
-  //here with with firstlist and secondlist the correlationmap can be updated
-  if (col==Go::BLACK)
-    playoutboard->updateCorrelationMap(correlationmap,firstlist,secondlist);
-  else
-    playoutboard->updateCorrelationMap(correlationmap,secondlist,firstlist);
+    //here with with firstlist and secondlist the correlationmap can be updated
+    if (col==Go::BLACK)
+      playoutboard->updateCorrelationMap(correlationmap,firstlist,secondlist);
+    else
+      playoutboard->updateCorrelationMap(correlationmap,secondlist,firstlist);
 
-  if (!playoutjigo)
-  {
-    Go::Color wincol=(finalscore>0?Go::BLACK:Go::WHITE);
-    playouttree->updateCriticality(playoutboard,wincol);
-  }
-  
-  if (!playouttree->isTerminalResult())
-  {
-    if (params->uct_points_bonus!=0)
+    if (!playoutjigo)
     {
-      float scorediff=(playoutcol==Go::BLACK?1:-1)*finalscore;
-      //float bonus=params->uct_points_bonus*scorediff;
-      float bonus;
-      if (scorediff>0)
-        bonus=params->uct_points_bonus*log(scorediff+1);
+      Go::Color wincol=(finalscore>0?Go::BLACK:Go::WHITE);
+      playouttree->updateCriticality(playoutboard,wincol);
+    }
+    
+    if (!playouttree->isTerminalResult())
+    {
+      if (params->uct_points_bonus!=0)
+      {
+        float scorediff=(playoutcol==Go::BLACK?1:-1)*finalscore;
+        //float bonus=params->uct_points_bonus*scorediff;
+        if (scorediff>0)
+          batchbonus+=params->uct_points_bonus*log(scorediff+1);
+        else
+          batchbonus-=params->uct_points_bonus*log(-scorediff+1);
+        //fprintf(stderr,"[points_bonus]: %+6.1f %+f\n",scorediff,bonus);
+      }
+      if (params->uct_length_bonus!=0)
+      {
+        int moves=playoutboard->getMovesMade();
+        batchbonus+=(playoutwin?1:-1)*params->uct_length_bonus*log(moves);
+        //fprintf(stderr,"[length_bonus]: %6d %+f\n",moves,bonus);
+      }
+    }
+    
+    if (params->debug_on)
+    {
+      if (finalscore==0)
+        gtpe->getOutput()->printfDebug("[result]:jigo\n");
+      else if (playoutwin && playoutcol==col)
+        gtpe->getOutput()->printfDebug("[result]:win (fs:%+.1f)\n",finalscore);
       else
-        bonus=-params->uct_points_bonus*log(-scorediff+1);
-      playouttree->addPartialResult(bonus,0);
-      //fprintf(stderr,"[points_bonus]: %+6.1f %+f\n",scorediff,bonus);
+        gtpe->getOutput()->printfDebug("[result]:lose (fs:%+.1f)\n",finalscore);
     }
-    if (params->uct_length_bonus!=0)
+    
+    if (params->rave_moves>0)
     {
-      int moves=playoutboard->getMovesMade();
-      float bonus=(playoutwin?1:-1)*params->uct_length_bonus*log(moves);
-      playouttree->addPartialResult(bonus,0);
-      //fprintf(stderr,"[length_bonus]: %6d %+f\n",moves,bonus);
+      if (!playoutjigo) // ignore jigos for RAVE
+      {
+        bool blackwin=Go::Board::isWinForColor(Go::BLACK,finalscore);
+        Go::Color wincol=(blackwin?Go::BLACK:Go::WHITE);
+        
+        if (col==Go::BLACK)
+          playouttree->updateRAVE(wincol,firstlist,secondlist,false);
+        else
+          playouttree->updateRAVE(wincol,secondlist,firstlist,false);
+        if (col==Go::BLACK)
+          playouttree->updateRAVE(wincol,earlyfirstlist,earlysecondlist,true);
+        else
+          playouttree->updateRAVE(wincol,earlysecondlist,earlyfirstlist,true);
+      }
     }
+    
+    if (playouttree->isSuperkoViolation())
+      break; // the playout was abandoned, so don't repeat it
   }
   
-  if (params->debug_on)
+  if (batchplayouts==1)
   {
-    if (finalscore==0)
-      gtpe->getOutput()->printfDebug("[result]:jigo\n");
-    else if (playoutwin && playoutcol==col)
-      gtpe->getOutput()->printfDebug("[result]:win (fs:%+.1f)\n",finalscore);
+    if (playoutjigo)
+      playouttree->addPartialResult(0.5,1,false);
+    else if (playoutwin)
+      playouttree->addWin(finalscore);
     else
-      gtpe->getOutput()->printfDebug("[result]:lose (fs:%+.1f)\n",finalscore);
-  }
-  
-  if (params->rave_moves>0)
-  {
-    if (!playoutjigo) // ignore jigos for RAVE
-    {
-      bool blackwin=Go::Board::isWinForColor(Go::BLACK,finalscore);
-      Go::Color wincol=(blackwin?Go::BLACK:Go::WHITE);
-      
-      if (col==Go::BLACK)
-        playouttree->updateRAVE(wincol,firstlist,secondlist,false);
-      else
-        playouttree->updateRAVE(wincol,secondlist,firstlist,false);
-      if (col==Go::BLACK)
-        playouttree->updateRAVE(wincol,earlyfirstlist,earlysecondlist,true);
-      else
-        playouttree->updateRAVE(wincol,earlysecondlist,earlyfirstlist,true);
-    }
+      playouttree->addLose(finalscore);
   }
+  else
+    playouttree->addBatchResult(batchwins,batchplayouts,batchscoresum,batchscoresumsq);
+  if (batchbonus!=0)
+    playouttree->addPartialResult(batchbonus,0);
   
   if (params->uct_virtual_loss)
     playouttree->removeVirtualLoss();
@@ -4958,6 +5403,12 @@ void Engine::doSlowUpdate()
 
 void Engine::generateThread(Worker::Settings *settings)
 {
+  if (params->thread_deterministic)
+  {
+    this->deterministicThread(settings,params->playouts_per_move);
+    return;
+  }
+  
   boost::posix_time::ptime time_start=this->timeNow();
   Go::Color col=currentboard->nextToMove();
   int livegfxupdate=0;
@@ -5029,7 +5480,7 @@ void Engine::generateThread(Worker::Settings *settings)
       }
     #endif
     
-    if (settings->thread->getID()==0 && !mpi_rank_other && params->uct_stop_early && params->uct_slow_update_last==0 && totalplayouts>=(params->playouts_per_move_min))
+    if (settings->thread->getID()==0 && !mpi_rank_other && params->uct_stop_early && totalplayouts>=(params->playouts_per_move_min))
     {
       Tree *besttree=movetree->getRobustChild();
       if (besttree!=NULL)
@@ -5089,6 +5540,12 @@ void Engine::generateThread(Worker::Settings *settings)
 
 void Engine::doNPlayoutsThread(Worker::Settings *settings)
 {
+  if (params->thread_deterministic)
+  {
+    this->deterministicThread(settings,params->playouts_per_move);
+    return;
+  }
+  
   int livegfxupdate=0;
   Go::BitBoard *firstlist=new Go::BitBoard(boardsize);
   Go::BitBoard *secondlist=new Go::BitBoard(boardsize);
@@ -5131,6 +5588,41 @@ void Engine::doNPlayoutsThread(Worker::Settings *settings)
   delete earlysecondlist;  
 }
 
+void Engine::deterministicThread(Worker::Settings *settings, long playouts)
+{
+  Go::BitBoard *firstlist=new Go::BitBoard(boardsize);
+  Go::BitBoard *secondlist=new Go::BitBoard(boardsize);
+  Go::BitBoard *earlyfirstlist=new Go::BitBoard(boardsize);
+  Go::BitBoard *earlysecondlist=new Go::BitBoard(boardsize);
+  int batchsize=(params->uct_leaf_playouts>1?params->uct_leaf_playouts:1);
+  long steps=(playouts+batchsize-1)/batchsize;
+  int threads=threadpool->getSize();
+  
+  //step i is done by thread i%threads, strictly in order, so the tree sees the same sequence of updates every run
+  for (long step=settings->thread->getID();step<steps;step+=threads)
+  {
+    {
+      boost::mutex::scoped_lock lock(deterministicmutex);
+      while (deterministicstep!=step)
+        deterministicturn.wait(lock);
+    }
+    
+    if (!movetree->isTerminalResult() && !stopthinking)
+      this->doPlayout(settings,firstlist,secondlist,earlyfirstlist,earlysecondlist);
+    
+    {
+      boost::mutex::scoped_lock lock(deterministicmutex);
+      deterministicstep++;
+    }
+    deterministicturn.notify_all();
+  }
+  
+  delete firstlist;
+  delete secondlist;
+  delete earlyfirstlist;
+  delete earlysecondlist;
+}
+
 void Engine::doThreadWork(Worker::Settings *settings)
 {
   switch (params->thread_job)
@@ -5144,6 +5636,18 @@ void Engine::doThreadWork(Worker::Settings *settings)
     case Parameters::TJ_DONPLTS:
       this->doNPlayoutsThread(settings);
       break;
+    case Parameters::TJ_TRAIN:
+      if (trainer!=NULL)
+        trainer->doThreadWork(settings);
+      break;
+    case Parameters::TJ_HARVEST:
+      if (harvester!=NULL)
+        harvester->doThreadWork(settings);
+      break;
+    case Parameters::TJ_PREDICT:
+      if (moveprediction!=NULL)
+        moveprediction->doThreadWork(settings);
+      break;
   }
 }
 
@@ -5699,4 +6203,23 @@ float Engine::getOldMoveValue(Go::Move m)
   else
     return 0; //was a pass move
 }
-    
+
+void Engine::clearStatistics()
+{
+  Engine::ThreadStatistics empty;
+  memset(&empty,0,sizeof(Engine::ThreadStatistics));
+  threadstatistics.assign(threadpool->getSize(),empty);
+}
+
+long Engine::sumStatistics(long totals[])
+{
+  long sum=0;
+  for (int i=0;i<STATISTICS_NUM;i++)
+  {
+    totals[i]=0;
+    for (unsigned int t=0;t<threadstatistics.size();t++)
+      totals[i]+=threadstatistics[t].statistics[i];
+    sum+=totals[i];
+  }
+  return sum;
+}
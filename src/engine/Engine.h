@@ -20,6 +20,7 @@
 #define RAVE_MOVES_USE 0.00
 #define RAVE_ONLY_FIRST_MOVE false
 #define UCT_EXPAND_AFTER 10
+#define UCT_LEAF_PLAYOUTS 1
 #define UCT_KEEP_SUBTREE true
 #define UCT_SYMMETRY_USE true
 #define UCT_VIRTUAL_LOSS true
@@ -84,6 +85,8 @@
 #define FEATURES_PASS_NO_MOVE_FOR_LASTDIST false
 #define MM_LEARN_DELTA 0.01
 #define MM_LEARN_MIN_PLAYOUTS 100
+#define MM_TRAIN_SAMPLE 1.0
+#define MM_TRAIN_ITERATIONS 20
 
 #define RULES_POSITIONAL_SUPERKO_ENABLED true
 #define RULES_SUPERKO_TOP_PLY false
@@ -99,6 +102,7 @@
 #define PLAYOUT_PATTERNS_GAMMAS_P 0.0
 #define PLAYOUT_FEATURES_ENABLED false
 #define PLAYOUT_FEATURES_INCREMENTAL false
+#define PLAYOUT_FEATURES_INCREMENTAL_CHECK false
 #define PLAYOUT_LASTATARI_P 1.0
 #define PLAYOUT_LASTATARI_LEAVEDOUBLE true
 #define PLAYOUT_LASTATARI_CAPTUREATTACHED 1.0
@@ -116,9 +120,11 @@
 #define PLAYOUT_RANDOM_WEIGHT_TERRITORY_F0 0.0
 #define PLAYOUT_RANDOM_WEIGHT_TERRITORY_F1 0.0
 #define PLAYOUT_CIRCPATTERN_N 0
+#define PLAYOUT_CIRCPATTERN_MATCH false
 #define PLAYOUT_ANYCAPTURE_P 1.0
 #define PLAYOUT_LGRF1_ENABLED true
 #define PLAYOUT_LGRF_LOCAL false
+#define PLAYOUT_LGRF_MERGE_INTERVAL 16
 #define PLAYOUT_LGRF1_SAFE_ENABLED false
 #define PLAYOUT_AVOID_LBRF1_P 0.0
 #define PLAYOUT_AVOID_LBMF_P 0.0
@@ -130,7 +136,12 @@
 #define PLAYOUT_LGPF_ENABLED false
 #define PLAYOUT_MERCY_RULE_ENABLED true
 #define PLAYOUT_MERCY_RULE_FACTOR 0.40
+#define PLAYOUT_SETTLED_CUTOFF false
+#define PLAYOUT_SETTLED_CUTOFF_EMPTY 0.25
 #define PLAYOUT_RANDOM_CHANCE 0.00
+#define PLAYOUT_STATS_TIMING false
+#define PLAYOUT_TRACE_INTERVAL 0
+#define PLAYOUT_TRACE_SIZE 65536
 #define PLAYOUT_RANDOM_APPROACH_P 0.00
 #define PLAYOUT_LAST2LIBATARI_ENABLED true
 #define PLAYOUT_LAST2LIBATARI_COMPLEX true
@@ -140,6 +151,7 @@
 #define PLAYOUT_POOLRAVE_P 0.5
 #define PLAYOUT_POOLRAVE_K 20
 #define PLAYOUT_POOLRAVE_MIN_PLAYOUTS 50
+#define PLAYOUT_POOLRAVE_REFRESH 0.05
 #define PLAYOUT_AVOID_SELFATARI true
 #define PLAYOUT_AVOID_SELFATARI_SIZE 5 // biggest killing shape is 6 stones
 #define PLAYOUT_AVOID_SELFATARI_COMPLEX false // uses pseudoends to determine smaller not killing shapes
@@ -155,6 +167,7 @@
 #define TERRITORY_THRESHOLD 0.6
 
 #define THREAD_COUNT 1
+#define THREAD_DETERMINISTIC false
 #define MEMORY_USAGE_MAX (2*1024)
 
 #define INTERRUPTS_ENABLED false
@@ -199,6 +212,7 @@
 #include <list>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/posix_time/posix_time_io.hpp>
+#include <boost/thread/condition_variable.hpp>
 #ifdef HAVE_MPI
   #include <mpi.h>
 #endif
@@ -222,6 +236,12 @@ namespace Pattern
 #include "Worker.h"
 //from "DecisionTree.h":
 class DecisionTree;
+//from "Trainer.h":
+class Trainer;
+//from "Harvester.h":
+class Harvester;
+//from "MovePrediction.h":
+class MovePrediction;
 #include "../gtp/Gtp.h"
 #ifdef HAVE_WEB
   //from "../web/Web.h":
@@ -257,6 +277,18 @@ class Engine
       LGRF2,
       STATISTICS_NUM     //is set to the number of entries !!
     };
+    
+    /** Playout statistics gathered by a single worker thread.
+     * Each thread only writes its own entry, the entries are summed when they are reported.
+     */
+    struct ThreadStatistics
+    {
+      long statistics[STATISTICS_NUM];
+      long stageattempts[Playout::STAGE_NUM];
+      long stagehits[Playout::STAGE_NUM];
+      double stagetime[Playout::STAGE_NUM]; //in microseconds
+      char padding[64]; //keep the entries of different threads on separate cache lines
+    };
 
     /** Create an engine.
      * @param ge GTP engine to use.
@@ -330,15 +362,18 @@ class Engine
     bool writeGameSGF(std::string filename);
 
     float valueCircPattern(std::string circpattern) {return features->valueCircPattern(circpattern);}
+    float valueCircPattern(const Pattern::Circular &pc) {return features->valueCircPattern(pc);}
 
     bool isCircPattern(std::string circpattern) {return features->isCircPattern(circpattern);}
+    bool isCircPattern(const Pattern::Circular &pc) {return features->isCircPattern(pc);}
 
     Pattern::CircularDictionary *getCircDict() {return features->getCircDict();}
     int getCircSize() {return features->getCircSize();}
-    void statisticsPlus(StatNames i) {statistics[i]++;}
-    void clearStatistics() {int i; for (i=0;i<STATISTICS_NUM;i++) statistics[i]=0;}
-    long statisticsSum() {int i; long sum=0; for (i=0;i<STATISTICS_NUM;i++) sum+=statistics[i]; return sum;}
-    long getStatistics(int i) {return statistics[i]*1000/(statisticsSum()+1);} //+1 avoid crash
+    Engine::ThreadStatistics *getThreadStatistics(Worker::Settings *settings) {return &threadstatistics[settings->thread->getID()];}
+    void statisticsPlus(Worker::Settings *settings, StatNames i) {threadstatistics[settings->thread->getID()].statistics[i]++;}
+    void clearStatistics();
+    /** Sum the statistics of all threads into @p totals and return the sum over all entries. */
+    long sumStatistics(long totals[]);
     Go::TerritoryMap *getTerritoryMap() const {return territorymap;}
     float getCorrelation(int pos) const {return (correlationmap->get(pos)).getCorrelation();}
     float getOldMoveValue(Go::Move m);
@@ -365,14 +400,20 @@ class Engine
     Playout *playout;
     volatile bool stopthinking;
     volatile bool stoppondering;
+    boost::mutex deterministicmutex;
+    boost::condition_variable deterministicturn;
+    long deterministicstep;
     Worker::Pool *threadpool;
     Go::TerritoryMap *territorymap;
     Go::ObjectBoard<Go::CorrelationData> *correlationmap;
     
-    long statistics[STATISTICS_NUM];
+    std::vector<Engine::ThreadStatistics> threadstatistics;
 
     bool isgamefinished;
     std::list<DecisionTree*> decisiontrees;
+    Trainer *trainer;
+    Harvester *harvester;
+    MovePrediction *moveprediction;
 
     //This holds the values of moves, calculated earlier
     //If a move is done the not used moves are here
@@ -489,11 +530,13 @@ class Engine
     void generateThread(Worker::Settings *settings);
     void ponderThread(Worker::Settings *settings);
     void doNPlayoutsThread(Worker::Settings *settings);
+    void deterministicThread(Worker::Settings *settings, long playouts);
 
     std::string chat(bool pm,std::string name,std::string msg);
 
     void gameFinished();
     void learnFromTree(Go::Board *tmpboard, Tree *learntree, std::ostringstream *ssun, int move_num);
+    void harvestPatterns(Gtp::Engine* gtpe, Gtp::Command* cmd, std::string listfilename, std::string outfilename);
     
     static void ponderWrapper(void *instance) { ((Engine*)instance)->ponder(); };
     void ponder();
@@ -534,11 +577,20 @@ class Engine
     static void gtpFeatureProbDistribution(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpListAllPatterns(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpLoadFeatureGammas(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpTrainFeatureGammas(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpHarvestPatterns(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpHarvestCircPatterns(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpHarvestCircPatternsNot(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpMovePredictionTest(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpSaveFeatureGammas(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpSaveFeatureGammasInline(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpSaveFeatureGammasBinary(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpLoadCircPatterns(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpLoadCircPatternsNot(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpSaveCircPatternValues(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpSaveCircPatternsBinary(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpSaveCircPatternsNotBinary(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpSaveCircPatternValuesBinary(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpLoadCircPatternValues(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpListFeatureIds(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpShowCFGFrom(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
@@ -561,6 +613,8 @@ class Engine
 
     static void gtpExplainLastMove(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpBoardStats(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpPlayoutStats(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
+    static void gtpPlayoutTrace(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpShowSymmetryTransforms(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpShowNakadeCenters(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
     static void gtpShowTreeLiveGfx(void *instance, Gtp::Engine* gtpe, Gtp::Command* cmd);
@@ -10,6 +10,12 @@
 #include "DecisionTree.h"
 #include "Engine.h"
 
+//SSE2 is part of every x86-64 target, and of 32-bit builds with -msse2 (or /arch:SSE2 on MSVC)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+  #define FEATURES_SSE2
+  #include <emmintrin.h>
+#endif
+
 //moved here, so it is not parsed any time feature.h is included
 const std::string FEATURES_DEFAULT=
   "pass:1 0.950848 \n"
@@ -646,6 +652,8 @@ Features::Features(Parameters *prms) : params(prms)
 {
   patterngammas=new Pattern::ThreeByThreeGammas();
   patternids=new Pattern::ThreeByThreeGammas();
+  patterngammatable=new Pattern::ThreeByThreeGammaTable();
+  localpatterngammas=new Pattern::LocalGammaTable();
   
   for (int i=0;i<PASS_LEVELS;i++)
     gammas_pass[i]=1.0;
@@ -678,18 +686,99 @@ Features::Features(Parameters *prms) : params(prms)
   circgammas = new std::vector<float>();
   
   circpatternsize=0;
+  circlevelsmaxsize=0;
+  loadinggammas=false;
   num_circmoves=0;
   num_circmoves_not=0;
+  circpatternsdb=NULL;
+  circpatternsnotdb=NULL;
+  circpatternvaluesdb=NULL;
 }
 
 Features::~Features()
 {
   delete patterngammas;
   delete patternids;
+  delete patterngammatable;
+  delete localpatterngammas;
   delete circdict;
   delete circgammas;
   delete circstrings;
   delete circlevels;
+  if (circpatternsdb!=NULL)
+    delete circpatternsdb;
+  if (circpatternsnotdb!=NULL)
+    delete circpatternsnotdb;
+  if (circpatternvaluesdb!=NULL)
+    delete circpatternvaluesdb;
+}
+
+inline unsigned int Features::levelBorderDist(int dist)
+{
+  return (dist<BORDERDIST_LEVELS?dist+1:0);
+}
+
+inline int Features::getLastDistFrom(Features::FeatureClass featclass, Go::Board *board, int &maxdist) const
+{
+  Go::Move lastmove=board->getLastMove();
+  Go::Move secondlastmove=board->getSecondLastMove();
+  int frompos=-1;
+  maxdist=0;
+  if (featclass==Features::LASTDIST)
+  {
+    //this returned 0 in case of pass before. This lead playing bad after a pass, as it
+    //tends to let the opponent play at an other place, which might be bad.
+    if (lastmove.isResign() || (!params->features_pass_no_move_for_lastdist && lastmove.isPass()))
+      return -1;
+    else if (lastmove.isPass())
+    {
+      if (secondlastmove.isPass() || secondlastmove.isResign())
+        return -1;
+      frompos=secondlastmove.getPosition();
+      maxdist=SECONDLASTDIST_LEVELS;
+    }
+    else
+    {
+      frompos=lastmove.getPosition();
+      maxdist=LASTDIST_LEVELS;
+    }
+  }
+  else
+  {
+    if (secondlastmove.isPass() || secondlastmove.isResign())
+      return -1;
+    //ignore second last, if last was pass
+    if (params->features_pass_no_move_for_lastdist && lastmove.isPass())
+      return -1;
+    frompos=secondlastmove.getPosition();
+    maxdist=SECONDLASTDIST_LEVELS;
+  }
+  
+  if (params->features_only_small)
+    maxdist=3;
+  return frompos;
+}
+
+inline unsigned int Features::levelDist(int dist, int maxdist)
+{
+  return ((dist!=-1 && dist<=maxdist)?dist:0);
+}
+
+inline Go::ObjectBoard<int> *Features::getCFGDist(Features::FeatureClass featclass, Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, int &maxdist)
+{
+  if (board->getLastMove().isPass() || board->getLastMove().isResign())
+    return NULL;
+  
+  if (featclass==Features::CFGLASTDIST)
+  {
+    maxdist=CFGLASTDIST_LEVELS;
+    return cfglastdist;
+  }
+  else
+  {
+    maxdist=CFGSECONDLASTDIST_LEVELS;
+    return cfgsecondlastdist;
+  }
 }
 
 unsigned int Features::matchFeatureClass(Features::FeatureClass featclass, Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, bool checkforvalidmove) const
@@ -856,99 +945,26 @@ unsigned int Features::matchFeatureClass(Features::FeatureClass featclass, Go::B
         return 0;
     }
     case Features::BORDERDIST:
-    {
-      int dist=board->getDistanceToBorder(move.getPosition());
-      
-      if (dist<BORDERDIST_LEVELS)
-        return (dist+1);
-      else
-        return 0;
-    }
+      return Features::levelBorderDist(board->getDistanceToBorder(move.getPosition()));
     case Features::LASTDIST:
-    {
-      if (board->getLastMove().isResign() || (!params->features_pass_no_move_for_lastdist && board->getLastMove().isPass()))
-        return 0;
-      //this returned 0 in case of pass before. This lead playing bad after a pass, as it
-      //tends to let the opponent play at an other place, which might be bad.
-      if (board->getLastMove().isPass())
-      {
-        if (board->getSecondLastMove().isPass() || board->getSecondLastMove().isResign())
-          return 0;
-        int dist=board->getCircularDistance(move.getPosition(),board->getSecondLastMove().getPosition());
-        
-        int maxdist=SECONDLASTDIST_LEVELS;
-        if (params->features_only_small)
-          maxdist=3;
-        
-        if (dist<=maxdist)
-          return dist;
-        else
-          return 0;
-      }
-      
-      int dist=board->getCircularDistance(move.getPosition(),board->getLastMove().getPosition());
-      
-      int maxdist=LASTDIST_LEVELS;
-      if (params->features_only_small)
-        maxdist=3;
-      
-      if (dist<=maxdist)
-        return dist;
-      else
-        return 0;
-    }
     case Features::SECONDLASTDIST:
     {
-      if (board->getSecondLastMove().isPass() || board->getSecondLastMove().isResign())
+      int maxdist;
+      int frompos=this->getLastDistFrom(featclass,board,maxdist);
+      if (frompos<0)
         return 0;
-      //ignore second last, if last was pass
-      if (params->features_pass_no_move_for_lastdist && board->getLastMove().isPass())
-        return 0;
-      
-      int dist=board->getCircularDistance(move.getPosition(),board->getSecondLastMove().getPosition());
       
-      int maxdist=SECONDLASTDIST_LEVELS;
-      if (params->features_only_small)
-        maxdist=3;
-      
-      if (dist<=maxdist)
-        return dist;
-      else
-        return 0;
+      return Features::levelDist(board->getCircularDistance(move.getPosition(),frompos),maxdist);
     }
     case Features::CFGLASTDIST:
-    {
-      if (board->getLastMove().isPass() || board->getLastMove().isResign())
-        return 0;
-      
-      if (cfglastdist==NULL)
-        return 0;
-      
-      int dist=cfglastdist->get(move.getPosition());
-      if (dist==-1)
-        return 0;
-      
-      if (dist<=CFGLASTDIST_LEVELS)
-        return dist;
-      else
-        return 0;
-    }
     case Features::CFGSECONDLASTDIST:
     {
-      if (board->getLastMove().isPass() || board->getLastMove().isResign())
-        return 0;
-      
-      if (cfgsecondlastdist==NULL)
+      int maxdist;
+      Go::ObjectBoard<int> *cfgdist=Features::getCFGDist(featclass,board,cfglastdist,cfgsecondlastdist,maxdist);
+      if (cfgdist==NULL)
         return 0;
       
-      int dist=cfgsecondlastdist->get(move.getPosition());
-      if (dist==-1)
-        return 0;
-      
-      if (dist<=CFGSECONDLASTDIST_LEVELS)
-        return dist;
-      else
-        return 0;
+      return Features::levelDist(cfgdist->get(move.getPosition()),maxdist);
     }
     case Features::PATTERN3X3:
     {
@@ -967,10 +983,7 @@ unsigned int Features::matchFeatureClass(Features::FeatureClass featclass, Go::B
       Go::Color col=move.getColor();
       int pos=move.getPosition();
       
-      Pattern::Circular pattcirc = Pattern::Circular(circdict,board,pos,PATTERN_CIRC_MAXSIZE);
-      if (col == Go::WHITE)
-        pattcirc.invert();
-      pattcirc.convertToSmallestEquivalent(circdict);
+      Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(circdict,board,pos,PATTERN_CIRC_MAXSIZE,col==Go::WHITE);
 
       for (int s=PATTERN_CIRC_MAXSIZE;s>=3;s--)
       {
@@ -1169,6 +1182,7 @@ void Features::learnFeatureGammaMoves(Features::FeatureClass featclass, Go::Boar
           if (patterngammas->hasGamma(level_1))
           {
             patterngammas->learnGamma(level_1,diff_gamma_i*params->mm_learn_delta);
+            patterngammatable->update(patterngammas,level_1);
             break;
           }
           else
@@ -1220,6 +1234,7 @@ void Features::learnFeatureGamma(Features::FeatureClass featclass, unsigned int
     if (patterngammas->hasGamma(level))
     {
       patterngammas->learnGamma(level,learn_diff);
+      patterngammatable->update(patterngammas,level);
       return;
     }
     else
@@ -1259,26 +1274,60 @@ void Features::learnFeatureGamma(Features::FeatureClass featclass, unsigned int
 }
 
 float Features::getMoveGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, bool checkforvalidmove, bool usecircularpatterns) const
+{
+  if (checkforvalidmove && !board->validMove(move))
+    return 0;
+  
+  return this->getMoveLocalGamma(board,move,false,usecircularpatterns)*this->getMoveDistanceGamma(board,cfglastdist,cfgsecondlastdist,move);
+}
+
+float Features::getMoveLocalGamma(Go::Board *board, Go::Move move, bool checkforvalidmove, bool usecircularpatterns) const
 {
   float g=1.0;
   
   if (checkforvalidmove && !board->validMove(move))
     return 0;
   
-  g*=this->getFeatureGamma(Features::PASS,this->matchFeatureClass(Features::PASS,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::CAPTURE,this->matchFeatureClass(Features::CAPTURE,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::EXTENSION,this->matchFeatureClass(Features::EXTENSION,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::SELFATARI,this->matchFeatureClass(Features::SELFATARI,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::ATARI,this->matchFeatureClass(Features::ATARI,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::BORDERDIST,this->matchFeatureClass(Features::BORDERDIST,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::LASTDIST,this->matchFeatureClass(Features::LASTDIST,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::SECONDLASTDIST,this->matchFeatureClass(Features::SECONDLASTDIST,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::CFGLASTDIST,this->matchFeatureClass(Features::CFGLASTDIST,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::CFGSECONDLASTDIST,this->matchFeatureClass(Features::CFGSECONDLASTDIST,board,cfglastdist,cfgsecondlastdist,move,false));
-  g*=this->getFeatureGamma(Features::PATTERN3X3,this->matchFeatureClass(Features::PATTERN3X3,board,cfglastdist,cfgsecondlastdist,move,false));
+  g*=this->getFeatureGamma(Features::PASS,this->matchFeatureClass(Features::PASS,board,NULL,NULL,move,false));
+  g*=this->getFeatureGamma(Features::CAPTURE,this->matchFeatureClass(Features::CAPTURE,board,NULL,NULL,move,false));
+  g*=this->getFeatureGamma(Features::EXTENSION,this->matchFeatureClass(Features::EXTENSION,board,NULL,NULL,move,false));
+  g*=this->getFeatureGamma(Features::SELFATARI,this->matchFeatureClass(Features::SELFATARI,board,NULL,NULL,move,false));
+  g*=this->getFeatureGamma(Features::ATARI,this->matchFeatureClass(Features::ATARI,board,NULL,NULL,move,false));
+  g*=this->getFeatureGamma(Features::BORDERDIST,this->matchFeatureClass(Features::BORDERDIST,board,NULL,NULL,move,false));
+  if (move.isNormal())
+    g*=patterngammatable->getGamma(move.getColor(),Pattern::ThreeByThree::makeHash(board,move.getPosition()));
+  else
+    g*=this->getFeatureGamma(Features::PATTERN3X3,0);
   if (circlevels->size()>0)
-    g*=this->getFeatureGamma(Features::CIRCPATT,this->matchFeatureClass(Features::CIRCPATT,board,cfglastdist,cfgsecondlastdist,move,false));
+    g*=this->getFeatureGamma(Features::CIRCPATT,this->matchFeatureClass(Features::CIRCPATT,board,NULL,NULL,move,false));
+  if (this->usesLocalPatterns())
+    g*=this->getLocalPatternGamma(board,move);
 
+  return this->applyMoveExtraGammas(board,move,usecircularpatterns,g);
+}
+
+float Features::getLocalPatternGamma(Go::Board *board, Go::Move move) const
+{
+  if (!move.isNormal())
+    return 1.0;
+  
+  float g=1.0;
+  Pattern::LocalHashes *hashes=board->getLocalPatternHashes();
+  for (int s=0;s<PATTERN_LOCAL_SHAPES;s++)
+  {
+    Pattern::Local::Shape shape=(Pattern::Local::Shape)s;
+    Go::ZobristHash hash;
+    if (hashes!=NULL)
+      hash=hashes->getHash(shape,move.getPosition());
+    else
+      hash=Pattern::Local::makeHash(shape,board,move.getPosition());
+    g*=localpatterngammas->getGamma(move.getColor(),hash);
+  }
+  return g;
+}
+
+float Features::applyMoveExtraGammas(Go::Board *board, Go::Move move, bool usecircularpatterns, float g) const
+{
   if (params->features_dt_use)
   {
     float w = DecisionTree::getCollectionWeight(params->engine->getDecisionTrees(),board,move);
@@ -1288,25 +1337,21 @@ float Features::getMoveGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist
 
   if (params->uct_factor_circpattern>0.0 &&move.isNormal() && usecircularpatterns)
   {
-    Pattern::Circular pattcirc=Pattern::Circular(circdict,board,move.getPosition(),circpatternsize);
-    if (move.getColor()==Go::WHITE)
-            pattcirc.invert();
-    pattcirc.convertToSmallestEquivalent(circdict);
-    if (this->valueCircPattern(pattcirc.toString(circdict))>0.0)
+    Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(circdict,board,move.getPosition(),circpatternsize,move.getColor()==Go::WHITE);
+    float v=this->valueCircPattern(pattcirc);
+    if (v>0.0)
     {
-     //fprintf(stderr,"found pattern %f %s (stones %d)\n",params->test_p1,pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
-     //fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(pattcirc.toString(circdict)),pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
-     g*=1.0+exp(-0.5*circpatternsize)*params->uct_factor_circpattern * this->valueCircPattern(pattcirc.toString(circdict)); 
+     //fprintf(stderr,"found pattern %f %s (stones %d)\n",v,pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
+     g*=1.0+exp(-0.5*circpatternsize)*params->uct_factor_circpattern * v; 
     }
     for (int j=circpatternsize-1;j>=params->uct_circpattern_minsize;j--)
     {
       Pattern::Circular tmp=pattcirc.getSubPattern(circdict,j);
-      tmp.convertToSmallestEquivalent(circdict);
-      std::string tmpPattString=tmp.toString(circdict);
-      if (this->valueCircPattern(tmpPattString)>0.0)
+      v=this->valueCircPattern(tmp);
+      if (v>0.0)
       {
-       //fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(tmpPattString),tmpPattString.c_str(),tmp.countStones(circdict));
-       g*=1.0+exp(-0.5*j)*params->uct_factor_circpattern * this->valueCircPattern(tmpPattString); //params->uct_factor_circpattern_exponent
+       //fprintf(stderr,"found pattern %f %s (stones %d)\n",v,tmp.toString(circdict).c_str(),tmp.countStones(circdict));
+       g*=1.0+exp(-0.5*j)*params->uct_factor_circpattern * v; //params->uct_factor_circpattern_exponent
       }
     }
   }
@@ -1347,6 +1392,45 @@ float Features::getMoveGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist
   return g;
 }
 
+float Features::getMoveDistanceGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move) const
+{
+  float g=1.0;
+  
+  g*=this->getFeatureGamma(Features::LASTDIST,this->matchFeatureClass(Features::LASTDIST,board,cfglastdist,cfgsecondlastdist,move,false));
+  g*=this->getFeatureGamma(Features::SECONDLASTDIST,this->matchFeatureClass(Features::SECONDLASTDIST,board,cfglastdist,cfgsecondlastdist,move,false));
+  g*=this->getFeatureGamma(Features::CFGLASTDIST,this->matchFeatureClass(Features::CFGLASTDIST,board,cfglastdist,cfgsecondlastdist,move,false));
+  g*=this->getFeatureGamma(Features::CFGSECONDLASTDIST,this->matchFeatureClass(Features::CFGSECONDLASTDIST,board,cfglastdist,cfgsecondlastdist,move,false));
+  
+  return g;
+}
+
+bool Features::usesDistantFeatures() const
+{
+  return (params->features_ladders || params->features_dt_use || params->uct_factor_circpattern>0.0);
+}
+
+int Features::getCircLevelsRadius() const
+{
+  if (circlevels->size()==0)
+    return 0;
+  return circdict->getRadius(circlevelsmaxsize);
+}
+
+bool Features::usesCFGDist() const
+{
+  for (int i=0;i<CFGLASTDIST_LEVELS;i++)
+  {
+    if (gammas_cfglastdist[i]>0 && gammas_cfglastdist[i]!=1.0)
+      return true;
+  }
+  for (int i=0;i<CFGSECONDLASTDIST_LEVELS;i++)
+  {
+    if (gammas_cfgsecondlastdist[i]>0 && gammas_cfgsecondlastdist[i]!=1.0)
+      return true;
+  }
+  return false;
+}
+
 int Features::learnMoveGammaC(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move,float learn_diff)
 {
   int C=0;
@@ -1367,27 +1451,19 @@ int Features::learnMoveGammaC(Go::Board *board, Go::ObjectBoard<int> *cfglastdis
 
   if (params->uct_factor_circpattern>0.0 &&move.isNormal())
   {
-    Pattern::Circular pattcirc=Pattern::Circular(circdict,board,move.getPosition(),circpatternsize);
-    if (move.getColor()==Go::WHITE)
-            pattcirc.invert();
-    pattcirc.convertToSmallestEquivalent(circdict);
-    fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(pattcirc.toString(circdict)),pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
-    if (this->valueCircPattern(pattcirc.toString(circdict))>0.0)
+    Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(circdict,board,move.getPosition(),circpatternsize,move.getColor()==Go::WHITE);
+    fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(pattcirc),pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
+    if (this->valueCircPattern(pattcirc)>0.0)
     {
-     //fprintf(stderr,"found pattern %f %s (stones %d)\n",params->test_p1,pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
-     //fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(pattcirc.toString(circdict)),pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
-     //this->learnCircPattern(pattcirc.toString(circdict),params->mm_learn_delta*learn_diff);
+     //this->learnCircPattern(pattcirc,params->mm_learn_delta*learn_diff);
      C++;
     }
     for (int j=circpatternsize-1;j>=params->uct_circpattern_minsize;j--)
     {
       Pattern::Circular tmp=pattcirc.getSubPattern(circdict,j);
-      tmp.convertToSmallestEquivalent(circdict);
-      std::string tmpPattString=tmp.toString(circdict);
-      if (this->valueCircPattern(tmpPattString)>0.0)
+      if (this->valueCircPattern(tmp)>0.0)
       {
-       //fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(tmpPattString),tmpPattString.c_str(),tmp.countStones(circdict));
-       //this->learnCircPattern(tmpPattString,params->mm_learn_delta*learn_diff); //params->uct_factor_circpattern_exponent
+       //this->learnCircPattern(tmp,params->mm_learn_delta*learn_diff); //params->uct_factor_circpattern_exponent
         C++;
       }
     }
@@ -1417,10 +1493,11 @@ bool Features::learnMovesGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdi
   {
     //Go::Move move_1=it->second;
     float C_iM_gamma_i[PATTERN_CIRC_MAXSIZE];
-    std::string stringHERE[PATTERN_CIRC_MAXSIZE];
+    Pattern::Circular *pattHERE[PATTERN_CIRC_MAXSIZE];
     for (int i=0;i<PATTERN_CIRC_MAXSIZE;i++)
     {
       C_iM_gamma_i[i]=0;
+      pattHERE[i]=NULL;
       //gammaHERE[i]=0;
     }
     std::map<float,Go::Move>::iterator it_int;
@@ -1429,26 +1506,23 @@ bool Features::learnMovesGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdi
       Go::Move move=it_int->second;
       if (params->uct_factor_circpattern>0.0 &&move.isNormal())
       {
-        Pattern::Circular pattcirc=Pattern::Circular(circdict,board,move.getPosition(),circpatternsize);
-        if (move.getColor()==Go::WHITE)
-                pattcirc.invert();
-        pattcirc.convertToSmallestEquivalent(circdict);
-        if (this->valueCircPattern(pattcirc.toString(circdict))>0.0)
+        Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(circdict,board,move.getPosition(),circpatternsize,move.getColor()==Go::WHITE);
+        if (this->valueCircPattern(pattcirc)>0.0)
         {
          C_iM_gamma_i[circpatternsize]+=move_gamma.find(it_int->second.getPosition())->second;
-         //gammaHERE[circpatternsize]=this->valueCircPattern(pattcirc.toString(circdict));
-         stringHERE[circpatternsize]=pattcirc.toString(circdict);
+         //gammaHERE[circpatternsize]=this->valueCircPattern(pattcirc);
+         delete pattHERE[circpatternsize];
+         pattHERE[circpatternsize]=new Pattern::Circular(pattcirc);
         }
         for (int j=circpatternsize-1;j>=params->uct_circpattern_minsize;j--)
         {
           Pattern::Circular tmp=pattcirc.getSubPattern(circdict,j);
-          tmp.convertToSmallestEquivalent(circdict);
-          std::string tmpPattString=tmp.toString(circdict);
-          if (this->valueCircPattern(tmpPattString)>0.0)
+          if (this->valueCircPattern(tmp)>0.0)
           {
            C_iM_gamma_i[j]+=move_gamma.find(it_int->second.getPosition())->second;
-           //gammaHERE[j]=this->valueCircPattern(tmpPattString);
-           stringHERE[j]=tmpPattString;
+           //gammaHERE[j]=this->valueCircPattern(tmp);
+           delete pattHERE[j];
+           pattHERE[j]=new Pattern::Circular(tmp);
           }
         }
       }
@@ -1469,9 +1543,11 @@ bool Features::learnMovesGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdi
           //this was a loss
           diff_gamma_i=-C_iM_gamma_i[i]/sum_gammas;
         }
-        this->learnCircPattern(stringHERE[i],params->mm_learn_delta*diff_gamma_i); 
+        this->learnCircPattern(*pattHERE[i],params->mm_learn_delta*diff_gamma_i); 
       }
     }
+    for (int i=0;i<PATTERN_CIRC_MAXSIZE;i++)
+      delete pattHERE[i];
   }
 
   return true;
@@ -1499,26 +1575,20 @@ bool Features::learnMoveGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdis
 
   if (params->uct_factor_circpattern>0.0 &&move.isNormal())
   {
-    Pattern::Circular pattcirc=Pattern::Circular(circdict,board,move.getPosition(),circpatternsize);
-    if (move.getColor()==Go::WHITE)
-            pattcirc.invert();
-    pattcirc.convertToSmallestEquivalent(circdict);
-    fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(pattcirc.toString(circdict)),pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
-    if (this->valueCircPattern(pattcirc.toString(circdict))>0.0)
+    Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(circdict,board,move.getPosition(),circpatternsize,move.getColor()==Go::WHITE);
+    fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(pattcirc),pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
+    if (this->valueCircPattern(pattcirc)>0.0)
     {
-     //fprintf(stderr,"found pattern %f %s (stones %d)\n",params->test_p1,pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
-     fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(pattcirc.toString(circdict)),pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
-     this->learnCircPattern(pattcirc.toString(circdict),params->mm_learn_delta*learn_diff); 
+     fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(pattcirc),pattcirc.toString(circdict).c_str(),pattcirc.countStones(circdict));
+     this->learnCircPattern(pattcirc,params->mm_learn_delta*learn_diff); 
     }
     for (int j=circpatternsize-1;j>=params->uct_circpattern_minsize;j--)
     {
       Pattern::Circular tmp=pattcirc.getSubPattern(circdict,j);
-      tmp.convertToSmallestEquivalent(circdict);
-      std::string tmpPattString=tmp.toString(circdict);
-      if (this->valueCircPattern(tmpPattString)>0.0)
+      if (this->valueCircPattern(tmp)>0.0)
       {
-       fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(tmpPattString),tmpPattString.c_str(),tmp.countStones(circdict));
-       this->learnCircPattern(tmpPattString,params->mm_learn_delta*learn_diff); //params->uct_factor_circpattern_exponent
+       fprintf(stderr,"found pattern %f %s (stones %d)\n",this->valueCircPattern(tmp),tmp.toString(circdict).c_str(),tmp.countStones(circdict));
+       this->learnCircPattern(tmp,params->mm_learn_delta*learn_diff); //params->uct_factor_circpattern_exponent
       }
     }
   }
@@ -1528,39 +1598,84 @@ bool Features::learnMoveGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdis
 
 float Features::getBoardGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col) const
 {
-  float total=0;
+  Go::ObjectBoard<float> gammas(board->getSize());
+  return this->getBoardGammas(board,cfglastdist,cfgsecondlastdist,col,&gammas);
+}
+
+float Features::getBoardGammas(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, Go::ObjectBoard<float> *gammas) const
+{
+  int size=board->getSize();
   
+  //evaluate one feature class at a time over all legal moves, multiplying in the same order as getMoveGamma()
+  std::vector<int> moves;
+  moves.reserve(board->getPositionMax());
   for (int p=0;p<board->getPositionMax();p++)
   {
-    Go::Move move=Go::Move(col,p);
-    if (board->validMove(move))
-      total+=this->getMoveGamma(board,cfglastdist,cfgsecondlastdist,move,false);
+    if (board->validMove(Go::Move(col,p)))
+      moves.push_back(p);
+    else
+      gammas->set(p,0);
+  }
+  int n=moves.size();
+  std::vector<float> localgammas(n,1.0);
+  std::vector<float> distgammas(n,1.0);
+  std::vector<int> movelevels(n);
+  std::vector<float> factors(n);
+  
+  //captures, extensions and ataris need an adjacent group in atari or an opponent group with two liberties
+  std::vector<bool> tactical(n,false);
+  for (int i=0;i<n;i++)
+  {
+    int pos=moves[i];
+    foreach_adjacent(pos,p,{
+      if (board->inGroup(p))
+      {
+        Go::Group *group=board->getGroup(p);
+        if (group->inAtari() || (group->getColor()!=col && group->isOneOfTwoLiberties(pos)))
+          tactical[i]=true;
+      }
+    });
   }
   
-  Go::Move passmove=Go::Move(col,Go::Move::PASS);
-  total+=this->getMoveGamma(board,cfglastdist,cfgsecondlastdist,passmove,false);
+  this->multiplyBoardGammas(Features::CAPTURE,CAPTURE_LEVELS,board,NULL,NULL,col,moves,&tactical,movelevels,factors,localgammas);
+  this->multiplyBoardGammas(Features::EXTENSION,EXTENSION_LEVELS,board,NULL,NULL,col,moves,&tactical,movelevels,factors,localgammas);
+  this->multiplyBoardGammas(Features::SELFATARI,SELFATARI_LEVELS,board,NULL,NULL,col,moves,NULL,movelevels,factors,localgammas);
+  this->multiplyBoardGammas(Features::ATARI,ATARI_LEVELS,board,NULL,NULL,col,moves,&tactical,movelevels,factors,localgammas);
+  this->multiplyBoardGammas(Features::BORDERDIST,BORDERDIST_LEVELS,board,NULL,NULL,col,moves,NULL,movelevels,factors,localgammas);
+  for (int i=0;i<n;i++)
+    factors[i]=patterngammatable->getGamma(col,Pattern::ThreeByThree::makeHash(board,moves[i]));
+  Features::multiplyGammas(localgammas,factors);
+  if (circlevels->size()>0)
+  {
+    for (int i=0;i<n;i++)
+      localgammas[i]*=this->getFeatureGamma(Features::CIRCPATT,this->matchFeatureClass(Features::CIRCPATT,board,NULL,NULL,Go::Move(col,moves[i]),false));
+  }
+  if (this->usesLocalPatterns())
+  {
+    for (int i=0;i<n;i++)
+      localgammas[i]*=this->getLocalPatternGamma(board,Go::Move(col,moves[i]));
+  }
+  for (int i=0;i<n;i++)
+    localgammas[i]=this->applyMoveExtraGammas(board,Go::Move(col,moves[i]),true,localgammas[i]);
   
-  return total;
-}
-
-float Features::getBoardGammas(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, Go::ObjectBoard<float> *gammas) const
-{
-  float total=0;
+  this->multiplyBoardGammas(Features::LASTDIST,LASTDIST_LEVELS,board,cfglastdist,cfgsecondlastdist,col,moves,NULL,movelevels,factors,distgammas);
+  this->multiplyBoardGammas(Features::SECONDLASTDIST,SECONDLASTDIST_LEVELS,board,cfglastdist,cfgsecondlastdist,col,moves,NULL,movelevels,factors,distgammas);
+  if (cfglastdist!=NULL)
+    this->multiplyBoardGammas(Features::CFGLASTDIST,CFGLASTDIST_LEVELS,board,cfglastdist,cfgsecondlastdist,col,moves,NULL,movelevels,factors,distgammas);
+  if (cfgsecondlastdist!=NULL)
+    this->multiplyBoardGammas(Features::CFGSECONDLASTDIST,CFGSECONDLASTDIST_LEVELS,board,cfglastdist,cfgsecondlastdist,col,moves,NULL,movelevels,factors,distgammas);
   
-  for (int p=0;p<board->getPositionMax();p++)
+  Features::multiplyGammas(localgammas,distgammas);
+  float total=0;
+  for (int i=0;i<n;i++)
   {
-    Go::Move move=Go::Move(col,p);
-    if (board->validMove(move))
-    {
-      float gamma=this->getMoveGamma(board,cfglastdist,cfgsecondlastdist,move,false);;
-      gammas->set(p,gamma);
-      total+=gamma;
-    }
+    gammas->set(moves[i],localgammas[i]);
+    total+=localgammas[i];
   }
   
   {
     Go::Move move=Go::Move(col,Go::Move::PASS);
-    float gamma=this->getMoveGamma(board,cfglastdist,cfgsecondlastdist,move,false);;
+    float gamma=this->getMoveGamma(board,cfglastdist,cfgsecondlastdist,move,false);
     gammas->set(0,gamma);
     total+=gamma;
   }
@@ -1568,6 +1683,77 @@ float Features::getBoardGammas(Go::Board *board, Go::ObjectBoard<int> *cfglastdi
   return total;
 }
 
+void Features::multiplyBoardGammas(Features::FeatureClass featclass, int levels, Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, const std::vector<int> &moves, const std::vector<bool> *only, std::vector<int> &movelevels, std::vector<float> &factors, std::vector<float> &gammas) const
+{
+  std::vector<float> levelgammas(levels+1);
+  for (int l=0;l<=levels;l++)
+    levelgammas[l]=this->getFeatureGamma(featclass,l);
+  
+  this->getBoardLevels(featclass,board,cfglastdist,cfgsecondlastdist,col,moves,only,movelevels);
+  
+  int n=moves.size();
+  for (int i=0;i<n;i++)
+    factors[i]=((only==NULL || (*only)[i])?levelgammas[movelevels[i]]:1);
+  Features::multiplyGammas(gammas,factors);
+}
+
+void Features::getBoardLevels(Features::FeatureClass featclass, Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, const std::vector<int> &moves, const std::vector<bool> *only, std::vector<int> &movelevels) const
+{
+  //the same levels as matchFeatureClass(), with the checks that don't depend on the move done once for the whole board
+  int n=moves.size();
+  switch (featclass)
+  {
+    case Features::BORDERDIST:
+    {
+      for (int i=0;i<n;i++)
+        movelevels[i]=Features::levelBorderDist(board->getDistanceToBorder(moves[i]));
+      break;
+    }
+    case Features::LASTDIST:
+    case Features::SECONDLASTDIST:
+    {
+      int maxdist;
+      int frompos=this->getLastDistFrom(featclass,board,maxdist);
+      for (int i=0;i<n;i++)
+        movelevels[i]=(frompos<0?0:Features::levelDist(board->getCircularDistance(moves[i],frompos),maxdist));
+      break;
+    }
+    case Features::CFGLASTDIST:
+    case Features::CFGSECONDLASTDIST:
+    {
+      int maxdist;
+      Go::ObjectBoard<int> *cfgdist=Features::getCFGDist(featclass,board,cfglastdist,cfgsecondlastdist,maxdist);
+      for (int i=0;i<n;i++)
+        movelevels[i]=(cfgdist==NULL?0:Features::levelDist(cfgdist->get(moves[i]),maxdist));
+      break;
+    }
+    default:
+    {
+      //the tactical features have to look at the groups around every move
+      for (int i=0;i<n;i++)
+      {
+        if (only==NULL || (*only)[i])
+          movelevels[i]=this->matchFeatureClass(featclass,board,cfglastdist,cfgsecondlastdist,Go::Move(col,moves[i]),false);
+        else
+          movelevels[i]=0;
+      }
+      break;
+    }
+  }
+}
+
+void Features::multiplyGammas(std::vector<float> &gammas, const std::vector<float> &factors)
+{
+  int n=gammas.size();
+  int i=0;
+#ifdef FEATURES_SSE2
+  for (;i+4<=n;i+=4)
+    _mm_storeu_ps(&gammas[i],_mm_mul_ps(_mm_loadu_ps(&gammas[i]),_mm_loadu_ps(&factors[i])));
+#endif
+  for (;i<n;i++)
+    gammas[i]*=factors[i];
+}
+
 std::string Features::getFeatureClassName(Features::FeatureClass featclass) const
 {
   switch (featclass)
@@ -1633,24 +1819,29 @@ Features::FeatureClass Features::getFeatureClassFromName(std::string name) const
 
 bool Features::loadGammaFile(std::string filename)
 {
+  if (Pattern::CircularDatabase::isDatabaseFile(filename))
+  {
+    //the circular pattern levels are read from the database entries, without parsing their strings
+    Pattern::CircularDatabase *db=this->openCircDatabase(filename,Pattern::CircularDatabase::GAMMAS);
+    if (db==NULL)
+      return false;
+    bool success=this->loadGammaString(db->getText());
+    for (unsigned long i=0;success && i<db->getCount();i++)
+      success=this->setFeatureGamma(Features::CIRCPATT,this->addCircLevel(db->getPattern(i)),db->getValue(i));
+    delete db;
+    return success;
+  }
+  
   std::ifstream fin(filename.c_str());
   
   if (!fin)
     return false;
   
-  std::string line;
-  while (std::getline(fin,line))
-  {
-    if (!this->loadGammaLine(line))
-    {
-      fin.close();
-      return false;
-    }
-  }
-  
+  std::ostringstream lines;
+  lines<<fin.rdbuf();
   fin.close();
   
-  return true;
+  return this->loadGammaString(lines.str());
 }
 
 bool Features::saveGammaFile(std::string filename)
@@ -1660,28 +1851,45 @@ bool Features::saveGammaFile(std::string filename)
   if (!fout)
     return false;
   
+  this->writeGammaLines(fout,true);
+  fout.close();
+  
+  return true;
+}
+
+bool Features::saveGammaFileBinary(std::string filename) const
+{
+  //the circular pattern levels are the entries of the database, the other gammas are stored as lines of text
+  std::ostringstream lines;
+  this->writeGammaLines(lines,false);
+  
+  std::vector< std::pair<Pattern::Circular,double> > entries;
+  for (unsigned int i=1;i<circstrings->size();i++)
+    entries.push_back(std::make_pair(Pattern::Circular(circdict,(*circstrings)[i]),(double)(*circgammas)[i]));
+  
+  return Pattern::CircularDatabase::write(filename,Pattern::CircularDatabase::GAMMAS,circlevelsmaxsize,0,entries,lines.str());
+}
+
+void Features::writeGammaLines(std::ostream &out, bool withcircpatterns) const
+{
   unsigned int i;
-  for (i=0;i<PASS_LEVELS;i++) fout<<"pass:"<<i+1<<" "<<gammas_pass[i]<<" \n";
-  for (i=0;i<CAPTURE_LEVELS;i++) fout<<"capture:"<<i+1<<" "<<gammas_capture[i]<<" \n";
-  for (i=0;i<EXTENSION_LEVELS;i++) fout<<"extension:"<<i+1<<" "<<gammas_extension[i]<<" \n";
-  for (i=0;i<SELFATARI_LEVELS;i++) fout<<"selfatari:"<<i+1<<" "<<gammas_selfatari[i]<<" \n";
-  for (i=0;i<ATARI_LEVELS;i++) fout<<"atari:"<<i+1<<" "<<gammas_atari[i]<<" \n";
-  for (i=0;i<BORDERDIST_LEVELS;i++) fout<<"borderdist:"<<i+1<<" "<<gammas_borderdist[i]<<" \n";
-  for (i=0;i<LASTDIST_LEVELS;i++) fout<<"lastdist:"<<i+1<<" "<<gammas_lastdist[i]<<" \n";
-  for (i=0;i<SECONDLASTDIST_LEVELS;i++) fout<<"secondlastdist:"<<i+1<<" "<<gammas_secondlastdist[i]<<" \n";
-  for (i=0;i<CFGLASTDIST_LEVELS;i++) fout<<"cfglastdist:"<<i+1<<" "<<gammas_cfglastdist[i]<<" \n";
-  for (i=0;i<CFGSECONDLASTDIST_LEVELS;i++) fout<<"cfgsecondlastdist:"<<i+1<<" "<<gammas_cfgsecondlastdist[i]<<" \n";
+  for (i=0;i<PASS_LEVELS;i++) out<<"pass:"<<i+1<<" "<<gammas_pass[i]<<" \n";
+  for (i=0;i<CAPTURE_LEVELS;i++) out<<"capture:"<<i+1<<" "<<gammas_capture[i]<<" \n";
+  for (i=0;i<EXTENSION_LEVELS;i++) out<<"extension:"<<i+1<<" "<<gammas_extension[i]<<" \n";
+  for (i=0;i<SELFATARI_LEVELS;i++) out<<"selfatari:"<<i+1<<" "<<gammas_selfatari[i]<<" \n";
+  for (i=0;i<ATARI_LEVELS;i++) out<<"atari:"<<i+1<<" "<<gammas_atari[i]<<" \n";
+  for (i=0;i<BORDERDIST_LEVELS;i++) out<<"borderdist:"<<i+1<<" "<<gammas_borderdist[i]<<" \n";
+  for (i=0;i<LASTDIST_LEVELS;i++) out<<"lastdist:"<<i+1<<" "<<gammas_lastdist[i]<<" \n";
+  for (i=0;i<SECONDLASTDIST_LEVELS;i++) out<<"secondlastdist:"<<i+1<<" "<<gammas_secondlastdist[i]<<" \n";
+  for (i=0;i<CFGLASTDIST_LEVELS;i++) out<<"cfglastdist:"<<i+1<<" "<<gammas_cfglastdist[i]<<" \n";
+  for (i=0;i<CFGSECONDLASTDIST_LEVELS;i++) out<<"cfgsecondlastdist:"<<i+1<<" "<<gammas_cfgsecondlastdist[i]<<" \n";
     
-  for (i=0;i<PATTERN_3x3_GAMMAS;i++) if (patterngammas->getGamma (i)>0) {fout<<"pattern3x3:0x"<<std::hex<<std::setw(4)<<std::setfill('0')<<i<<" "<<patterngammas->getGamma (i)<<" \n";};
-  std::map<unsigned int,std::string>::iterator it;
-  for (i=0;i<circstrings->size();i++)
+  for (i=0;i<PATTERN_3x3_GAMMAS;i++) if (patterngammas->getGamma (i)>0) {out<<"pattern3x3:0x"<<std::hex<<std::setw(4)<<std::setfill('0')<<i<<" "<<patterngammas->getGamma (i)<<" \n";};
+  if (withcircpatterns)
   {
-    //int circid=it->first;
-    fout<<"circpatt:"<<(*circstrings)[i]<<" "<<(*circgammas)[i]<<" \n";
+    for (i=0;i<circstrings->size();i++)
+      out<<"circpatt:"<<(*circstrings)[i]<<" "<<(*circgammas)[i]<<" \n";
   }
-  fout.close();
-  
-  return true;
 }
 
 bool Features::saveGammaFileInline(std::string filename)
@@ -1742,6 +1950,20 @@ bool Features::saveGammaFileInline(std::string filename)
 
 bool Features::loadCircFile(std::string filename,int numlines)
 {
+  if (Pattern::CircularDatabase::isDatabaseFile(filename))
+  {
+    Pattern::CircularDatabase *db=this->openCircDatabase(filename,Pattern::CircularDatabase::COUNTS);
+    if (db==NULL)
+      return false;
+    circpatterns.clear();
+    if (circpatternsdb!=NULL)
+      delete circpatternsdb;
+    circpatternsdb=db;
+    circpatternsize=db->getPatternSize();
+    num_circmoves=(long int)db->getTotal();
+    return true;
+  }
+  
   std::ifstream fin(filename.c_str());
   
   if (!fin)
@@ -1749,6 +1971,9 @@ bool Features::loadCircFile(std::string filename,int numlines)
   num_circmoves=0;
   std::string line;
   circpatterns.clear();
+  if (circpatternsdb!=NULL)
+    delete circpatternsdb;
+  circpatternsdb=NULL;
   circpatternsize=0;
   int n=0;
   while (std::getline(fin,line)&&(numlines==0||n<numlines))
@@ -1757,23 +1982,19 @@ bool Features::loadCircFile(std::string filename,int numlines)
     int numpos = line.find(" ");
     long int timesfound = atol(line.substr(0,numpos).c_str());
     circpatternsize=atoi(line.substr(numpos,strpos).c_str());
-    circpatterns.insert(std::make_pair(line.substr(numpos+1),timesfound));
-    //create small patterns and insert them
     Pattern::Circular tmpPattern=Pattern::Circular(circdict,line.substr(numpos+1));
+    circpatterns.insert(std::make_pair(tmpPattern,timesfound));
+    //create small patterns and insert them
     for (int j=circpatternsize-1;j>1;j--)
     {
       Pattern::Circular tmp=tmpPattern.getSubPattern(circdict,j);
       tmp.convertToSmallestEquivalent(circdict);
-      std::string tmpPattString=tmp.toString(circdict);
-      if (circpatterns.count(tmpPattString))
+      if (circpatterns.count(tmp))
       {
-        //long vor=circpatterns.find(tmpPattString)->second;
-        circpatterns.find(tmpPattString)->second+=timesfound;
-        //long nach=circpatterns.find(tmpPattString)->second;
-        //fprintf(stderr,"played %s %ld %ld\n",tmpPattString.c_str(),vor,nach);
+        circpatterns.find(tmp)->second+=timesfound;
       }
       else
-        circpatterns.insert(std::make_pair(tmpPattString,timesfound));
+        circpatterns.insert(std::make_pair(tmp,timesfound));
     }
     n++;
     num_circmoves+=timesfound;
@@ -1788,6 +2009,20 @@ bool Features::loadCircFile(std::string filename,int numlines)
 
 bool Features::loadCircFileNot(std::string filename,int numlines)
 {
+  if (Pattern::CircularDatabase::isDatabaseFile(filename))
+  {
+    Pattern::CircularDatabase *db=this->openCircDatabase(filename,Pattern::CircularDatabase::COUNTS);
+    if (db==NULL)
+      return false;
+    circpatternsnot.clear();
+    if (circpatternsnotdb!=NULL)
+      delete circpatternsnotdb;
+    circpatternsnotdb=db;
+    circpatternsize=db->getPatternSize();
+    num_circmoves_not=(long int)db->getTotal();
+    return true;
+  }
+  
   std::ifstream fin(filename.c_str());
   
   if (!fin)
@@ -1795,6 +2030,9 @@ bool Features::loadCircFileNot(std::string filename,int numlines)
   num_circmoves_not=0;
   std::string line;
   circpatternsnot.clear();
+  if (circpatternsnotdb!=NULL)
+    delete circpatternsnotdb;
+  circpatternsnotdb=NULL;
   circpatternsize=0;
   int n=0;
   while (std::getline(fin,line)&&(numlines==0||n<numlines))
@@ -1803,23 +2041,19 @@ bool Features::loadCircFileNot(std::string filename,int numlines)
     int numpos = line.find(" ");
     long int timesfound = atol(line.substr(0,numpos).c_str());
     circpatternsize=atoi(line.substr(numpos,strpos).c_str());
-    circpatternsnot.insert(std::make_pair(line.substr(numpos+1),timesfound));
-    //create small patterns and insert them
     Pattern::Circular tmpPattern=Pattern::Circular(circdict,line.substr(numpos+1));
+    circpatternsnot.insert(std::make_pair(tmpPattern,timesfound));
+    //create small patterns and insert them
     for (int j=circpatternsize-1;j>1;j--)
     {
       Pattern::Circular tmp=tmpPattern.getSubPattern(circdict,j);
       tmp.convertToSmallestEquivalent(circdict);
-      std::string tmpPattString=tmp.toString(circdict);
-      if (circpatternsnot.count(tmpPattString))
+      if (circpatternsnot.count(tmp))
       {
-        //long vor=circpatternsnot.find(tmpPattString)->second;
-        circpatternsnot.find(tmpPattString)->second+=timesfound;
-        //long nach=circpatternsnot.find(tmpPattString)->second;
-        //fprintf(stderr,"not played %s %ld %ld\n",tmpPattString.c_str(),vor,nach);
+        circpatternsnot.find(tmp)->second+=timesfound;
       }
       else
-        circpatternsnot.insert(std::make_pair(tmpPattString,timesfound));
+        circpatternsnot.insert(std::make_pair(tmp,timesfound));
     }
     n++;
     num_circmoves_not+=timesfound;
@@ -1833,47 +2067,88 @@ bool Features::loadCircFileNot(std::string filename,int numlines)
 
 bool Features::saveCircValueFile(std::string filename)
 {
-  
+  if (circpatternvaluesdb!=NULL)
+  {
+    std::ofstream fout(filename.c_str());
+    if (!fout)
+      return false;
+    for (unsigned long i=0;i<circpatternvaluesdb->getCount();i++)
+    {
+      float v=circpatternvaluesdb->getValue(i);
+      if (v!=0)
+        fout<<circpatternvaluesdb->getPattern(i).toString(circdict)<<" "<<v<<"\n";
+    }
+    fout.close();
+    return true;
+  }
   if (!circpatternvalues.empty())
   {
     std::ofstream fout(filename.c_str());
     if (!fout)
       return false;
-    std::map<std::string,float>::iterator it;
+    Features::CircValueMap::iterator it;
     for (it=circpatternvalues.begin();it!=circpatternvalues.end();++it)
     {
-      float v=valueCircPattern(it->first);
+      float v=it->second;
       if (v!=0)
       {
-        //fprintf(stderr,"%s %f\n",it->first.c_str(),v);;
-        fout<<it->first<<" "<<v<<"\n";
+        fout<<it->first.toString(circdict)<<" "<<v<<"\n";
       }
     }
     fout.close();
     return true;
   }
-  if ((circpatterns.empty()||circpatternsnot.empty()))
+  if ((!this->hasCircCounts(false)||!this->hasCircCounts(true)))
     return false;
   std::ofstream fout(filename.c_str());
   if (!fout)
     return false;
-  std::map<std::string,long int>::iterator it;
+  //collect first, as valueCircPattern() switches to the values once there are any
+  Features::CircValueMap values;
+  if (circpatternsdb!=NULL)
+  {
+    for (unsigned long i=0;i<circpatternsdb->getCount();i++)
+    {
+      Pattern::Circular pc=circpatternsdb->getPattern(i);
+      float v=valueCircPattern(pc);
+      if (v!=0)
+      {
+        values.insert(std::make_pair(pc,v));
+        fout<<pc.toString(circdict)<<" "<<v<<"\n";
+      }
+    }
+  }
+  Features::CircCountMap::iterator it;
   for (it=circpatterns.begin();it!=circpatterns.end();++it)
   {
     float v=valueCircPattern(it->first);
     if (v!=0)
     {
-      circpatternvalues.insert(std::make_pair(it->first,v));
-      fout<<it->first<<" "<<v<<"\n";
+      values.insert(std::make_pair(it->first,v));
+      fout<<it->first.toString(circdict)<<" "<<v<<"\n";
     }
   }
   fout.close();
+  circpatternvalues.swap(values);
   return true;
 }
 
 bool Features::loadCircValueFile(std::string filename)
 {
   circpatternvalues.clear();
+  if (circpatternvaluesdb!=NULL)
+    delete circpatternvaluesdb;
+  circpatternvaluesdb=NULL;
+  
+  if (Pattern::CircularDatabase::isDatabaseFile(filename))
+  {
+    circpatternvaluesdb=this->openCircDatabase(filename,Pattern::CircularDatabase::VALUES);
+    if (circpatternvaluesdb==NULL)
+      return false;
+    circpatternsize=circpatternvaluesdb->getPatternSize();
+    return true;
+  }
+  
   std::ifstream fin(filename.c_str());
   if (!fin)
     return false;
@@ -1890,7 +2165,7 @@ bool Features::loadCircValueFile(std::string filename)
       circpatternsize=tmp;
     }
     float v=atof(line.substr(numpos+1).c_str());
-    circpatternvalues.insert(std::make_pair(line.substr(0,numpos),v));
+    circpatternvalues.insert(std::make_pair(Pattern::Circular(circdict,line.substr(0,numpos)),v));
   }
   fin.close();
   return true;
@@ -1900,13 +2175,17 @@ bool Features::loadGammaString(std::string lines)
   std::istringstream iss(lines);
   
   std::string line;
-  while (getline(iss,line,'\n'))
-  {
-    if (!this->loadGammaLine(line))
-      return false;
-  }
+  bool success=true;
+  loadinggammas=true;
+  while (success && getline(iss,line,'\n'))
+    success=this->loadGammaLine(line);
+  loadinggammas=false;
   
-  return true;
+  //rebuild the whole lookup table and the ids, so they are consistent with the loaded 3x3 gammas
+  patterngammatable->updateAll(patterngammas);
+  this->updatePatternIds();
+  
+  return success;
 }
 
 bool Features::loadGammaLine(std::string line)
@@ -1931,21 +2210,17 @@ bool Features::loadGammaLine(std::string line)
   if (!getline(issid,levelstring,' '))
     return false;
   
-  if (levelstring.find(':') != std::string::npos)
+  Pattern::Local::Shape shape;
+  if (Pattern::Local::getShapeFromName(classname,shape))
   {
-    Pattern::Circular pc = Pattern::Circular(circdict,levelstring);
-
-    if (circlevels->count(pc)>0)
-      level = (*circlevels)[pc];
-    else
-    {
-      level = circlevels->size()+1;
-      (*circlevels)[pc] = level;
-      circstrings->resize(level+1);
-      circgammas->resize(level+1);
-      (*circstrings)[level] = pc.toString(circdict);
-    }
+    std::istringstream issgamma(gammastring);
+    if (!(issgamma >> gamma))
+      return false;
+    return localpatterngammas->setGamma(shape,levelstring,gamma);
   }
+  
+  if (levelstring.find(':') != std::string::npos)
+    level = this->addCircLevel(Pattern::Circular(circdict,levelstring));
   else if (levelstring.at(0)=='0' && levelstring.at(1)=='x')
   {
     level=0;
@@ -1973,6 +2248,21 @@ bool Features::loadGammaLine(std::string line)
   return this->setFeatureGamma(featclass,level,gamma);
 }
 
+unsigned int Features::addCircLevel(const Pattern::Circular &pc)
+{
+  if (circlevels->count(pc)>0)
+    return (*circlevels)[pc];
+  
+  unsigned int level = circlevels->size()+1;
+  (*circlevels)[pc] = level;
+  circstrings->resize(level+1);
+  circgammas->resize(level+1);
+  (*circstrings)[level] = pc.toString(circdict);
+  if (pc.getSize()>circlevelsmaxsize)
+    circlevelsmaxsize=pc.getSize();
+  return level;
+}
+
 float *Features::getStandardGamma(Features::FeatureClass featclass) const
 {
   switch (featclass)
@@ -2012,7 +2302,12 @@ bool Features::setFeatureGamma(Features::FeatureClass featclass, unsigned int le
   else if (featclass==Features::PATTERN3X3)
   {
     patterngammas->setGamma(level,gamma);
-    this->updatePatternIds();
+    //a whole file of gammas rebuilds these once at the end, see loadGammaString()
+    if (!loadinggammas)
+    {
+      patterngammatable->update(patterngammas,level);
+      this->updatePatternIds();
+    }
     return true;
   }
   else
@@ -2031,143 +2326,74 @@ bool Features::setFeatureGamma(Features::FeatureClass featclass, unsigned int le
 std::string Features::getMatchingFeaturesString(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, bool pretty) const
 {
   std::ostringstream ss;
-  unsigned int level,base;
   
-  base=0;
+  if (!pretty)
+  {
+    std::vector<unsigned int> ids;
+    this->getMatchingFeatureIds(board,cfglastdist,cfgsecondlastdist,move,ids);
+    for (unsigned int i=0;i<ids.size();i++)
+      ss<<" "<<ids[i];
+    return ss.str();
+  }
+  
+  unsigned int level;
   
   level=this->matchFeatureClass(Features::PASS,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" pass:"<<level;
-    else
-      ss<<" "<<(level-1);
-  }
-  base+=PASS_LEVELS;
+    ss<<" pass:"<<level;
   
   level=this->matchFeatureClass(Features::CAPTURE,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" capture:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=CAPTURE_LEVELS;
+    ss<<" capture:"<<level;
   
   level=this->matchFeatureClass(Features::EXTENSION,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" extension:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=EXTENSION_LEVELS;
+    ss<<" extension:"<<level;
   
   level=this->matchFeatureClass(Features::SELFATARI,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" selfatari:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=SELFATARI_LEVELS;
+    ss<<" selfatari:"<<level;
   
   level=this->matchFeatureClass(Features::ATARI,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" atari:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=ATARI_LEVELS;
+    ss<<" atari:"<<level;
   
   level=this->matchFeatureClass(Features::BORDERDIST,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" borderdist:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=BORDERDIST_LEVELS;
+    ss<<" borderdist:"<<level;
   
   level=this->matchFeatureClass(Features::LASTDIST,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" lastdist:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=LASTDIST_LEVELS;
+    ss<<" lastdist:"<<level;
   
   level=this->matchFeatureClass(Features::SECONDLASTDIST,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" secondlastdist:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=SECONDLASTDIST_LEVELS;
+    ss<<" secondlastdist:"<<level;
   
   level=this->matchFeatureClass(Features::CFGLASTDIST,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" cfglastdist:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=CFGLASTDIST_LEVELS;
+    ss<<" cfglastdist:"<<level;
   
   level=this->matchFeatureClass(Features::CFGSECONDLASTDIST,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0)
-  {
-    if (pretty)
-      ss<<" cfgsecondlastdist:"<<level;
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=CFGSECONDLASTDIST_LEVELS;
+    ss<<" cfgsecondlastdist:"<<level;
   
   level=this->matchFeatureClass(Features::PATTERN3X3,board,cfglastdist,cfgsecondlastdist,move);
   if (patterngammas->hasGamma(level) && !move.isPass() && !move.isResign())
-  {
-    if (pretty)
-      ss<<" pattern3x3:0x"<<std::hex<<std::setw(4)<<std::setfill('0')<<level;
-    else
-      ss<<" "<<(int)patternids->getGamma(level);
-  }
-  base+=patternids->getCount();
+    ss<<" pattern3x3:0x"<<std::hex<<std::setw(4)<<std::setfill('0')<<level;
 
   level=this->matchFeatureClass(Features::CIRCPATT,board,cfglastdist,cfgsecondlastdist,move);
   if (level>0 && !move.isPass() && !move.isResign())
-  {
-    if (pretty)
-      ss<<" circpatt:"<<(*circstrings)[level];
-    else
-      ss<<" "<<(base+level-1);
-  }
-  base+=circlevels->size();
+    ss<<" circpatt:"<<(*circstrings)[level];
 
   if (params->features_dt_use)
   {
+    unsigned int base=this->getFeatureIdCount();
     std::list<int> *ids = DecisionTree::getCollectionLeafIds(params->engine->getDecisionTrees(),board,move);
     if (ids != NULL)
     {
       for (std::list<int>::iterator iter=ids->begin();iter!=ids->end();++iter)
-      {
-        int i = base+(*iter);
-        if (pretty)
-          ss<<" dt:"<<i;
-        else
-          ss<<" "<<i;
-      }
+        ss<<" dt:"<<std::dec<<(base+(*iter));
       delete ids;
     }
   }
@@ -2175,6 +2401,50 @@ std::string Features::getMatchingFeaturesString(Go::Board *board, Go::ObjectBoar
   return ss.str();
 }
 
+void Features::getMatchingFeatureIds(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, std::vector<unsigned int> &ids) const
+{
+  //the ids of each class follow on from the previous class, see getFeatureIdList()
+  const Features::FeatureClass standardclasses[]={Features::PASS,Features::CAPTURE,Features::EXTENSION,Features::SELFATARI,Features::ATARI,Features::BORDERDIST,Features::LASTDIST,Features::SECONDLASTDIST,Features::CFGLASTDIST,Features::CFGSECONDLASTDIST};
+  const unsigned int standardlevels[]={PASS_LEVELS,CAPTURE_LEVELS,EXTENSION_LEVELS,SELFATARI_LEVELS,ATARI_LEVELS,BORDERDIST_LEVELS,LASTDIST_LEVELS,SECONDLASTDIST_LEVELS,CFGLASTDIST_LEVELS,CFGSECONDLASTDIST_LEVELS};
+  unsigned int level,base;
+  
+  ids.clear();
+  base=0;
+  for (int i=0;i<10;i++)
+  {
+    level=this->matchFeatureClass(standardclasses[i],board,cfglastdist,cfgsecondlastdist,move);
+    if (level>0)
+      ids.push_back(base+level-1);
+    base+=standardlevels[i];
+  }
+  
+  level=this->matchFeatureClass(Features::PATTERN3X3,board,cfglastdist,cfgsecondlastdist,move);
+  if (patterngammas->hasGamma(level) && !move.isPass() && !move.isResign())
+    ids.push_back((unsigned int)patternids->getGamma(level));
+  base+=patternids->getCount();
+
+  level=this->matchFeatureClass(Features::CIRCPATT,board,cfglastdist,cfgsecondlastdist,move);
+  if (level>0 && !move.isPass() && !move.isResign())
+    ids.push_back(base+level-1);
+  base+=circlevels->size();
+
+  if (params->features_dt_use)
+  {
+    std::list<int> *dtids = DecisionTree::getCollectionLeafIds(params->engine->getDecisionTrees(),board,move);
+    if (dtids != NULL)
+    {
+      for (std::list<int>::iterator iter=dtids->begin();iter!=dtids->end();++iter)
+        ids.push_back(base+(*iter));
+      delete dtids;
+    }
+  }
+}
+
+unsigned int Features::getFeatureIdCount() const
+{
+  return PASS_LEVELS+CAPTURE_LEVELS+EXTENSION_LEVELS+SELFATARI_LEVELS+ATARI_LEVELS+BORDERDIST_LEVELS+LASTDIST_LEVELS+SECONDLASTDIST_LEVELS+CFGLASTDIST_LEVELS+CFGSECONDLASTDIST_LEVELS+patternids->getCount()+circlevels->size();
+}
+
 std::string Features::getFeatureIdList() const
 {
   std::ostringstream ss;
@@ -2222,7 +2492,7 @@ std::string Features::getFeatureIdList() const
   }
 
   for (unsigned int level=1;level<=circlevels->size();level++)
-    ss<<(id++)<<" circpatt:"<<(*circstrings)[level]<<"\n";
+    ss<<std::dec<<(id++)<<" circpatt:"<<(*circstrings)[level]<<"\n";
   
   return ss.str();
 }
@@ -2248,35 +2518,40 @@ void Features::computeCFGDist(Go::Board *board, Go::ObjectBoard<int> **cfglastdi
 
 
 float Features::valueCircPattern(std::string circpattern) const
+{
+  return this->valueCircPattern(Pattern::Circular(circdict,circpattern));
+}
+
+float Features::valueCircPattern(const Pattern::Circular &pc) const
 {
   //use ready circular pattern values, if availible
+  if (circpatternvaluesdb!=NULL)
+  {
+    double v;
+    if (circpatternvaluesdb->find(pc,v))
+      return v;
+    return 0;
+  }
   if (!circpatternvalues.empty())
   {
-    if (circpatternvalues.count(circpattern))
-      return circpatternvalues.find(circpattern)->second;
+    Features::CircValueMap::const_iterator it=circpatternvalues.find(pc);
+    if (it!=circpatternvalues.end())
+      return it->second;
     return 0;
   }
-  //not strip the patternsize anymore!!!!
-  //int strpos = circpattern.find(":");
-    
- //fprintf(stderr,"not %s %ld\n",circpattern.c_str(),circpatternsnot.count(circpattern));
- //fprintf(stderr,"played %s %ld\n",circpattern.c_str(),circpatterns.count(circpattern));
   //in the not played database the circ pattern is not contained, therefore if it is played
   //it is set to factor 1 (count allways gives 1 or 0 in map)
 
 //this is managed by test_p7 at the moment
-//  if (!circpatternsnot.count(circpattern))
+//  if (!circpatternsnot.count(pc))
 //    return 0;
   
-  std::map<std::string,long int>::const_iterator it;
-  it=circpatterns.find(circpattern);
-  if (it==circpatterns.end())
+  long int num_played;
+  if (!this->findCircCount(circpatterns,circpatternsdb,pc,num_played))
     return 0;
   //both exist
-  long int num_played=it->second;
   long int num_not_played=0;
-  it=circpatternsnot.find(circpattern);
-  if (it!=circpatternsnot.end()) num_not_played=it->second;
+  this->findCircCount(circpatternsnot,circpatternsnotdb,pc,num_not_played);
   float ratio=float(num_played)/(num_not_played+20)*params->uct_factor_circpattern_exponent;
   if (ratio>1.0) ratio=1.0;
   //fprintf(stderr,"valueCircPattern %ld %ld %f\n",num_played,num_not_played,ratio);
@@ -2285,27 +2560,113 @@ float Features::valueCircPattern(std::string circpattern) const
 
 void Features::learnCircPattern(std::string circpattern,float delta)
 {
+  this->learnCircPattern(Pattern::Circular(circdict,circpattern),delta);
+}
+
+void Features::learnCircPattern(const Pattern::Circular &pc,float delta)
+{
+  //the mapped values are read-only, so they are copied the first time one is learnt
+  if (circpatternvaluesdb!=NULL)
+  {
+    for (unsigned long i=0;i<circpatternvaluesdb->getCount();i++)
+      circpatternvalues.insert(std::make_pair(circpatternvaluesdb->getPattern(i),(float)circpatternvaluesdb->getValue(i)));
+    delete circpatternvaluesdb;
+    circpatternvaluesdb=NULL;
+  }
+  
   //use ready circular pattern values, if availible
   if (!circpatternvalues.empty())
   {
-    if (circpatternvalues.count(circpattern))
+    Features::CircValueMap::iterator it=circpatternvalues.find(pc);
+    if (it!=circpatternvalues.end())
     {
-      float v=circpatternvalues.find(circpattern)->second+delta;
+      float v=it->second+delta;
       //should not be necessary if learning is ok
       //if (v>1) v=1;
       if (v<0.0001) v=0.0001;
-      circpatternvalues.find(circpattern)->second=v;
+      it->second=v;
     }
   }
 }
 
 bool Features::isCircPattern(std::string circpattern) const
 {
-  //strip the patternsize
-  int strpos = circpattern.find(":");
-    
-// fprintf(stderr,"%s %d\n",circpattern.substr(strpos+1).c_str(),circpatterns.count(circpattern.substr(strpos+1)));
-  return circpatterns.count(circpattern.substr(strpos+1));
+  return this->isCircPattern(Pattern::Circular(circdict,circpattern));
+}
+
+bool Features::isCircPattern(const Pattern::Circular &pc) const
+{
+  long int count;
+  return this->findCircCount(circpatterns,circpatternsdb,pc,count);
+}
+
+bool Features::hasCircCounts(bool notplayed) const
+{
+  if (notplayed)
+    return (circpatternsnotdb!=NULL || !circpatternsnot.empty());
+  else
+    return (circpatternsdb!=NULL || !circpatterns.empty());
+}
+
+bool Features::findCircCount(const Features::CircCountMap &counts, const Pattern::CircularDatabase *db, const Pattern::Circular &pc, long int &count) const
+{
+  if (db!=NULL)
+  {
+    double v;
+    if (!db->find(pc,v))
+      return false;
+    count=(long int)v;
+    return true;
+  }
+  
+  Features::CircCountMap::const_iterator it=counts.find(pc);
+  if (it==counts.end())
+    return false;
+  count=it->second;
+  return true;
+}
+
+Pattern::CircularDatabase *Features::openCircDatabase(std::string filename, Pattern::CircularDatabase::Kind kind) const
+{
+  Pattern::CircularDatabase *db=Pattern::CircularDatabase::open(filename);
+  if (db!=NULL && db->getKind()!=kind)
+  {
+    fprintf(stderr,"circular pattern database is of the wrong kind: %s\n",filename.c_str());
+    delete db;
+    return NULL;
+  }
+  return db;
+}
+
+bool Features::saveCircFileBinary(std::string filename, bool notplayed) const
+{
+  const Features::CircCountMap &counts=(notplayed?circpatternsnot:circpatterns);
+  const Pattern::CircularDatabase *db=(notplayed?circpatternsnotdb:circpatternsdb);
+  
+  std::vector< std::pair<Pattern::Circular,double> > entries;
+  if (db!=NULL)
+  {
+    for (unsigned long i=0;i<db->getCount();i++)
+      entries.push_back(std::make_pair(db->getPattern(i),db->getValue(i)));
+  }
+  for (Features::CircCountMap::const_iterator it=counts.begin();it!=counts.end();++it)
+    entries.push_back(std::make_pair(it->first,(double)it->second));
+  
+  return Pattern::CircularDatabase::write(filename,Pattern::CircularDatabase::COUNTS,circpatternsize,(notplayed?num_circmoves_not:num_circmoves),entries);
+}
+
+bool Features::saveCircValueFileBinary(std::string filename) const
+{
+  std::vector< std::pair<Pattern::Circular,double> > entries;
+  if (circpatternvaluesdb!=NULL)
+  {
+    for (unsigned long i=0;i<circpatternvaluesdb->getCount();i++)
+      entries.push_back(std::make_pair(circpatternvaluesdb->getPattern(i),circpatternvaluesdb->getValue(i)));
+  }
+  for (Features::CircValueMap::const_iterator it=circpatternvalues.begin();it!=circpatternvalues.end();++it)
+    entries.push_back(std::make_pair(it->first,(double)it->second));
+  
+  return Pattern::CircularDatabase::write(filename,Pattern::CircularDatabase::VALUES,circpatternsize,0,entries);
 }
 
 bool Features::hasCircPattern(Pattern::Circular *pc)
@@ -15,6 +15,8 @@
 #include <string>
 #include <set>
 #include <map>
+#include <vector>
+#include <iosfwd>
 
 #define with_unordered
 
@@ -126,12 +128,23 @@ class Features
      * The weight for a move is the product of matching feature weights for that move.
      */
     float getMoveGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, bool checkforvalidmove=true, bool withcircularpatterns=true) const;
+    /** Return the weight for a move, leaving out the distance features.
+     * These are the features that only change when the neighbourhood of the move or its adjacent groups change.
+     */
+    float getMoveLocalGamma(Go::Board *board, Go::Move move, bool checkforvalidmove=true, bool withcircularpatterns=true) const;
+    /** Return the weight of the distance features for a move.
+     * @see getMoveGamma()
+     */
+    float getMoveDistanceGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move) const;
     bool learnMovesGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, std::map<float,Go::Move,std::greater<float> > ordervalue, std::map<int,float> move_gamma, float sum_gammas);
     bool learnMoveGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, float learn_diff);
     int learnMoveGammaC(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, float learn_diff);
     /** Return the total of all gammas for the moves on a board. */
     float getBoardGamma(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col) const;
-    /** Return the total of all gammas for the moves on a board and each move's weight in @p gammas. */
+    /** Return the total of all gammas for the moves on a board and each move's weight in @p gammas.
+     * The legal moves are evaluated one feature class at a time, giving the same weights as getMoveGamma().
+     * Illegal points are set to zero and the pass move is stored at position 0.
+     */
     float getBoardGammas(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, Go::ObjectBoard<float> *gammas) const;
     /** Return the human-readable name for a feature class. */
     std::string getFeatureClassName(Features::FeatureClass featclass) const;
@@ -145,19 +158,42 @@ class Features
     
     /** Return a string of all the matching features for a move. */ 
     std::string getMatchingFeaturesString(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, bool pretty=true) const;
+    /** Return the ids of all the matching features for a move.
+     * These are the ids used by getFeatureIdList(), followed by any decision tree leaves.
+     */
+    void getMatchingFeatureIds(Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Move move, std::vector<unsigned int> &ids) const;
     /** Return a list of all valid features and levels. */
     std::string getFeatureIdList() const;
+    /** Return the number of features in getFeatureIdList(). */
+    unsigned int getFeatureIdCount() const;
     
     /** Load a gamma value from a line. */
     bool loadGammaLine(std::string line);
-    /** Load a file of gamma values. */
+    /** Load a file of gamma values.
+     * A binary database, as written by saveGammaFileBinary(), is read without parsing the circular pattern levels.
+     */
     bool loadGammaFile(std::string filename);
     bool saveGammaFile(std::string filename);
+    /** Save the gamma values as a binary database, that loadGammaFile() accepts. */
+    bool saveGammaFileBinary(std::string filename) const;
     bool saveGammaFileInline(std::string filename);
+    /** Load the counts of the played circular patterns.
+     * A binary database, as written by saveCircFileBinary(), is mapped into memory instead of being read.
+     */
     bool loadCircFile(std::string filename,int numlines);
+    /** Load the counts of the not played circular patterns.
+     * @see loadCircFile()
+     */
     bool loadCircFileNot(std::string filename,int numlines);
     bool saveCircValueFile(std::string filename);
+    /** Load the values of the circular patterns.
+     * A binary database, as written by saveCircValueFileBinary(), is mapped into memory instead of being read.
+     */
     bool loadCircValueFile(std::string filename);
+    /** Save the loaded counts of the played, or not played, circular patterns as a binary database. */
+    bool saveCircFileBinary(std::string filename, bool notplayed) const;
+    /** Save the loaded values of the circular patterns as a binary database. */
+    bool saveCircValueFileBinary(std::string filename) const;
     /** Load a number of lines of gamma values. */
     bool loadGammaString(std::string lines);
     /** Load the default gamma values. */
@@ -165,23 +201,51 @@ class Features
     
     /** Return the CFG distances for the last and second last moves on a board. */
     void computeCFGDist(Go::Board *board, Go::ObjectBoard<int> **cfglastdist, Go::ObjectBoard<int> **cfgsecondlastdist);
+    /** Determine if any of the CFG distance features have a weight. */
+    bool usesCFGDist() const;
+    /** Determine if any feature in use can change further from a move than the incremental playout gammas track.
+     * These are the ladder features, the decision trees and the circular pattern values.
+     */
+    bool usesDistantFeatures() const;
+    /** Get the largest x or y offset of a point in the circular patterns with gammas, or 0 if there are none. */
+    int getCircLevelsRadius() const;
 
     /** Return a structure with the gammas for the 3x3 patterns. */
     Pattern::ThreeByThreeGammas* getPatternGammas() {return patterngammas;}
+    /** Return the direct lookup table for the 3x3 pattern gammas. */
+    const Pattern::ThreeByThreeGammaTable* getPatternGammaTable() const {return patterngammatable;}
+    /** Return the table of gammas for the local 5x5 and diamond patterns. */
+    Pattern::LocalGammaTable *getLocalPatternGammas() { return localpatterngammas; };
+    /** Determine if any circular pattern has a gamma. */
+    bool usesCircPatternGammas() const { return (circlevels->size()>0); };
+    /** Determine if any local 5x5 or diamond pattern has a gamma. */
+    bool usesLocalPatterns() const { return (localpatterngammas->getCount()>0); };
+    /** Return the product of the local 5x5 and diamond pattern gammas for a move.
+     * Uses the board's incremental hashes if it has them.
+     */
+    float getLocalPatternGamma(Go::Board *board, Go::Move move) const;
     /** Return the circular dictionary. */
     Pattern::CircularDictionary *getCircDict() { return circdict; };
     /** Determine if a circular pattern is present. */
     bool hasCircPattern(Pattern::Circular *pc);
 
     bool isCircPattern(std::string circpattern) const;
+    /** Determine if a circular pattern, already in smallest equivalent form, was played. */
+    bool isCircPattern(const Pattern::Circular &pc) const;
     float valueCircPattern(std::string circpattern) const;
+    /** Return the value of a circular pattern, already in smallest equivalent form. */
+    float valueCircPattern(const Pattern::Circular &pc) const;
     void learnCircPattern(std::string circpattern,float delta);
+    /** Adjust the value of a circular pattern, already in smallest equivalent form. */
+    void learnCircPattern(const Pattern::Circular &pc,float delta);
     int getCircSize () {return circpatternsize;}
     
   private:
     Parameters *const params;
     Pattern::ThreeByThreeGammas *patterngammas;
     Pattern::ThreeByThreeGammas *patternids;
+    Pattern::ThreeByThreeGammaTable *patterngammatable;
+    Pattern::LocalGammaTable *localpatterngammas;
     float gammas_pass[PASS_LEVELS];
     float gammas_capture[CAPTURE_LEVELS];
     float gammas_extension[EXTENSION_LEVELS];
@@ -203,14 +267,40 @@ class Features
     std::vector<float> *circgammas;
 
     float *getStandardGamma(Features::FeatureClass featclass) const;
+    unsigned int addCircLevel(const Pattern::Circular &pc);
+    void writeGammaLines(std::ostream &out, bool withcircpatterns) const;
+    float applyMoveExtraGammas(Go::Board *board, Go::Move move, bool usecircularpatterns, float g) const;
+    void multiplyBoardGammas(Features::FeatureClass featclass, int levels, Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, const std::vector<int> &moves, const std::vector<bool> *only, std::vector<int> &movelevels, std::vector<float> &factors, std::vector<float> &gammas) const;
+    static unsigned int levelBorderDist(int dist);
+    int getLastDistFrom(Features::FeatureClass featclass, Go::Board *board, int &maxdist) const;
+    static unsigned int levelDist(int dist, int maxdist);
+    static Go::ObjectBoard<int> *getCFGDist(Features::FeatureClass featclass, Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, int &maxdist);
+    void getBoardLevels(Features::FeatureClass featclass, Go::Board *board, Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, const std::vector<int> &moves, const std::vector<bool> *only, std::vector<int> &movelevels) const;
+    static void multiplyGammas(std::vector<float> &gammas, const std::vector<float> &factors);
     void updatePatternIds();
 
-    std::map<std::string,long int> circpatterns;
-    std::map<std::string,long int> circpatternsnot;
-    std::map<std::string,float> circpatternvalues;
+#ifdef with_unordered
+    typedef std::unordered_map<Pattern::Circular,long int,circHash> CircCountMap;
+    typedef std::unordered_map<Pattern::Circular,float,circHash> CircValueMap;
+#else
+    typedef std::map<Pattern::Circular,long int> CircCountMap;
+    typedef std::map<Pattern::Circular,float> CircValueMap;
+#endif
+    CircCountMap circpatterns;
+    CircCountMap circpatternsnot;
+    CircValueMap circpatternvalues;
+    Pattern::CircularDatabase *circpatternsdb;
+    Pattern::CircularDatabase *circpatternsnotdb;
+    Pattern::CircularDatabase *circpatternvaluesdb;
     int circpatternsize;
+    int circlevelsmaxsize;
+    bool loadinggammas;
     long int num_circmoves;
     long int num_circmoves_not;
+
+    bool hasCircCounts(bool notplayed) const;
+    bool findCircCount(const Features::CircCountMap &counts, const Pattern::CircularDatabase *db, const Pattern::Circular &pc, long int &count) const;
+    Pattern::CircularDatabase *openCircDatabase(std::string filename, Pattern::CircularDatabase::Kind kind) const;
 };
 
 #endif
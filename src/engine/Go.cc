@@ -1,11 +1,16 @@
 #include "Go.h"
 
 #include <cstdio>
+#include <cctype>
+#include <fstream>
 #include <sstream>
+#include <iterator>
+#include <algorithm>
 #include "Features.h"
 #include "Parameters.h"
 #include "Engine.h"
 #include "Random.h"
+#include "Pattern.h"
 
 Go::BitBoard::BitBoard(int s)
   : size(s),
@@ -32,6 +37,74 @@ Go::BitBoard::~BitBoard()
   delete[] data;
 }
 
+Go::SumBoard::SumBoard(int s)
+  : size(s),
+    sizedata(1+(s+1)*(s+2)),
+    data(new float[sizedata]),
+    tree(new double[sizedata+1])
+{
+  topmask=1;
+  while ((topmask<<1)<=sizedata)
+    topmask<<=1;
+  this->fill(0);
+}
+
+Go::SumBoard::~SumBoard()
+{
+  delete[] data;
+  delete[] tree;
+}
+
+void Go::SumBoard::set(int pos, float val)
+{
+  double delta=(double)val-data[pos];
+  data[pos]=val;
+  total+=delta;
+  for (int i=pos+1;i<=sizedata;i+=(i&-i))
+    tree[i]+=delta;
+}
+
+void Go::SumBoard::fill(float val)
+{
+  for (int i=0;i<sizedata;i++)
+    data[i]=val;
+  
+  tree[0]=0;
+  for (int i=1;i<=sizedata;i++)
+    tree[i]=val;
+  for (int i=1;i<=sizedata;i++)
+  {
+    int j=i+(i&-i);
+    if (j<=sizedata)
+      tree[j]+=tree[i];
+  }
+  total=(double)val*sizedata;
+}
+
+int Go::SumBoard::find(float r) const
+{
+  if (r<0 || r>=total)
+    return -1;
+  
+  // descend the tree, skipping each subtree whose sum doesn't exceed r
+  int i=0;
+  double left=r;
+  for (int mask=topmask;mask>0;mask>>=1)
+  {
+    int next=i+mask;
+    if (next<=sizedata && tree[next]<=left)
+    {
+      left-=tree[next];
+      i=next;
+    }
+  }
+  
+  if (i>=sizedata)
+    return -1;
+  else
+    return i;
+}
+
 std::string Go::Position::pos2string(int pos, int boardsize)
 {
   if (pos==-1)
@@ -181,6 +254,7 @@ Go::Board::Board(int s)
   markchanges=false;
   lastchanges=new Go::BitBoard(size);
   lastcapture=false;
+  localhashes=NULL;
   
   for (int p=0;p<sizedata;p++)
   {
@@ -219,16 +293,29 @@ Go::Board::Board(int s)
     }
   }
   
+  emptypositions=new int[sizedata];
+  emptyindex=new int[sizedata];
+  this->refreshEmptyPositions();
+  
   symmetryupdated=true;
   currentsymmetry=Go::Board::FULL;
   
   features=NULL;
-  blacktotalgamma=0;
-  whitetotalgamma=0;
-  blackgammas=new Go::ObjectBoard<float>(s);
-  whitegammas=new Go::ObjectBoard<float>(s);
-  blackgammas->fill(0);
-  whitegammas->fill(0);
+  blackgammas=new Go::SumBoard(s);
+  whitegammas=new Go::SumBoard(s);
+  blacklocalgammas=new Go::ObjectBoard<float>(s);
+  whitelocalgammas=new Go::ObjectBoard<float>(s);
+  distancegammas=new Go::ObjectBoard<float>(s);
+  blacklocalgammas->fill(0);
+  whitelocalgammas->fill(0);
+  distancegammas->fill(1);
+  featurechanges=new Go::BitBoard(s);
+  featureko=false;
+  featurelastpos=-1;
+  featuresecondlastpos=-1;
+  featurerecapturepos=-1;
+  incfeatures=false;
+  checkfeatures=false;
   
   blackcaptures=0;
   whitecaptures=0;
@@ -239,11 +326,19 @@ Go::Board::~Board()
 {
   delete blackvalidmoves;
   delete whitevalidmoves;
+  delete[] emptypositions;
+  delete[] emptyindex;
   
   delete lastchanges;
   
   delete blackgammas;
   delete whitegammas;
+  delete blacklocalgammas;
+  delete whitelocalgammas;
+  delete distancegammas;
+  delete featurechanges;
+  if (localhashes!=NULL)
+    delete localhashes;
   
   //XXX: memory will get freed when pool is destroyed
   /*for(std::list<Go::Group*,Go::allocator_groupptr>::iterator iter=groups.begin();iter!=groups.end();++iter) 
@@ -287,13 +382,19 @@ void Go::Board::copyOver(Go::Board *copyboard) const
   copyboard->secondlastmove=this->secondlastmove;
   
   copyboard->refreshGroups();
+  copyboard->refreshEmptyPositions();
   
   copyboard->symmetryupdated=this->symmetryupdated;
   copyboard->currentsymmetry=this->currentsymmetry;
-  copyboard->updateFeatureGammas();
+  // the feature gammas of the copy are stale now, setFeatures() will refresh them
+  copyboard->features=NULL;
+  copyboard->markchanges=false;
   
   copyboard->blackcaptures=this->blackcaptures;
   copyboard->whitecaptures=this->whitecaptures;
+  
+  if (copyboard->localhashes!=NULL)
+    copyboard->localhashes->refresh(copyboard);
 }
 
 std::string Go::Board::toString() const
@@ -350,6 +451,114 @@ std::string Go::Board::toSGFString() const
   return ss.str();
 }
 
+bool Go::loadSGFGame(std::string filename, int &size, std::list<Go::Move> &setup, std::list<Go::Move> &moves)
+{
+  std::ifstream fin(filename.c_str());
+
+  if (!fin)
+    return false;
+
+  std::string data((std::istreambuf_iterator<char>(fin)),std::istreambuf_iterator<char>());
+  fin.close();
+
+  std::string::size_type i=data.find('(');
+  if (i==std::string::npos)
+    return false;
+
+  //the main line is everything before the first closing bracket, following the first variation at each branch
+  std::list< std::pair<std::string,std::string> > props;
+  std::string ident;
+  bool inident=false;
+  for (i++;i<data.length() && data[i]!=')';i++)
+  {
+    char c=data[i];
+    if (c=='[')
+    {
+      std::string value;
+      for (i++;i<data.length() && data[i]!=']';i++)
+      {
+        if (data[i]=='\\' && (i+1)<data.length())
+          i++;
+        value+=data[i];
+      }
+      props.push_back(std::make_pair(ident,value));
+      inident=false;
+    }
+    else if (isupper(c))
+    {
+      if (!inident)
+        ident="";
+      ident+=c;
+      inident=true;
+    }
+    else if (!islower(c))
+      inident=false;
+  }
+
+  size=19;
+  for (std::list< std::pair<std::string,std::string> >::iterator iter=props.begin();iter!=props.end();++iter)
+  {
+    if (iter->first=="SZ")
+    {
+      std::istringstream iss(iter->second);
+      if (!(iss >> size) || size<2 || size>25)
+        return false;
+    }
+  }
+
+  setup.clear();
+  moves.clear();
+  for (std::list< std::pair<std::string,std::string> >::iterator iter=props.begin();iter!=props.end();++iter)
+  {
+    bool issetup=(iter->first=="AB" || iter->first=="AW");
+    if (!issetup && iter->first!="B" && iter->first!="W")
+      continue;
+
+    Go::Color col=(iter->first[iter->first.length()-1]=='B'?Go::BLACK:Go::WHITE);
+    std::string value=iter->second;
+    Go::Move move;
+    int x=(value.length()==2?value[0]-'a':-1);
+    int y=(value.length()==2?size-1-(value[1]-'a'):-1);
+    if (value.length()==0 || (value=="tt" && size<=19))
+      move=Go::Move(col,Go::Move::PASS);
+    else if (x>=0 && y>=0 && x<size && y<size)
+      move=Go::Move(col,x,y,size);
+    else if (issetup)
+      return false;
+    else //the rest of the game (e.g. after a resignation) is ignored
+      break;
+
+    if (issetup)
+    {
+      if (!move.isPass())
+        setup.push_back(move);
+    }
+    else
+      moves.push_back(move);
+  }
+
+  return true;
+}
+
+bool Go::loadSGFGameList(std::string filename, std::vector<std::string> &games)
+{
+  std::ifstream fin(filename.c_str());
+
+  if (!fin)
+    return false;
+
+  std::string line;
+  while (std::getline(fin,line))
+  {
+    std::string::size_type end=line.find_last_not_of(" \t\r");
+    if (end!=std::string::npos && line[0]!='#')
+      games.push_back(line.substr(0,end+1));
+  }
+  fin.close();
+
+  return true;
+}
+
 float Go::Board::score(Parameters* params)
 {
   Go::Board::ScoreVertex *scoredata;
@@ -572,6 +781,7 @@ void Go::Board::makeMove(Go::Move move)
   int posko=-1;
   
   this->setColor(pos,col);
+  this->removeEmptyPosition(pos);
   
   Go::Group *thisgroup=pool_group.construct(this,pos);
   this->setGroup(pos,thisgroup);
@@ -750,6 +960,16 @@ bool Go::Board::touchingAtLeastOneEmpty(int pos) const
   return false;
 }
 
+void Go::Board::refreshEmptyPositions()
+{
+  emptycount=0;
+  for (int p=0;p<sizedata;p++)
+  {
+    if (this->getColor(p)==Go::EMPTY)
+      this->addEmptyPosition(p);
+  }
+}
+
 void Go::Board::refreshGroups()
 {
   for (int p=0;p<sizedata;p++)
@@ -846,6 +1066,7 @@ void Go::Board::spreadRemoveStones(Go::Color col, int pos, std::list<int,Go::all
   //Go::Group *group=this->getGroupWithoutFind(pos); //see destroy() below
   
   this->setColor(pos,Go::EMPTY);
+  this->addEmptyPosition(pos);
   this->setGroup(pos,NULL);
   if (col==Go::BLACK)
     blackcaptures++;
@@ -1460,47 +1681,167 @@ void Go::Board::updateFeatureGammas()
   {
     Go::ObjectBoard<int> *cfglastdist=NULL;
     Go::ObjectBoard<int> *cfgsecondlastdist=NULL;
-    features->computeCFGDist(this,&cfglastdist,&cfgsecondlastdist);
+    bool usescfgdist=features->usesCFGDist();
+    //features that look further than the groups next to a change can't be updated incrementally
+    bool incremental=(incfeatures && !features->usesDistantFeatures());
+    if (usescfgdist || !incremental)
+      features->computeCFGDist(this,&cfglastdist,&cfgsecondlastdist);
     
-    if (incfeatures)
+    if (incremental)
     {
-      //expand to 3x3 neighbourhood first
-      //assume only the 3x3 neighbourhood is relevant
+      //only the 3x3 neighbourhood, the local and circular patterns around a change, and the adjacent groups are relevant to the local features
       //see: params->features_only_small
-      Go::BitBoard *changes3x3=new Go::BitBoard(size);
-      changes3x3->clear();
+      int circradius=features->getCircLevelsRadius();
+      featurechanges->clear();
       for (int p=0;p<sizedata;p++)
       {
         if (lastchanges->get(p))
         {
-          changes3x3->set(p);
+          featurechanges->set(p);
           foreach_adjdiag(p,q,{
             if (this->onBoard(q))
-              changes3x3->set(q);
+              featurechanges->set(q);
+          });
+          if (localhashes!=NULL && features->usesLocalPatterns())
+            localhashes->markAffected(p,featurechanges);
+          if (circradius>0)
+          {
+            int cx=Go::Position::pos2x(p,size);
+            int cy=Go::Position::pos2y(p,size);
+            for (int x=(cx>circradius?cx-circradius:0);x<=cx+circradius && x<size;x++)
+            {
+              for (int y=(cy>circradius?cy-circradius:0);y<=cy+circradius && y<size;y++)
+                featurechanges->set(Go::Position::xy2pos(x,y,size));
+            }
+          }
+        }
+      }
+      
+      // the liberties of any group next to a change can have new tactical features
+      std::vector<Go::Group*> changedgroups;
+      for (int p=0;p<sizedata;p++)
+      {
+        if (featurechanges->get(p) && this->inGroup(p))
+        {
+          Go::Group *group=this->getGroup(p);
+          if (std::find(changedgroups.begin(),changedgroups.end(),group)==changedgroups.end())
+            changedgroups.push_back(group);
+        }
+      }
+      // the capture of an adjacent group in atari can also change, see Features::CAPTURE
+      for (unsigned int i=0;i<changedgroups.size();i++)
+      {
+        Go::list_int *adjacentgroups=changedgroups[i]->getAdjacentGroups();
+        for(Go::list_int::iterator iter=adjacentgroups->begin();iter!=adjacentgroups->end();++iter)
+        {
+          if (this->inGroup((*iter)) && this->getGroup((*iter))->inAtari())
+            featurechanges->set(this->getGroup((*iter))->getAtariPosition());
+        }
+      }
+      // a re-capture depends on the last move, so it can move away from the changes, see Features::CAPTURE
+      if (featurerecapturepos>=0)
+        featurechanges->set(featurerecapturepos);
+      featurerecapturepos=this->getFeatureRecapturePosition();
+      if (featurerecapturepos>=0)
+        featurechanges->set(featurerecapturepos);
+      // the atari feature depends on whether there is a ko
+      bool kochanged=(this->isCurrentSimpleKo()!=featureko);
+      featureko=this->isCurrentSimpleKo();
+      
+      if (changedgroups.size()>0 || kochanged)
+      {
+        for (int i=0;i<emptycount;i++)
+        {
+          int p=emptypositions[i];
+          if (featurechanges->get(p))
+            continue;
+          foreach_adjacent(p,q,{
+            if (this->inGroup(q))
+            {
+              Go::Group *group=this->getGroup(q);
+              if ((kochanged && group->isOneOfTwoLiberties(p)) || std::find(changedgroups.begin(),changedgroups.end(),group)!=changedgroups.end())
+                featurechanges->set(p);
+            }
           });
         }
       }
       
       for (int p=0;p<sizedata;p++)
       {
-        if (changes3x3->get(p))
-          this->updateFeatureGamma(cfglastdist,cfgsecondlastdist,p);
+        if (featurechanges->get(p))
+        {
+          this->updateFeatureLocalGamma(Go::BLACK,p);
+          this->updateFeatureLocalGamma(Go::WHITE,p);
+        }
       }
-      delete changes3x3;
+      this->updateFeatureLocalGamma(Go::BLACK,0); //pass
+      this->updateFeatureLocalGamma(Go::WHITE,0);
+      featurechanges->set(0);
       
-      this->updateFeatureGamma(cfglastdist,cfgsecondlastdist,0); //pass
+      // the distance features only change near the current and previous last moves
+      if (usescfgdist)
+      {
+        for (int p=1;p<sizedata;p++)
+        {
+          if (this->onBoard(p))
+          {
+            this->updateFeatureDistanceGamma(cfglastdist,cfgsecondlastdist,p);
+            featurechanges->set(p);
+          }
+        }
+      }
+      else
+      {
+        int radius=(LASTDIST_LEVELS>SECONDLASTDIST_LEVELS?LASTDIST_LEVELS:SECONDLASTDIST_LEVELS)/2;
+        int centers[4]={featurelastpos,featuresecondlastpos,-1,-1};
+        if (lastmove.isNormal())
+          centers[2]=lastmove.getPosition();
+        if (secondlastmove.isNormal())
+          centers[3]=secondlastmove.getPosition();
+        for (int i=0;i<4;i++)
+        {
+          if (centers[i]<0)
+            continue;
+          int cx=Go::Position::pos2x(centers[i],size);
+          int cy=Go::Position::pos2y(centers[i],size);
+          for (int x=(cx>radius?cx-radius:0);x<=cx+radius && x<size;x++)
+          {
+            for (int y=(cy>radius?cy-radius:0);y<=cy+radius && y<size;y++)
+            {
+              int p=Go::Position::xy2pos(x,y,size);
+              this->updateFeatureDistanceGamma(NULL,NULL,p);
+              featurechanges->set(p);
+            }
+          }
+        }
+      }
+      featurelastpos=(lastmove.isNormal()?lastmove.getPosition():-1);
+      featuresecondlastpos=(secondlastmove.isNormal()?secondlastmove.getPosition():-1);
+      
+      for (int p=0;p<sizedata;p++)
+      {
+        if (featurechanges->get(p))
+        {
+          this->updateFeatureGamma(Go::BLACK,p);
+          this->updateFeatureGamma(Go::WHITE,p);
+        }
+      }
       
       lastchanges->clear();
+      
+      if (checkfeatures)
+        this->checkFeatureGammas(cfglastdist,cfgsecondlastdist);
     }
     else
     {
-      (nexttomove==Go::BLACK?blacktotalgamma:whitetotalgamma)=0;
       (nexttomove==Go::BLACK?blackgammas:whitegammas)->fill(0);
       lastchanges->clear();
       
       for (int p=0;p<sizedata;p++)
       {
-        this->updateFeatureGamma(cfglastdist,cfgsecondlastdist,nexttomove,p);
+        this->updateFeatureLocalGamma(nexttomove,p);
+        this->updateFeatureDistanceGamma(cfglastdist,cfgsecondlastdist,p);
+        this->updateFeatureGamma(nexttomove,p);
       }
     }
     
@@ -1511,13 +1852,37 @@ void Go::Board::updateFeatureGammas()
   }
 }
 
+void Go::Board::setLocalPatternHashes(bool use)
+{
+  if (use && localhashes==NULL)
+  {
+    localhashes=new Pattern::LocalHashes(size);
+    localhashes->refresh(this);
+  }
+  else if (!use && localhashes!=NULL)
+  {
+    delete localhashes;
+    localhashes=NULL;
+  }
+}
+
+void Go::Board::updateLocalPatternHashes(int pos, Go::Color col)
+{
+  if (data[pos].color!=col)
+    localhashes->update(pos,data[pos].color,col);
+}
+
 void Go::Board::refreshFeatureGammas()
 {
-  blacktotalgamma=0;
-  whitetotalgamma=0;
+  if (features->usesLocalPatterns())
+    this->setLocalPatternHashes(true);
   blackgammas->fill(0);
   whitegammas->fill(0);
   lastchanges->clear();
+  featureko=this->isCurrentSimpleKo();
+  featurelastpos=(lastmove.isNormal()?lastmove.getPosition():-1);
+  featuresecondlastpos=(secondlastmove.isNormal()?secondlastmove.getPosition():-1);
+  featurerecapturepos=this->getFeatureRecapturePosition();
   
   Go::ObjectBoard<int> *cfglastdist=NULL;
   Go::ObjectBoard<int> *cfgsecondlastdist=NULL;
@@ -1525,7 +1890,11 @@ void Go::Board::refreshFeatureGammas()
   
   for (int p=0;p<sizedata;p++)
   {
-    this->updateFeatureGamma(cfglastdist,cfgsecondlastdist,p);
+    this->updateFeatureLocalGamma(Go::BLACK,p);
+    this->updateFeatureLocalGamma(Go::WHITE,p);
+    this->updateFeatureDistanceGamma(cfglastdist,cfgsecondlastdist,p);
+    this->updateFeatureGamma(Go::BLACK,p);
+    this->updateFeatureGamma(Go::WHITE,p);
   }
   
   if (cfglastdist!=NULL)
@@ -1534,24 +1903,67 @@ void Go::Board::refreshFeatureGammas()
     delete cfgsecondlastdist;
 }
 
-void Go::Board::updateFeatureGamma(Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, int pos)
+void Go::Board::updateFeatureLocalGamma(Go::Color col, int pos)
 {
-  this->updateFeatureGamma(cfglastdist,cfgsecondlastdist,Go::BLACK,pos);
-  this->updateFeatureGamma(cfglastdist,cfgsecondlastdist,Go::WHITE,pos);
+  float gamma;
+  if (pos==0) //pass
+    gamma=features->getMoveLocalGamma(this,Go::Move(col,Go::Move::PASS));
+  else if (!this->weakEye(col,pos))
+    gamma=features->getMoveLocalGamma(this,Go::Move(col,pos));
+  else
+    gamma=0;
+  (col==Go::BLACK?blacklocalgammas:whitelocalgammas)->set(pos,gamma);
 }
 
-void Go::Board::updateFeatureGamma(Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, int pos)
+void Go::Board::updateFeatureDistanceGamma(Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, int pos)
 {
-  float oldgamma=(col==Go::BLACK?blackgammas:whitegammas)->get(pos);
-  float gamma;
   if (pos==0) //pass
-    gamma=features->getMoveGamma(this,cfglastdist,cfgsecondlastdist,Go::Move(col,Go::Move::PASS));
-  else if (!this->weakEye(nexttomove,pos))
-    gamma=features->getMoveGamma(this,cfglastdist,cfgsecondlastdist,Go::Move(col,pos));
+    distancegammas->set(pos,1.0);
   else
-    gamma=0;
-  (col==Go::BLACK?blackgammas:whitegammas)->set(pos,gamma);
-  (col==Go::BLACK?blacktotalgamma:whitetotalgamma)+=(gamma-oldgamma);
+    distancegammas->set(pos,features->getMoveDistanceGamma(this,cfglastdist,cfgsecondlastdist,Go::Move(nexttomove,pos)));
+}
+
+void Go::Board::updateFeatureGamma(Go::Color col, int pos)
+{
+  float gamma=(col==Go::BLACK?blacklocalgammas:whitelocalgammas)->get(pos)*distancegammas->get(pos);
+  if (gamma!=(col==Go::BLACK?blackgammas:whitegammas)->get(pos))
+    (col==Go::BLACK?blackgammas:whitegammas)->set(pos,gamma);
+}
+
+int Go::Board::getFeatureRecapturePosition() const
+{
+  //the only move that can capture the group of the last move
+  if (lastmove.isNormal() && this->inGroup(lastmove.getPosition()) && this->getGroup(lastmove.getPosition())->inAtari())
+    return this->getGroup(lastmove.getPosition())->getAtariPosition();
+  else
+    return -1;
+}
+
+void Go::Board::checkFeatureGammas(Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist)
+{
+  for (int p=0;p<sizedata;p++)
+  {
+    if (p!=0 && !this->onBoard(p))
+      continue;
+    
+    float distancegamma=(p==0?1.0:features->getMoveDistanceGamma(this,cfglastdist,cfgsecondlastdist,Go::Move(nexttomove,p)));
+    for (int c=0;c<2;c++)
+    {
+      Go::Color col=(c==0?Go::BLACK:Go::WHITE);
+      float localgamma;
+      if (p==0) //pass
+        localgamma=features->getMoveLocalGamma(this,Go::Move(col,Go::Move::PASS));
+      else if (!this->weakEye(col,p))
+        localgamma=features->getMoveLocalGamma(this,Go::Move(col,p));
+      else
+        localgamma=0;
+      
+      float gamma=localgamma*distancegamma;
+      float incgamma=(col==Go::BLACK?blackgammas:whitegammas)->get(p);
+      if (gamma!=incgamma)
+        fprintf(stderr,"[features] incremental gamma differs for %s at %s after %s: %f (full: %f)\n",(col==Go::BLACK?"B":"W"),(p==0?std::string("pass"):Go::Position::pos2string(p,size)).c_str(),lastmove.toString(size).c_str(),incgamma,gamma);
+    }
+  }
 }
 
 bool Go::Board::isCapture(Go::Move move) const
@@ -1819,32 +2231,48 @@ int Go::Board::getCircularDistance(int pos1, int pos2) const
 Go::ObjectBoard<int> *Go::Board::getCFGFrom(int pos, int max) const
 {
   Go::ObjectBoard<int> *cfgdist=new Go::ObjectBoard<int>(size);
-  std::list<int> posqueue, distqueue;
+  std::vector<int> current,next;
   cfgdist->fill(-1);
   
-  posqueue.push_back(pos);
-  distqueue.push_back(0);
-  while (!posqueue.empty())
+  // visit one distance at a time, so that each position is only visited once
+  cfgdist->set(pos,0);
+  current.push_back(pos);
+  int d=0;
+  while (!current.empty())
   {
-    int p=posqueue.front();posqueue.pop_front();
-    int d=distqueue.front();distqueue.pop_front();
-    
-    if ((max==0 || d<=max) && (cfgdist->get(p)==-1 || cfgdist->get(p)>d))
+    // the rest of a chain is at the same distance
+    for (unsigned int i=0;i<current.size();i++)
     {
+      int p=current[i];
       Go::Color col=this->getColor(p);
-      cfgdist->set(p,d);
-      
-      foreach_adjacent(p,q,{
-        if (this->onBoard(q))
+      if (col!=Go::EMPTY)
+      {
+        foreach_adjacent(p,q,{
+          if (this->getColor(q)==col && cfgdist->get(q)==-1)
+          {
+            cfgdist->set(q,d);
+            current.push_back(q);
+          }
+        });
+      }
+    }
+    
+    if (max!=0 && d>=max)
+      break;
+    
+    next.clear();
+    for (unsigned int i=0;i<current.size();i++)
+    {
+      foreach_adjacent(current[i],q,{
+        if (this->onBoard(q) && cfgdist->get(q)==-1)
         {
-          posqueue.push_back(q);
-          if (col!=Go::EMPTY && col==this->getColor(q))
-            distqueue.push_back(d);
-          else
-            distqueue.push_back(d+1);
+          cfgdist->set(q,d+1);
+          next.push_back(q);
         }
       });
     }
+    current.swap(next);
+    d++;
   }
   
   return cfgdist;
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <unordered_set>
 #include <boost/pool/pool.hpp>
 #include <boost/pool/pool_alloc.hpp>
@@ -18,6 +19,11 @@ class Features;
 class Parameters;
 //from "Random.h":
 class Random;
+//from "Pattern.h":
+namespace Pattern
+{
+  class LocalHashes;
+};
 
 #include <set>
 #define SYMMETRY_ONLYDEGRAGE false
@@ -88,6 +94,17 @@ namespace Go
   //typedef boost::fast_pool_allocator<Go::Group*> allocator_groupptr;
   /** A list of int's, using the specified memory allocator. */
   typedef std::list<int,Go::allocator_int> list_int;
+  /** Hash of groups by their key stones.
+   * Unlike a hash of the pointers, this doesn't depend on where the groups were allocated, so a set of groups
+   * built by the same sequence of insertions iterates in the same order every run.
+   */
+  class GroupHash
+  {
+    public:
+      size_t operator()(const Go::Group *group) const;
+  };
+  /** A set of groups. */
+  typedef std::ourset<Go::Group*,Go::GroupHash> group_set;
 
   /** Go colors. */
   enum Color
@@ -260,6 +277,37 @@ namespace Go
       T *const data;
   };
   
+  /** Board of non-negative weights that can be sampled from.
+   * A Fenwick tree over the positions keeps the running sums, so that setting a weight and finding a weighted position are both O(log n).
+   */
+  class SumBoard
+  {
+    public:
+      /** Create a board with the given size. */
+      SumBoard(int s);
+      ~SumBoard();
+      
+      /** Get the weight of a position. */
+      inline float get(int pos) const { return data[pos]; };
+      /** Set the weight of a position. */
+      void set(int pos, float val);
+      /** Fill the whole board with a set weight. */
+      void fill(float val);
+      /** Get the sum of all the weights. */
+      inline float getTotal() const { return total; };
+      /** Find the position where the running sum of weights first exceeds @p r.
+       * Returns -1 if @p r is not less than the total.
+       */
+      int find(float r) const;
+    
+    private:
+      const int size,sizedata;
+      int topmask;
+      float *const data;
+      double *const tree;
+      double total;
+  };
+  
   /** Go move.
    * This represents a move on a Go board.
    */
@@ -507,6 +555,11 @@ namespace Go
       std::list<int,Go::allocator_int> adjacentgroups;
   };
   
+  inline size_t GroupHash::operator()(const Go::Group *group) const
+  {
+    return group->getPosition();
+  };
+  
   /** Go board. */
   class Board
   {
@@ -548,7 +601,7 @@ namespace Go
        */
       const Go::Vertex *boardData() const { return data; };
       /** Get a list of the groups on this board. */
-      std::ourset<Go::Group*> *getGroups() { return &groups; };
+      Go::group_set *getGroups() { return &groups; };
       
       /** Get the size of this board. */
       int getSize() const { return size; };
@@ -605,6 +658,12 @@ namespace Go
       int numOfValidMoves(Go::Color col) const { return (col==Go::BLACK?blackvalidmovecount:whitevalidmovecount); };
       /** Get a board showing which moves are legal. */
       Go::BitBoard *getValidMoves(Go::Color col) const { return (col==Go::BLACK?blackvalidmoves:whitevalidmoves); };
+      /** Get the number of empty positions on the board. */
+      int getEmptyCount() const { return emptycount; };
+      /** Get the @p i th empty position.
+       * The empty positions are kept in an arbitrary order, which changes as moves are made.
+       */
+      int getEmptyPosition(int i) const { return emptypositions[i]; };
       
       /** Compute the current score. */
       float score(Parameters* params=NULL);
@@ -628,12 +687,25 @@ namespace Go
       /** Turn symmetry calculations on for this board. */
       void turnSymmetryOn() { symmetryupdated=true;currentsymmetry=this->computeSymmetry(); };
       
-      /** Set the features for the board and whether the gamma values should be updated incrementally. */
-      void setFeatures(Features *feat, bool inc) { features=feat; incfeatures=inc; markchanges=true; this->refreshFeatureGammas(); };
+      /** Set the features for the board and whether the gamma values should be updated incrementally.
+       * If @p check is set, each incremental update is compared to a full recompute and differences are reported.
+       */
+      void setFeatures(Features *feat, bool inc, bool check=false) { features=feat; incfeatures=inc; checkfeatures=check; markchanges=true; this->refreshFeatureGammas(); };
       /** Get the sum ofthe gamma values for this board. */
-      float getFeatureTotalGamma() const { return (nexttomove==Go::BLACK?blacktotalgamma:whitetotalgamma); };
+      float getFeatureTotalGamma() const { return (nexttomove==Go::BLACK?blackgammas:whitegammas)->getTotal(); };
       /** Get the gamma value for a position on this board. */
       float getFeatureGamma(int pos) const { return (nexttomove==Go::BLACK?blackgammas:whitegammas)->get(pos); };
+      /** Turn the local pattern hashes for this board on or off.
+       * While on, the hashes are updated with every stone that is added or removed.
+       * @see Pattern::LocalHashes
+       */
+      void setLocalPatternHashes(bool use);
+      /** Get the local pattern hashes for this board, or NULL if they are off. */
+      Pattern::LocalHashes *getLocalPatternHashes() const { return localhashes; };
+      /** Get the position where the running sum of gamma values first exceeds @p gamma.
+       * @see Go::SumBoard::find()
+       */
+      int findFeatureGamma(float gamma) const { return (nexttomove==Go::BLACK?blackgammas:whitegammas)->find(gamma); };
       
       /** Determine if the given score is a win for the given color. */
       static bool isWinForColor(Go::Color col, float score);
@@ -720,7 +792,7 @@ namespace Go
       const int sizesq;
       const int sizedata;
       Go::Vertex *const data;
-      std::ourset<Go::Group*> groups;
+      Go::group_set groups;
       int movesmade,passesplayed;
       Go::Color nexttomove;
       int simpleko;
@@ -728,18 +800,27 @@ namespace Go
       bool symmetryupdated;
       Go::Board::Symmetry currentsymmetry;
       int blackvalidmovecount,whitevalidmovecount;
+      int *emptypositions,*emptyindex;
+      int emptycount;
       Go::BitBoard *blackvalidmoves,*whitevalidmoves;
       boost::object_pool<Go::Group> pool_group;
       bool markchanges;
       Go::BitBoard *lastchanges;
       Features *features;
       bool incfeatures;
-      float blacktotalgamma;
-      float whitetotalgamma;
-      Go::ObjectBoard<float> *blackgammas;
-      Go::ObjectBoard<float> *whitegammas;
+      bool checkfeatures;
+      Go::SumBoard *blackgammas;
+      Go::SumBoard *whitegammas;
+      Go::ObjectBoard<float> *blacklocalgammas;
+      Go::ObjectBoard<float> *whitelocalgammas;
+      Go::ObjectBoard<float> *distancegammas;
+      Go::BitBoard *featurechanges;
+      bool featureko;
+      int featurelastpos,featuresecondlastpos;
+      int featurerecapturepos;
       int blackcaptures,whitecaptures;
       bool lastcapture;
+      Pattern::LocalHashes *localhashes;
       
       struct ScoreVertex
       {
@@ -749,7 +830,7 @@ namespace Go
       Go::Board::ScoreVertex *lastscoredata;
       
       inline Go::Group *getGroupWithoutFind(int pos) const { return data[pos].group; };
-      inline void setColor(int pos, Go::Color col) { data[pos].color=col; if (markchanges) { lastchanges->set(pos); } };
+      inline void setColor(int pos, Go::Color col) { if (localhashes!=NULL) { this->updateLocalPatternHashes(pos,col); } data[pos].color=col; if (markchanges) { lastchanges->set(pos); } };
       inline void setGroup(int pos, Go::Group *grp) { data[pos].group=grp; };
       inline int getPseudoLiberties(int pos) const { if (data[pos].group==NULL) return 0; else return data[pos].group->find()->numOfPseudoLiberties(); };
       inline int getGroupSize(int pos) const { if (data[pos].group==NULL) return 0; else return data[pos].group->find()->numOfStones(); };
@@ -768,6 +849,10 @@ namespace Go
       void addValidMove(Go::Move move);
       void removeValidMove(Go::Move move);
       
+      void refreshEmptyPositions();
+      inline void addEmptyPosition(int pos) { emptyindex[pos]=emptycount; emptypositions[emptycount++]=pos; };
+      inline void removeEmptyPosition(int pos) { int i=emptyindex[pos]; int last=emptypositions[--emptycount]; emptypositions[i]=last; emptyindex[last]=i; };
+      
       bool hasSymmetryVertical() const;
       bool hasSymmetryHorizontal() const;
       bool hasSymmetryDiagonalDown() const;
@@ -778,11 +863,27 @@ namespace Go
       void spreadScore(Go::Board::ScoreVertex *scoredata, int pos, Go::Color col);
       bool isProbableWorkingLadder(Go::Group *group, int posA, int movepos=-1) const;
       
+      void updateLocalPatternHashes(int pos, Go::Color col);
+      
       void refreshFeatureGammas();
       void updateFeatureGammas();
-      void updateFeatureGamma(Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, int pos);
-      void updateFeatureGamma(Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, Go::Color col, int pos);
+      void updateFeatureLocalGamma(Go::Color col, int pos);
+      void updateFeatureDistanceGamma(Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist, int pos);
+      void updateFeatureGamma(Go::Color col, int pos);
+      int getFeatureRecapturePosition() const;
+      void checkFeatureGammas(Go::ObjectBoard<int> *cfglastdist, Go::ObjectBoard<int> *cfgsecondlastdist);
   };
+  
+  /** Read the main line of a SGF game.
+   * Setup stones are returned as moves, in @p setup, before the moves of the game.
+   * The game ends at the first move that is neither a pass nor on the board.
+   * Returns false if the file can't be read or isn't a supported game.
+   */
+  bool loadSGFGame(std::string filename, int &size, std::list<Go::Move> &setup, std::list<Go::Move> &moves);
+  /** Read a list of SGF games, with one filename per line.
+   * Empty lines and lines starting with '#' are ignored.
+   */
+  bool loadSGFGameList(std::string filename, std::vector<std::string> &games);
 };
 
 #endif
@@ -0,0 +1,190 @@
+#include "Harvester.h"
+
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include "Parameters.h"
+#include "Pattern.h"
+#include "Worker.h"
+#include "Random.h"
+
+Harvester::Harvester(Parameters *prms, Features *feat, Worker::Pool *pl, Harvester::Type t, int csize)
+  : params(prms),
+    features(feat),
+    pool(pl),
+    type(t),
+    circsize(csize)
+{
+  nextgame=0;
+  gamecount=0;
+  positioncount=0;
+  if (type==Harvester::PATTERN3X3)
+    counts3x3.assign(PATTERN_3x3_GAMMAS,0);
+}
+
+Harvester::~Harvester()
+{
+}
+
+void Harvester::harvest(std::vector<std::string> gamelist)
+{
+  games=gamelist;
+  nextgame=0;
+  params->thread_job=Parameters::TJ_HARVEST;
+  pool->startAll();
+  pool->waitAll();
+  games.clear();
+}
+
+void Harvester::doThreadWork(Worker::Settings *settings)
+{
+  std::vector<long int> localcounts3x3;
+  Harvester::CircCountMap localcirccounts;
+  unsigned int localgames=0;
+  unsigned long localpositions=0;
+
+  if (type==Harvester::PATTERN3X3)
+    localcounts3x3.assign(PATTERN_3x3_GAMMAS,0);
+
+  while (true)
+  {
+    std::string game;
+    {
+      boost::mutex::scoped_lock lock(datamutex);
+      if (nextgame>=games.size())
+        break;
+      game=games[nextgame++];
+    }
+
+    int size;
+    std::list<Go::Move> setup,moves;
+    if (!Go::loadSGFGame(game,size,setup,moves))
+    {
+      fprintf(stderr,"[harvest] skipping game: '%s'\n",game.c_str());
+      continue;
+    }
+
+    Go::Board *board=new Go::Board(size);
+    for (std::list<Go::Move>::iterator iter=setup.begin();iter!=setup.end();++iter)
+    {
+      if (board->validMove(*iter))
+        board->makeMove(*iter);
+    }
+
+    for (std::list<Go::Move>::iterator iter=moves.begin();iter!=moves.end();++iter)
+    {
+      if (!board->validMove(*iter))
+        break;
+      if (type==Harvester::PATTERN3X3 || (*iter).isNormal())
+      {
+        this->harvestPosition(board,(*iter),settings,localcounts3x3,localcirccounts);
+        localpositions++;
+      }
+      board->makeMove(*iter);
+    }
+    delete board;
+    localgames++;
+  }
+
+  boost::mutex::scoped_lock lock(datamutex);
+  gamecount+=localgames;
+  positioncount+=localpositions;
+  for (unsigned int i=0;i<localcounts3x3.size();i++)
+    counts3x3[i]+=localcounts3x3[i];
+  for (Harvester::CircCountMap::iterator it=localcirccounts.begin();it!=localcirccounts.end();++it)
+    circcounts[it->first]+=it->second;
+}
+
+void Harvester::harvestPosition(Go::Board *board, Go::Move move, Worker::Settings *settings, std::vector<long int> &localcounts3x3, Harvester::CircCountMap &localcirccounts)
+{
+  Go::Color col=move.getColor();
+
+  if (type==Harvester::PATTERN3X3)
+  {
+    for (int p=0;p<board->getPositionMax();p++)
+    {
+      if (board->validMove(Go::Move(col,p)))
+      {
+        unsigned int hash=Pattern::ThreeByThree::makeHash(board,p);
+        if (col==Go::WHITE)
+          hash=Pattern::ThreeByThree::invert(hash);
+        localcounts3x3[Pattern::ThreeByThree::smallestEquivalent(hash)]++;
+      }
+    }
+    return;
+  }
+
+  int pos=move.getPosition();
+  if (type==Harvester::CIRCULAR_NOT_PLAYED)
+  {
+    //take the first legal move after a random point, that isn't the move played
+    int r=settings->rand->getRandomInt(board->getPositionMax());
+    pos=-1;
+    for (int i=0;i<board->getPositionMax();i++)
+    {
+      int p=(r+i)%board->getPositionMax();
+      if (p!=move.getPosition() && board->validMove(Go::Move(col,p)))
+      {
+        pos=p;
+        break;
+      }
+    }
+    if (pos<0)
+      return;
+  }
+
+  Pattern::CircularDictionary *dict=features->getCircDict();
+  Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(dict,board,pos,PATTERN_CIRC_MAXSIZE,col==Go::WHITE);
+  localcirccounts[pattcirc.getSubPattern(dict,circsize)]++;
+}
+
+unsigned long Harvester::getPatternCount() const
+{
+  if (type!=Harvester::PATTERN3X3)
+    return circcounts.size();
+
+  unsigned long n=0;
+  for (unsigned int i=0;i<counts3x3.size();i++)
+  {
+    if (counts3x3[i]>0)
+      n++;
+  }
+  return n;
+}
+
+bool Harvester::saveCounts(std::string filename) const
+{
+  FILE *file=fopen(filename.c_str(),"w");
+
+  if (file==NULL)
+    return false;
+
+  if (type==Harvester::PATTERN3X3)
+  {
+    std::vector< std::pair<long int,unsigned int> > sorted;
+    for (unsigned int i=0;i<counts3x3.size();i++)
+    {
+      if (counts3x3[i]>0)
+        sorted.push_back(std::make_pair(-counts3x3[i],i));
+    }
+    std::sort(sorted.begin(),sorted.end());
+
+    for (unsigned int i=0;i<sorted.size();i++)
+      fprintf(file,"%ld 0x%04x\n",-sorted[i].first,sorted[i].second);
+  }
+  else
+  {
+    Pattern::CircularDictionary *dict=features->getCircDict();
+    std::vector< std::pair<long int,std::string> > sorted;
+    for (Harvester::CircCountMap::const_iterator it=circcounts.begin();it!=circcounts.end();++it)
+      sorted.push_back(std::make_pair(-it->second,it->first.toString(dict)));
+    std::sort(sorted.begin(),sorted.end());
+
+    for (unsigned int i=0;i<sorted.size();i++)
+      fprintf(file,"%ld %s\n",-sorted[i].first,sorted[i].second.c_str());
+  }
+
+  fclose(file);
+
+  return true;
+}
@@ -0,0 +1,87 @@
+#ifndef DEF_OAKFOAM_HARVESTER_H
+#define DEF_OAKFOAM_HARVESTER_H
+
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "Go.h"
+#include "Features.h"
+//from "Parameters.h":
+class Parameters;
+//from "Worker.h":
+namespace Worker
+{
+  class Settings;
+  class Pool;
+};
+
+/** Harvesting of pattern frequencies from a collection of games.
+ * Each worker thread replays its share of the games and counts the patterns in a table of its own,
+ * the tables are then combined once all the games have been replayed.
+ */
+class Harvester
+{
+  public:
+    /** Kinds of patterns to harvest. */
+    enum Type
+    {
+      /** 3x3 patterns of all the legal moves. */
+      PATTERN3X3,
+      /** Circular patterns of the moves played. */
+      CIRCULAR,
+      /** Circular patterns of a random legal move that wasn't played. */
+      CIRCULAR_NOT_PLAYED
+    };
+
+    /** Create a harvester of a type of pattern.
+     * @p csize is the size of the circular patterns harvested.
+     */
+    Harvester(Parameters *prms, Features *feat, Worker::Pool *pool, Harvester::Type t, int csize=0);
+    ~Harvester();
+
+    /** Harvest the patterns from a list of SGF games.
+     * Games that can't be read are skipped with a warning.
+     */
+    void harvest(std::vector<std::string> games);
+    /** Save the pattern counts, in order of decreasing count.
+     * The 3x3 patterns are in the format of harvest-patterns.sh and
+     * the circular patterns in the format of Features::loadCircFile().
+     */
+    bool saveCounts(std::string filename) const;
+
+    /** Get the number of games replayed. */
+    unsigned int getGameCount() const { return gamecount; };
+    /** Get the number of positions the patterns were harvested from. */
+    unsigned long getPositionCount() const { return positioncount; };
+    /** Get the number of distinct patterns found. */
+    unsigned long getPatternCount() const;
+
+    /** Do a share of the harvesting for a worker thread. */
+    void doThreadWork(Worker::Settings *settings);
+
+  private:
+#ifdef with_unordered
+    typedef std::unordered_map<Pattern::Circular,long int,circHash> CircCountMap;
+#else
+    typedef std::map<Pattern::Circular,long int> CircCountMap;
+#endif
+
+    Parameters *const params;
+    Features *const features;
+    Worker::Pool *const pool;
+    const Harvester::Type type;
+    const int circsize;
+
+    std::vector<std::string> games;
+    unsigned int nextgame;
+    boost::mutex datamutex;
+
+    unsigned int gamecount;
+    unsigned long positioncount;
+    std::vector<long int> counts3x3;
+    Harvester::CircCountMap circcounts;
+
+    void harvestPosition(Go::Board *board, Go::Move move, Worker::Settings *settings, std::vector<long int> &localcounts3x3, Harvester::CircCountMap &localcirccounts);
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "MovePrediction.h"
+
+#include <cstdio>
+#include <cmath>
+#include <sstream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "Parameters.h"
+#include "Features.h"
+#include "Worker.h"
+
+MovePrediction::MovePrediction(Parameters *prms, Features *feat, Worker::Pool *pl)
+  : params(prms),
+    features(feat),
+    pool(pl)
+{
+  nextgame=0;
+  seconds=0;
+  MovePrediction::clearResults(results);
+}
+
+MovePrediction::~MovePrediction()
+{
+}
+
+void MovePrediction::clearResults(MovePrediction::Results &res)
+{
+  res.games=0;
+  res.skipped=0;
+  res.positions=0;
+  for (int i=0;i<=MOVEPREDICTION_RANKS;i++)
+    res.ranks[i]=0;
+  res.ranksum=0;
+  res.loglikelihood=0;
+  res.zeroprobability=0;
+  res.evaluationseconds=0;
+}
+
+void MovePrediction::run(std::vector<std::string> gamelist)
+{
+  boost::posix_time::ptime start=boost::posix_time::microsec_clock::local_time();
+
+  MovePrediction::clearResults(results);
+  games=gamelist;
+  nextgame=0;
+  params->thread_job=Parameters::TJ_PREDICT;
+  pool->startAll();
+  pool->waitAll();
+  games.clear();
+
+  seconds=(double)(boost::posix_time::microsec_clock::local_time()-start).total_microseconds()/1000000;
+}
+
+void MovePrediction::doThreadWork(Worker::Settings *)
+{
+  MovePrediction::Results res;
+  MovePrediction::clearResults(res);
+
+  while (true)
+  {
+    std::string game;
+    {
+      boost::mutex::scoped_lock lock(datamutex);
+      if (nextgame>=games.size())
+        break;
+      game=games[nextgame++];
+    }
+
+    int size;
+    std::list<Go::Move> setup,moves;
+    if (!Go::loadSGFGame(game,size,setup,moves))
+    {
+      fprintf(stderr,"[prediction] skipping game: '%s'\n",game.c_str());
+      res.skipped++;
+      continue;
+    }
+
+    Go::Board *board=new Go::Board(size);
+    Go::ObjectBoard<float> *gammas=new Go::ObjectBoard<float>(size);
+    for (std::list<Go::Move>::iterator iter=setup.begin();iter!=setup.end();++iter)
+    {
+      if (board->validMove(*iter))
+        board->makeMove(*iter);
+    }
+
+    for (std::list<Go::Move>::iterator iter=moves.begin();iter!=moves.end();++iter)
+    {
+      if (!board->validMove(*iter))
+        break;
+      this->testPosition(board,(*iter),gammas,res);
+      board->makeMove(*iter);
+    }
+
+    delete gammas;
+    delete board;
+    res.games++;
+  }
+
+  boost::mutex::scoped_lock lock(datamutex);
+  results.games+=res.games;
+  results.skipped+=res.skipped;
+  results.positions+=res.positions;
+  for (int i=0;i<=MOVEPREDICTION_RANKS;i++)
+    results.ranks[i]+=res.ranks[i];
+  results.ranksum+=res.ranksum;
+  results.loglikelihood+=res.loglikelihood;
+  results.zeroprobability+=res.zeroprobability;
+  results.evaluationseconds+=res.evaluationseconds;
+}
+
+void MovePrediction::testPosition(Go::Board *board, Go::Move move, Go::ObjectBoard<float> *gammas, MovePrediction::Results &res)
+{
+  Go::Color col=move.getColor();
+  boost::posix_time::ptime start=boost::posix_time::microsec_clock::local_time();
+
+  Go::ObjectBoard<int> *cfglastdist=NULL;
+  Go::ObjectBoard<int> *cfgsecondlastdist=NULL;
+  features->computeCFGDist(board,&cfglastdist,&cfgsecondlastdist);
+  float total=features->getBoardGammas(board,cfglastdist,cfgsecondlastdist,col,gammas);
+  if (cfglastdist!=NULL)
+    delete cfglastdist;
+  if (cfgsecondlastdist!=NULL)
+    delete cfgsecondlastdist;
+
+  res.evaluationseconds+=(double)(boost::posix_time::microsec_clock::local_time()-start).total_microseconds()/1000000;
+
+  //the pass move is at position 0 of the gammas, but is ranked after all the other moves
+  int played=(move.isPass()?board->getPositionMax():move.getPosition());
+  float gamma=gammas->get(move.isPass()?0:played);
+  int rank=1;
+  for (int p=1;p<=board->getPositionMax();p++)
+  {
+    if (p==played)
+      continue;
+    bool pass=(p==board->getPositionMax());
+    float g=gammas->get(pass?0:p);
+    if (g>gamma)
+      rank++;
+    else if (g==gamma && p<played && board->validMove(pass?Go::Move(col,Go::Move::PASS):Go::Move(col,p)))
+      rank++;
+  }
+
+  res.positions++;
+  res.ranks[(rank<=MOVEPREDICTION_RANKS?rank-1:MOVEPREDICTION_RANKS)]++;
+  res.ranksum+=rank;
+  if (gamma>0 && total>0)
+    res.loglikelihood+=log(gamma/total);
+  else
+    res.zeroprobability++;
+}
+
+std::string MovePrediction::toJSON() const
+{
+  std::ostringstream ss;
+  double positions=(results.positions>0?results.positions:1);
+  unsigned long likelypositions=results.positions-results.zeroprobability;
+
+  ss<<"{\n";
+  ss<<"  \"games\": "<<results.games<<",\n";
+  ss<<"  \"games_skipped\": "<<results.skipped<<",\n";
+  ss<<"  \"positions\": "<<results.positions<<",\n";
+  ss<<"  \"threads\": "<<pool->getSize()<<",\n";
+  ss<<"  \"features\": {";
+  ss<<"\"pattern3x3\": "<<(features->getPatternGammas()->getCount()>0?"true":"false");
+  ss<<", \"circular_gammas\": "<<(features->usesCircPatternGammas()?"true":"false");
+  ss<<", \"circular_values\": "<<(params->uct_factor_circpattern>0?"true":"false");
+  ss<<", \"local\": "<<(features->usesLocalPatterns()?"true":"false");
+  ss<<", \"decision_trees\": "<<(params->features_dt_use?"true":"false");
+  ss<<"},\n";
+
+  ss<<"  \"top_k\": {";
+  unsigned long cumulative=0;
+  for (int k=1;k<=MOVEPREDICTION_RANKS;k++)
+  {
+    cumulative+=results.ranks[k-1];
+    ss<<(k>1?", ":"")<<"\""<<k<<"\": "<<cumulative/positions;
+  }
+  ss<<"},\n";
+  ss<<"  \"rank_counts\": [";
+  for (int i=0;i<=MOVEPREDICTION_RANKS;i++)
+    ss<<(i>0?", ":"")<<results.ranks[i];
+  ss<<"],\n";
+  ss<<"  \"mean_rank\": "<<results.ranksum/positions<<",\n";
+  ss<<"  \"mean_log_likelihood\": "<<(likelypositions>0?results.loglikelihood/likelypositions:0)<<",\n";
+  ss<<"  \"zero_probability_positions\": "<<results.zeroprobability<<",\n";
+  ss<<"  \"seconds\": "<<seconds<<",\n";
+  ss<<"  \"evaluation_seconds\": "<<results.evaluationseconds<<",\n";
+  ss<<"  \"positions_per_second\": "<<(seconds>0?results.positions/seconds:0)<<",\n";
+  ss<<"  \"evaluations_per_thread_second\": "<<(results.evaluationseconds>0?results.positions/results.evaluationseconds:0)<<"\n";
+  ss<<"}";
+
+  return ss.str();
+}
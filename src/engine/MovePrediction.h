@@ -0,0 +1,72 @@
+#ifndef DEF_OAKFOAM_MOVEPREDICTION_H
+#define DEF_OAKFOAM_MOVEPREDICTION_H
+
+#define MOVEPREDICTION_RANKS 20
+
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "Go.h"
+//from "Parameters.h":
+class Parameters;
+//from "Features.h":
+class Features;
+//from "Worker.h":
+namespace Worker
+{
+  class Settings;
+  class Pool;
+};
+
+/** Move prediction test of the feature gammas.
+ * For every position of a collection of games, all the moves are weighted as in the tree and
+ * the rank and probability of the move played are recorded.
+ * The games are shared between the worker threads.
+ */
+class MovePrediction
+{
+  public:
+    MovePrediction(Parameters *prms, Features *feat, Worker::Pool *pool);
+    ~MovePrediction();
+
+    /** Replay a list of SGF games and test the prediction of each move.
+     * Games that can't be read are skipped with a warning.
+     */
+    void run(std::vector<std::string> games);
+    /** Get the results of the last run as a JSON object.
+     * Ties between moves are ranked in position order, as with features_ordered_comparison.
+     */
+    std::string toJSON() const;
+
+    /** Do a share of the games for a worker thread. */
+    void doThreadWork(Worker::Settings *settings);
+
+  private:
+    struct Results
+    {
+      unsigned int games;
+      unsigned int skipped;
+      unsigned long positions;
+      unsigned long ranks[MOVEPREDICTION_RANKS+1];
+      double ranksum;
+      double loglikelihood;
+      unsigned long zeroprobability;
+      double evaluationseconds;
+    };
+
+    Parameters *const params;
+    Features *const features;
+    Worker::Pool *const pool;
+
+    std::vector<std::string> games;
+    unsigned int nextgame;
+    boost::mutex datamutex;
+
+    MovePrediction::Results results;
+    double seconds;
+
+    static void clearResults(MovePrediction::Results &res);
+    void testPosition(Go::Board *board, Go::Move move, Go::ObjectBoard<float> *gammas, MovePrediction::Results &res);
+};
+
+#endif
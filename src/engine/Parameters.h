@@ -48,12 +48,21 @@ class Parameters
     
     /** Number of threads to use. */
     int thread_count;
+    /** Whether the threads should search in a reproducible way, for benchmarking.
+     * The threads then take turns in a fixed order and each performs a fixed share of the playouts.
+     * Time limits and early stopping are ignored, and the result only depends on rand_seed.
+     * scripts/benchmark/deterministic.sh checks this.
+     */
+    bool thread_deterministic;
     /** Jobs that the threads can perform. */
     enum ThreadJob
     {
       TJ_GENMOVE,
       TJ_PONDER,
-      TJ_DONPLTS
+      TJ_DONPLTS,
+      TJ_TRAIN,
+      TJ_HARVEST,
+      TJ_PREDICT
     };
     /** Current thread job. */
     Parameters::ThreadJob thread_job;
@@ -97,8 +106,17 @@ class Parameters
      * The feature gamma of a move over the sum of the gammas is the probability of that move being played.
      */
     bool playout_features_enabled;
-    /** Whether to try to update the feature gammas incrementally. */
+    /** Whether to update the feature gammas incrementally.
+     * Only the moves next to a change, or next to a group with changed liberties, within the circular patterns around a change,
+     * and those that depend on the last moves are updated.
+     * Features that look further than the adjacent groups, such as ladders, decision trees and circular pattern values,
+     * make the gammas be recomputed in full instead.
+     */
     bool playout_features_incremental;
+    /** Whether to compare each incremental update of the feature gammas to a full recompute, for debugging.
+     * Differences are reported on stderr.
+     */
+    bool playout_features_incremental_check;
     /** The probability of using the lastatari heuristic in playouts.
      * If the last move was an atari, try to extend the group in atari.
      */
@@ -130,6 +148,12 @@ class Parameters
     float playout_random_weight_territory_f;
     /** Number of times to try the circpattern heuristic before continuing. */
     int playout_circpattern_n;
+    /** Whether the circpattern and circreplace heuristics may pick moves that match a known circular pattern.
+     * Before the circular patterns were keyed by their packed hash, these lookups never matched, so this is off by default to keep the old playouts.
+     * @see playout_circpattern_n
+     * @see playout_circreplace_enabled
+     */
+    bool playout_circpattern_match;
     /** The probability of using the anycapture heuristic in playouts.
      * If any groups are in atari, capture one at random.
      */
@@ -139,6 +163,10 @@ class Parameters
      */
     bool playout_lgrf1_enabled;
     bool playout_lgrf_local;
+    /** Number of playouts a thread buffers before merging them into the shared LGRF tables.
+     * A value of 1 updates the tables after every playout, as is always done with a single thread.
+     */
+    int playout_lgrf_merge_interval;
     bool playout_lgrf1_safe_enabled;
 
     float playout_avoid_lbrf1_p;
@@ -165,12 +193,26 @@ class Parameters
      * @see playout_mercy_rule_enabled
      */
     float playout_mercy_rule_factor;
+    /** Whether to stop playouts once the outcome is settled.
+     * A playout is settled when every empty region is bordered by a single color and Benson's algorithm shows all the stones to be pass-alive.
+     */
+    bool playout_settled_cutoff;
+    /** Largest fraction of the board area that may be empty before checking if a playout is settled.
+     * @see playout_settled_cutoff
+     */
+    float playout_settled_cutoff_empty;
 
     bool dynkomi_enabled;
 
     bool mm_learn_enabled;
     float mm_learn_delta;
     int mm_learn_min_playouts;
+    /** Probability of each position of a game being used as a competition when training feature gammas.
+     * The positions are drawn from rand_seed and the index of the game, so they don't depend on thread_count.
+     */
+    float mm_train_sample;
+    /** Number of MM iterations when training feature gammas. */
+    int mm_train_iterations;
     
     float test_p1;
     float test_p2;
@@ -200,6 +242,19 @@ class Parameters
      * Set to zero to disable.
      */
     float playout_random_chance;
+    /** Whether to measure the time spent in each stage of the playout policy.
+     * The results are shown by the playoutstats GTP command.
+     */
+    bool playout_stats_timing;
+    /** Trace every n-th playout of each thread.
+     * The traces are written out by the playouttrace GTP command.
+     * Set to zero to disable.
+     */
+    int playout_trace_interval;
+    /** Number of moves kept in the playout trace of each thread.
+     * @see playout_trace_interval
+     */
+    int playout_trace_size;
     /** Probability of replacing a random  self-atari move with an approach move. */
     float playout_random_approach_p;
     /** Whether to use the last2libatari heuristic in playouts.
@@ -229,6 +284,11 @@ class Parameters
      * @see playout_poolrave_enabled
      */
     int playout_poolrave_min_playouts;
+    /** Fraction by which the playouts through a node must grow before its poolRAVE pools are rebuilt.
+     * Set to zero to rebuild the pools after every playout through the node.
+     * @see playout_poolrave_enabled
+     */
+    float playout_poolrave_refresh;
     /** Whether to use the avoid self-atari in playouts.
      * Avoid self-atari at almost all cost, like the eye-filling rule.
      */
@@ -283,6 +343,10 @@ class Parameters
     
     /** After this many playouts through a node, it will be expanded. */
     int uct_expand_after;
+    /** Number of playouts to perform from each selected leaf.
+     * The results of the batch are backed up through the tree once, amortising the descent and backup costs.
+     */
+    int uct_leaf_playouts;
     /** Whether to keep the sub-tree when a move is made.
      * It does not make sense to enable pondering if this is not set.
      */
@@ -604,6 +668,10 @@ class Parameters
      * Used to measure feature accuracy.
      */
     bool dt_ordered_comparison;
+    /** Whether to check each weight from a compiled decision tree against the leaves found by walking the tree.
+     * Differences are reported on stderr. Used for debugging.
+     */
+    bool dt_program_check;
     
     #ifdef HAVE_MPI
       /** Period between MPI syncs.
@@ -1,10 +1,15 @@
 #include "Pattern.h"
 
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 unsigned int Pattern::ThreeByThree::makeHash(Go::Color colnw, Go::Color coln, Go::Color colne, Go::Color colw, Go::Color cole, Go::Color colsw, Go::Color cols, Go::Color colse)
 {
@@ -130,13 +135,6 @@ int Pattern::FiveByFiveBorder::hashColor(Go::Color col)
   }
 }
 
-unsigned int Pattern::ThreeByThree::invert(unsigned int hash)
-{
- unsigned int oddbits=  hash&(0x5555);
- unsigned int evenbits= hash&(0xAAAA);
- return ((evenbits>>1) | (oddbits<<1));
-}
-
 unsigned int Pattern::ThreeByThree::rotateRight(unsigned int hash)
 {
   unsigned int right2=  hash&(0xC0C0);
@@ -177,6 +175,42 @@ unsigned int Pattern::ThreeByThree::smallestEquivalent(unsigned int hash)
   return smallesthash;
 }
 
+Pattern::ThreeByThreeGammaTable::ThreeByThreeGammaTable()
+  : slots((boost::uint16_t *)malloc(sizeof(boost::uint16_t)*PATTERN_3x3_GAMMAS))
+{
+  //the smallest equivalent is never larger than the hash, so its slot is already assigned
+  int count=0;
+  for (unsigned int hash=0;hash<PATTERN_3x3_GAMMAS;hash++)
+  {
+    unsigned int smallest=Pattern::ThreeByThree::smallestEquivalent(hash);
+    if (smallest==hash)
+      slots[hash]=count++;
+    else
+      slots[hash]=slots[smallest];
+  }
+  
+  gammas=(float *)malloc(sizeof(float)*count);
+  for (int i=0;i<count;i++)
+    gammas[i]=1;
+}
+
+void Pattern::ThreeByThreeGammaTable::update(const Pattern::ThreeByThreeGammas *source, unsigned int hash)
+{
+  if (Pattern::ThreeByThree::smallestEquivalent(hash)!=hash)
+    return;
+  
+  gammas[slots[hash]]=(source->hasGamma(hash)?source->getGamma(hash):1);
+}
+
+void Pattern::ThreeByThreeGammaTable::updateAll(const Pattern::ThreeByThreeGammas *source)
+{
+  for (unsigned int hash=0;hash<PATTERN_3x3_GAMMAS;hash++)
+  {
+    if (Pattern::ThreeByThree::smallestEquivalent(hash)==hash)
+      gammas[slots[hash]]=(source->hasGamma(hash)?source->getGamma(hash):1);
+  }
+}
+
 void Pattern::ThreeByThreeTable::updatePatternTransformed(bool addpattern, unsigned int pattern, bool addinverted)
 {
   unsigned int currentpattern=pattern;
@@ -358,6 +392,8 @@ Pattern::CircularDictionary::CircularDictionary()
     flip_l14[i]=0;
   }
   
+  baseoffset[0]=0;
+  baseoffset[1]=0;
   int base=0;
   for (int d=2;d<=PATTERN_CIRC_MAXSIZE;d++)
   {
@@ -452,43 +488,167 @@ Pattern::CircularDictionary::CircularDictionary()
       }
     }
   }
+  baseoffset[PATTERN_CIRC_MAXSIZE+1]=base;
+  
+  //flat copies of the offsets, with the point at each offset
+  int pointat[2*PATTERN_CIRC_MAXSIZE+1][2*PATTERN_CIRC_MAXSIZE+1];
+  for (int x=0;x<2*PATTERN_CIRC_MAXSIZE+1;x++)
+    for (int y=0;y<2*PATTERN_CIRC_MAXSIZE+1;y++)
+      pointat[x][y]=-1;
+  for (int i=0;i<PATTERN_CIRC_MAXPOINTS;i++)
+  {
+    offsetx[i]=0;
+    offsety[i]=0;
+  }
+  radius[0]=0;
+  radius[1]=0;
+  int point=0;
+  for (int d=2;d<=PATTERN_CIRC_MAXSIZE;d++)
+  {
+    radius[d]=radius[d-1];
+    std::list<int>::iterator iterx=dictx[d].begin();
+    std::list<int>::iterator itery=dicty[d].begin();
+    while (iterx!=dictx[d].end() && itery!=dicty[d].end())
+    {
+      offsetx[point]=(*iterx);
+      offsety[point]=(*itery);
+      pointat[(*iterx)+PATTERN_CIRC_MAXSIZE][(*itery)+PATTERN_CIRC_MAXSIZE]=point;
+      if (abs(*iterx)>radius[d])
+        radius[d]=abs(*iterx);
+      if (abs(*itery)>radius[d])
+        radius[d]=abs(*itery);
+      ++iterx;
+      ++itery;
+      point++;
+    }
+  }
+  
+  //position deltas on a board with a single shared border column (see Go::Position::xy2pos())
+  for (int s=0;s<=PATTERN_CIRC_MAXBOARDSIZE;s++)
+  {
+    for (int i=0;i<PATTERN_CIRC_MAXPOINTS;i++)
+      posdeltas[s][i]=offsetx[i]+offsety[i]*(s+1);
+  }
+  
+  //the 4 rotations, followed by the 4 rotations of the flipped pattern
+  for (int i=0;i<PATTERN_CIRC_MAXPOINTS;i++)
+  {
+    int x=offsetx[i];
+    int y=offsety[i];
+    int tx[PATTERN_CIRC_SYMMETRIES]={x,y,-x,-y,-x,y,x,-y};
+    int ty[PATTERN_CIRC_SYMMETRIES]={y,-x,-y,x,y,x,-y,-x};
+    for (int s=0;s<PATTERN_CIRC_SYMMETRIES;s++)
+    {
+      if (i<point)
+        symmetries[s][i]=pointat[tx[s]+PATTERN_CIRC_MAXSIZE][ty[s]+PATTERN_CIRC_MAXSIZE];
+      else
+        symmetries[s][i]=i;
+    }
+  }
 }
 
 Pattern::Circular::Circular(Pattern::CircularDictionary *dict, const Go::Board *board, int pos, int sz) : size(sz>PATTERN_CIRC_MAXSIZE?PATTERN_CIRC_MAXSIZE:sz)
 {
   ldict=dict;
+  unsigned char cols[PATTERN_CIRC_MAXPOINTS];
+  Pattern::Circular::readColors(dict,board,pos,size,false,cols);
+  this->setFromColors(dict,cols);
+}
+
+Pattern::Circular Pattern::Circular::makeSmallestEquivalent(Pattern::CircularDictionary *dict, const Go::Board *board, int pos, int sz, bool invertcolors)
+{
+  Pattern::Circular patt(sz>PATTERN_CIRC_MAXSIZE?PATTERN_CIRC_MAXSIZE:sz);
+  patt.ldict=dict;
+  unsigned char cols[PATTERN_CIRC_MAXPOINTS];
+  Pattern::Circular::readColors(dict,board,pos,patt.size,invertcolors,cols);
+  patt.setSmallestFromColors(dict,cols);
+  return patt;
+}
+
+void Pattern::Circular::readColors(Pattern::CircularDictionary *dict, const Go::Board *board, int pos, int sz, bool invertcolors, unsigned char *cols)
+{
+  //hash colors, indexed by Go::Color
+  static const unsigned char hashcols[4]={0,1,2,3};
+  static const unsigned char invhashcols[4]={0,2,1,3};
+  const unsigned char *cmap=(invertcolors?invhashcols:hashcols);
+  
+  int boardsize=board->getSize();
+  int n=dict->getNumPoints(sz);
+  int r=dict->getRadius(sz);
+  int x=Go::Position::pos2x(pos,boardsize);
+  int y=Go::Position::pos2y(pos,boardsize);
+  const int *deltas=dict->getPosDeltas(boardsize);
+  
+  if (deltas!=NULL && x>=r && y>=r && x<boardsize-r && y<boardsize-r)
+  {
+    for (int i=0;i<n;i++)
+      cols[i]=cmap[board->getColor(pos+deltas[i])];
+  }
+  else
+  {
+    for (int i=0;i<n;i++)
+    {
+      int fx=x+dict->getXOffset(i);
+      int fy=y+dict->getYOffset(i);
+      if (fx<0 || fy<0 || fx>=boardsize || fy>=boardsize)
+        cols[i]=cmap[Go::OFFBOARD];
+      else
+        cols[i]=cmap[board->getColor(Go::Position::xy2pos(fx,fy,boardsize))];
+    }
+  }
+}
+
+void Pattern::Circular::setFromColors(Pattern::CircularDictionary *dict, const unsigned char *cols)
+{
   for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++)
   {
     hash[i]=0;
   }
   
-  int x=Go::Position::pos2x(pos,board->getSize());
-  int y=Go::Position::pos2y(pos,board->getSize());
-  int base=0;
+  int n=dict->getNumPoints(size);
+  for (int i=0;i<n;i++)
+    hash[i/16]|=((boost::uint32_t)cols[i])<<(32-(i%16)*2-2);
+}
+
+void Pattern::Circular::setSmallestFromColors(Pattern::CircularDictionary *dict, const unsigned char *cols)
+{
+  for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++)
+  {
+    hash[i]=0;
+  }
+  
+  //build the symmetries part by part, dropping those that are already larger
+  int n=dict->getNumPoints(size);
+  int candidates[PATTERN_CIRC_SYMMETRIES];
+  int numcandidates=PATTERN_CIRC_SYMMETRIES;
+  for (int s=0;s<PATTERN_CIRC_SYMMETRIES;s++)
+    candidates[s]=s;
   
-  for (int d=2;d<=size;d++)
+  for (int part=0;part*16<n;part++)
   {
-    std::list<int> *xoffsets=dict->getXOffsetsForSize(d);
-    std::list<int> *yoffsets=dict->getYOffsetsForSize(d);
-    std::list<int>::iterator iterx=xoffsets->begin();
-    std::list<int>::iterator itery=yoffsets->begin();
-    while(iterx!=xoffsets->end() && itery!=yoffsets->end())
+    int start=part*16;
+    int end=(n<start+16?n:start+16);
+    boost::uint32_t words[PATTERN_CIRC_SYMMETRIES];
+    boost::uint32_t smallest=0xffffffff;
+    for (int c=0;c<numcandidates;c++)
     {
-      int fx=x+(*iterx);
-      int fy=y+(*itery);
-      Go::Color col;
-      
-      if (fx<0 || fy<0 || fx>=board->getSize() || fy>=board->getSize())
-        col=Go::OFFBOARD;
-      else
-        col=board->getColor(Go::Position::xy2pos(fx,fy,board->getSize()));
-      
-      this->initColor(base,col);
-      
-      ++iterx;
-      ++itery;
-      base++;
+      const int *sym=dict->getSymmetry(candidates[c]);
+      boost::uint32_t w=0;
+      for (int i=start;i<end;i++)
+        w|=((boost::uint32_t)cols[sym[i]])<<(32-(i-start)*2-2);
+      words[c]=w;
+      if (w<smallest)
+        smallest=w;
     }
+    
+    int kept=0;
+    for (int c=0;c<numcandidates;c++)
+    {
+      if (words[c]==smallest)
+        candidates[kept++]=candidates[c];
+    }
+    numcandidates=kept;
+    hash[part]=smallest;
   }
 }
 
@@ -637,26 +797,33 @@ Pattern::Circular Pattern::Circular::getSubPattern(Pattern::CircularDictionary *
   if (newsize>size)
     s=size;
   Pattern::Circular newpatt(s);
-  
-  for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++)
-  {
-    newpatt.hash[i]=hash[i];
-  }
+  newpatt.ldict=dict;
   
   if (s==PATTERN_CIRC_MAXSIZE)
+  {
+    for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++)
+      newpatt.hash[i]=hash[i];
     return newpatt;
+  }
   
+  //keep the first l points, clear the rest
   int l=dict->getBaseOffset(s+1);
-  //fprintf(stderr,"l: %d\n",l);
-  for (int i=l;i<PATTERN_CIRC_32BITPARTS*(32/2);i++)
+  int full=l/(32/2);
+  int rest=l%(32/2);
+  for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++)
   {
-    newpatt.resetColor(i);
+    if (i<full)
+      newpatt.hash[i]=hash[i];
+    else if (i==full && rest>0)
+      newpatt.hash[i]=hash[i]&~((((boost::uint32_t)1)<<(32-rest*2))-1);
+    else
+      newpatt.hash[i]=0;
   }
   
   return newpatt;
 }
 
-bool Pattern::Circular::operator==(const Pattern::Circular other) const
+bool Pattern::Circular::operator==(const Pattern::Circular &other) const
 {
   if (size!=other.size)
     return false;
@@ -669,7 +836,7 @@ bool Pattern::Circular::operator==(const Pattern::Circular other) const
   return true;
 }
 
-bool Pattern::Circular::operator<(const Pattern::Circular other) const
+bool Pattern::Circular::operator<(const Pattern::Circular &other) const
 {
   if (size<other.size)
     return true;
@@ -758,40 +925,531 @@ void Pattern::Circular::flipHorizontal(Pattern::CircularDictionary *dict)
 
 void Pattern::Circular::convertToSmallestEquivalent(Pattern::CircularDictionary *dict)
 {
-  Pattern::Circular alternative=this->copy();
+  unsigned char cols[PATTERN_CIRC_MAXPOINTS];
+  int n=dict->getNumPoints(size);
+  for (int i=0;i<n;i++)
+    cols[i]=(hash[i/16]>>(32-(i%16)*2-2))&3;
+  
+  this->setSmallestFromColors(dict,cols);
+}
+
+
+namespace
+{
+  struct CircularDatabaseHeader
+  {
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t byteorder;
+    boost::uint32_t kind;
+    boost::uint32_t patternsize;
+    boost::uint32_t parts;
+    boost::uint32_t reserved;
+    boost::uint64_t count;
+    double total;
+  };
+  
+  const boost::uint32_t CIRCULAR_DATABASE_BYTEORDER=0x01020304;
+  const unsigned long CIRCULAR_DATABASE_KEYWORDS=1+PATTERN_CIRC_32BITPARTS;
   
-  //fprintf(stderr,"comparing: %s\n",this->toString(dict).c_str());
+  //the values start at the first multiple of 8 bytes after the keys
+  unsigned long circularDatabaseValuesOffset(unsigned long count)
+  {
+    unsigned long offset=sizeof(CircularDatabaseHeader)+count*CIRCULAR_DATABASE_KEYWORDS*sizeof(boost::uint32_t);
+    return (offset+7)&~7UL;
+  }
   
-  for (int x=0;x<4;x++)
+  //keys compare by size and then the hash, as Pattern::Circular::operator<() does
+  int compareCircularKey(const boost::uint32_t *key, const Pattern::Circular &pc)
   {
-    if (alternative<this)
+    boost::uint32_t size=(boost::uint32_t)pc.getSize();
+    if (key[0]!=size)
+      return (key[0]<size?-1:1);
+    const boost::uint32_t *hash=pc.getHash();
+    for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++)
     {
-      //fprintf(stderr,"found: %s\n",alternative.toString(dict).c_str());
-      for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++)
-      {
-        hash[i]=alternative.hash[i];
-      }
+      if (key[1+i]!=hash[i])
+        return (key[1+i]<hash[i]?-1:1);
     }
-    //else
-    //  fprintf(stderr,"missed: %s\n",alternative.toString(dict).c_str());
-    alternative.rotateRight(dict);
+    return 0;
   }
   
-  alternative.flipHorizontal(dict);
+  //patterns can't be assigned, so the entries are sorted through their indices
+  class CircularEntryOrder
+  {
+    public:
+      CircularEntryOrder(const std::vector< std::pair<Pattern::Circular,double> > &e) : entries(e) {};
+      bool operator()(unsigned long a, unsigned long b) const { return (entries[a].first<entries[b].first); };
+    
+    private:
+      const std::vector< std::pair<Pattern::Circular,double> > &entries;
+  };
+}
+
+Pattern::CircularDatabase::CircularDatabase(boost::interprocess::mapped_region *r)
+  : region(r)
+{
+  const CircularDatabaseHeader *header=(const CircularDatabaseHeader *)region->get_address();
+  kind=(Pattern::CircularDatabase::Kind)header->kind;
+  patternsize=header->patternsize;
+  total=header->total;
+  count=header->count;
+  keys=(const boost::uint32_t *)((const char *)region->get_address()+sizeof(CircularDatabaseHeader));
+  values=(const double *)((const char *)region->get_address()+circularDatabaseValuesOffset(count));
+  text=NULL;
+  textlength=0;
+  if (kind==GAMMAS)
+  {
+    const char *textstart=(const char *)(values+count);
+    textlength=*(const boost::uint64_t *)textstart;
+    text=textstart+sizeof(boost::uint64_t);
+  }
+}
+
+Pattern::CircularDatabase::~CircularDatabase()
+{
+  delete region;
+}
+
+bool Pattern::CircularDatabase::isDatabaseFile(std::string filename)
+{
+  std::ifstream fin(filename.c_str(),std::ios::in|std::ios::binary);
+  if (!fin)
+    return false;
+  
+  char magic[8];
+  fin.read(magic,8);
+  return (fin && memcmp(magic,PATTERN_CIRC_DATABASE_MAGIC,8)==0);
+}
+
+Pattern::CircularDatabase *Pattern::CircularDatabase::open(std::string filename)
+{
+  boost::interprocess::mapped_region *region;
+  try
+  {
+    boost::interprocess::file_mapping file(filename.c_str(),boost::interprocess::read_only);
+    region=new boost::interprocess::mapped_region(file,boost::interprocess::read_only);
+  }
+  catch (boost::interprocess::interprocess_exception &e)
+  {
+    fprintf(stderr,"error mapping circular pattern database: %s (%s)\n",filename.c_str(),e.what());
+    return NULL;
+  }
+  
+  const CircularDatabaseHeader *header=(const CircularDatabaseHeader *)region->get_address();
+  bool valid=(region->get_size()>=sizeof(CircularDatabaseHeader));
+  if (valid)
+    valid=(memcmp(header->magic,PATTERN_CIRC_DATABASE_MAGIC,8)==0 && header->version==PATTERN_CIRC_DATABASE_VERSION && header->byteorder==CIRCULAR_DATABASE_BYTEORDER);
+  if (valid)
+    valid=(header->parts==PATTERN_CIRC_32BITPARTS && (header->kind==COUNTS || header->kind==VALUES || header->kind==GAMMAS));
+  if (valid)
+    valid=(region->get_size()>=circularDatabaseValuesOffset(header->count)+header->count*sizeof(double));
+  if (valid && header->kind==GAMMAS)
+  {
+    //the text is preceded by its length
+    unsigned long textoffset=circularDatabaseValuesOffset(header->count)+header->count*sizeof(double);
+    valid=(region->get_size()>=textoffset+sizeof(boost::uint64_t));
+    if (valid)
+      valid=(region->get_size()-textoffset-sizeof(boost::uint64_t)>=*(const boost::uint64_t *)((const char *)region->get_address()+textoffset));
+  }
+  
+  if (!valid)
+  {
+    fprintf(stderr,"invalid circular pattern database: %s\n",filename.c_str());
+    delete region;
+    return NULL;
+  }
+  
+  return new Pattern::CircularDatabase(region);
+}
+
+bool Pattern::CircularDatabase::write(std::string filename, Pattern::CircularDatabase::Kind kind, int patternsize, double total, const std::vector< std::pair<Pattern::Circular,double> > &entries, std::string text)
+{
+  std::ofstream fout(filename.c_str(),std::ios::out|std::ios::binary);
+  if (!fout)
+    return false;
+  
+  std::vector<unsigned long> order(entries.size());
+  for (unsigned long i=0;i<entries.size();i++)
+    order[i]=i;
+  std::sort(order.begin(),order.end(),CircularEntryOrder(entries));
+  
+  CircularDatabaseHeader header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,PATTERN_CIRC_DATABASE_MAGIC,8);
+  header.version=PATTERN_CIRC_DATABASE_VERSION;
+  header.byteorder=CIRCULAR_DATABASE_BYTEORDER;
+  header.kind=kind;
+  header.patternsize=patternsize;
+  header.parts=PATTERN_CIRC_32BITPARTS;
+  header.count=entries.size();
+  header.total=total;
+  fout.write((const char *)&header,sizeof(header));
+  
+  for (unsigned long i=0;i<entries.size();i++)
+  {
+    const Pattern::Circular &pc=entries[order[i]].first;
+    boost::uint32_t size=pc.getSize();
+    fout.write((const char *)&size,sizeof(size));
+    fout.write((const char *)pc.getHash(),PATTERN_CIRC_32BITPARTS*sizeof(boost::uint32_t));
+  }
+  
+  unsigned long padding=circularDatabaseValuesOffset(entries.size())-sizeof(header)-entries.size()*CIRCULAR_DATABASE_KEYWORDS*sizeof(boost::uint32_t);
+  const char zeros[8]={0,0,0,0,0,0,0,0};
+  fout.write(zeros,padding);
+  
+  for (unsigned long i=0;i<entries.size();i++)
+    fout.write((const char *)&(entries[order[i]].second),sizeof(double));
+  
+  if (kind==GAMMAS)
+  {
+    boost::uint64_t textlength=text.length();
+    fout.write((const char *)&textlength,sizeof(textlength));
+    fout.write(text.data(),text.length());
+  }
+  
+  fout.close();
+  return !fout.fail();
+}
+
+Pattern::Circular Pattern::CircularDatabase::getPattern(unsigned long i) const
+{
+  const boost::uint32_t *key=keys+i*CIRCULAR_DATABASE_KEYWORDS;
+  return Pattern::Circular((boost::uint32_t *)(key+1),(int)key[0]);
+}
+
+bool Pattern::CircularDatabase::find(const Pattern::Circular &pc, double &value) const
+{
+  unsigned long lo=0;
+  unsigned long hi=count;
+  while (lo<hi)
+  {
+    unsigned long mid=lo+(hi-lo)/2;
+    int c=compareCircularKey(keys+mid*CIRCULAR_DATABASE_KEYWORDS,pc);
+    if (c==0)
+    {
+      value=values[mid];
+      return true;
+    }
+    else if (c<0)
+      lo=mid+1;
+    else
+      hi=mid;
+  }
+  return false;
+}
+
+
+const Pattern::Local::Table Pattern::Local::table;
+
+Pattern::Local::Table::Table()
+{
+  boost::uint64_t seed=0x4f616b666f616d00ULL;
   
-  for (int x=0;x<4;x++)
+  for (int s=0;s<PATTERN_LOCAL_SHAPES;s++)
   {
-    if (alternative<this)
+    int i=0;
+    for (int dy=-3;dy<=3;dy++)
+    {
+      for (int dx=-3;dx<=3;dx++)
+      {
+        bool inshape;
+        if (s==Pattern::Local::SQUARE5X5)
+          inshape=(abs(dx)<=2 && abs(dy)<=2);
+        else
+          inshape=((abs(dx)+abs(dy))<=3);
+        if (inshape && (dx!=0 || dy!=0))
+        {
+          offsetx[s][i]=dx;
+          offsety[s][i]=dy;
+          i++;
+        }
+      }
+    }
+    
+    //the keys of each shape come from their own part of the splitmix64 sequence, with one extra key for the shape itself
+    for (int k=0;k<=PATTERN_LOCAL_POINTS*3;k++)
+    {
+      boost::uint64_t z=(seed+=0x9e3779b97f4a7c15ULL);
+      z=(z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+      z=(z^(z>>27))*0x94d049bb133111ebULL;
+      z=z^(z>>31);
+      if (k==PATTERN_LOCAL_POINTS*3)
+        shapekeys[s]=z;
+      else
+      {
+        keys[s][k/3][Go::EMPTY]=0;
+        keys[s][k/3][Go::BLACK+k%3]=z;
+      }
+    }
+    
+    for (int sym=0;sym<PATTERN_LOCAL_SYMMETRIES;sym++)
     {
-      //fprintf(stderr,"found: %s\n",alternative.toString(dict).c_str());
-      for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++)
+      for (int i=0;i<PATTERN_LOCAL_POINTS;i++)
       {
-        hash[i]=alternative.hash[i];
+        int x=((sym&1)?-offsetx[s][i]:offsetx[s][i]);
+        int y=((sym&2)?-offsety[s][i]:offsety[s][i]);
+        if (sym&4)
+        {
+          int t=x;
+          x=y;
+          y=t;
+        }
+        for (int j=0;j<PATTERN_LOCAL_POINTS;j++)
+        {
+          if (offsetx[s][j]==x && offsety[s][j]==y)
+            symmetries[s][sym][i]=j;
+        }
       }
     }
-    //else
-    //  fprintf(stderr,"missed: %s\n",alternative.toString(dict).c_str());
-    alternative.rotateRight(dict);
   }
 }
 
+void Pattern::Local::readColors(Pattern::Local::Shape shape, const Go::Board *board, int pos, Go::Color *colors)
+{
+  int size=board->getSize();
+  int x=Go::Position::pos2x(pos,size);
+  int y=Go::Position::pos2y(pos,size);
+  
+  for (int i=0;i<PATTERN_LOCAL_POINTS;i++)
+  {
+    int px=x+table.offsetx[shape][i];
+    int py=y+table.offsety[shape][i];
+    if (px>=0 && py>=0 && px<size && py<size)
+      colors[i]=board->getColor(Go::Position::xy2pos(px,py,size));
+    else
+      colors[i]=Go::OFFBOARD;
+  }
+}
+
+Go::ZobristHash Pattern::Local::makeHash(Pattern::Local::Shape shape, const Go::Color *colors)
+{
+  Go::ZobristHash hash=table.shapekeys[shape];
+  for (int i=0;i<PATTERN_LOCAL_POINTS;i++)
+    hash^=table.keys[shape][i][colors[i]];
+  return hash;
+}
+
+Go::ZobristHash Pattern::Local::makeHash(Pattern::Local::Shape shape, const Go::Board *board, int pos)
+{
+  Go::Color colors[PATTERN_LOCAL_POINTS];
+  Pattern::Local::readColors(shape,board,pos,colors);
+  return Pattern::Local::makeHash(shape,colors);
+}
+
+std::string Pattern::Local::toString(const Go::Color *colors)
+{
+  std::string str(PATTERN_LOCAL_POINTS,'.');
+  for (int i=0;i<PATTERN_LOCAL_POINTS;i++)
+  {
+    if (colors[i]==Go::BLACK)
+      str[i]='X';
+    else if (colors[i]==Go::WHITE)
+      str[i]='O';
+    else if (colors[i]==Go::OFFBOARD)
+      str[i]='#';
+  }
+  return str;
+}
+
+bool Pattern::Local::fromString(std::string str, Go::Color *colors)
+{
+  if (str.length()!=PATTERN_LOCAL_POINTS)
+    return false;
+  
+  for (int i=0;i<PATTERN_LOCAL_POINTS;i++)
+  {
+    switch (str[i])
+    {
+      case '.':
+        colors[i]=Go::EMPTY;
+        break;
+      case 'X':
+      case 'x':
+        colors[i]=Go::BLACK;
+        break;
+      case 'O':
+      case 'o':
+        colors[i]=Go::WHITE;
+        break;
+      case '#':
+        colors[i]=Go::OFFBOARD;
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+std::string Pattern::Local::getShapeName(Pattern::Local::Shape shape)
+{
+  if (shape==Pattern::Local::SQUARE5X5)
+    return "pattern5x5";
+  else
+    return "patterndiamond";
+}
+
+bool Pattern::Local::getShapeFromName(std::string name, Pattern::Local::Shape &shape)
+{
+  if (name=="pattern5x5")
+    shape=Pattern::Local::SQUARE5X5;
+  else if (name=="patterndiamond")
+    shape=Pattern::Local::DIAMOND;
+  else
+    return false;
+  return true;
+}
+
+Pattern::LocalHashes::LocalHashes(int sz)
+  : size(sz),
+    sizedata(1+(sz+1)*(sz+2)),
+    hashes(new Go::ZobristHash[PATTERN_LOCAL_SHAPES*sizedata])
+{
+  for (int i=0;i<PATTERN_LOCAL_SHAPES*sizedata;i++)
+    hashes[i]=0;
+}
+
+Pattern::LocalHashes::~LocalHashes()
+{
+  delete[] hashes;
+}
+
+void Pattern::LocalHashes::refresh(const Go::Board *board)
+{
+  for (int s=0;s<PATTERN_LOCAL_SHAPES;s++)
+  {
+    for (int p=0;p<sizedata;p++)
+    {
+      if (board->onBoard(p))
+        hashes[s*sizedata+p]=Pattern::Local::makeHash((Pattern::Local::Shape)s,board,p);
+      else
+        hashes[s*sizedata+p]=0;
+    }
+  }
+}
+
+void Pattern::LocalHashes::update(int pos, Go::Color oldcol, Go::Color newcol)
+{
+  int x=Go::Position::pos2x(pos,size);
+  int y=Go::Position::pos2y(pos,size);
+  
+  //the position is point i of the pattern centred at its offset reversed
+  for (int s=0;s<PATTERN_LOCAL_SHAPES;s++)
+  {
+    Pattern::Local::Shape shape=(Pattern::Local::Shape)s;
+    for (int i=0;i<PATTERN_LOCAL_POINTS;i++)
+    {
+      int cx=x-Pattern::Local::getXOffset(shape,i);
+      int cy=y-Pattern::Local::getYOffset(shape,i);
+      if (cx>=0 && cy>=0 && cx<size && cy<size)
+        hashes[s*sizedata+Go::Position::xy2pos(cx,cy,size)]^=Pattern::Local::getKey(shape,i,oldcol)^Pattern::Local::getKey(shape,i,newcol);
+    }
+  }
+}
+
+void Pattern::LocalHashes::markAffected(int pos, Go::BitBoard *changes) const
+{
+  int x=Go::Position::pos2x(pos,size);
+  int y=Go::Position::pos2y(pos,size);
+  
+  for (int s=0;s<PATTERN_LOCAL_SHAPES;s++)
+  {
+    Pattern::Local::Shape shape=(Pattern::Local::Shape)s;
+    for (int i=0;i<PATTERN_LOCAL_POINTS;i++)
+    {
+      int cx=x-Pattern::Local::getXOffset(shape,i);
+      int cy=y-Pattern::Local::getYOffset(shape,i);
+      if (cx>=0 && cy>=0 && cx<size && cy<size)
+        changes->set(Go::Position::xy2pos(cx,cy,size));
+    }
+  }
+}
+
+Pattern::LocalGammaTable::LocalGammaTable()
+{
+  entries=NULL;
+  count=0;
+  this->resize(PATTERN_LOCAL_TABLE_INITSIZE);
+}
+
+Pattern::LocalGammaTable::~LocalGammaTable()
+{
+  free(entries);
+}
+
+void Pattern::LocalGammaTable::resize(unsigned int newsize)
+{
+  Pattern::LocalGammaTable::Entry *oldentries=entries;
+  unsigned int oldsize=(oldentries!=NULL?mask+1:0);
+  
+  entries=(Pattern::LocalGammaTable::Entry *)malloc(sizeof(Pattern::LocalGammaTable::Entry)*newsize);
+  for (unsigned int i=0;i<newsize;i++)
+  {
+    entries[i].key=0;
+    entries[i].gamma=0;
+  }
+  mask=newsize-1;
+  count=0;
+  
+  for (unsigned int i=0;i<oldsize;i++)
+  {
+    if (oldentries[i].gamma!=0)
+      this->set(oldentries[i].key,oldentries[i].gamma);
+  }
+  if (oldentries!=NULL)
+    free(oldentries);
+}
+
+void Pattern::LocalGammaTable::set(Go::ZobristHash key, float gamma)
+{
+  //keep the table at most half full, so that probes stay short
+  if ((count+1)*2>(mask+1))
+    this->resize((mask+1)*2);
+  
+  for (unsigned int i=(unsigned int)key&mask;;i=(i+1)&mask)
+  {
+    if (entries[i].gamma==0)
+    {
+      entries[i].key=key;
+      entries[i].gamma=gamma;
+      count++;
+      return;
+    }
+    else if (entries[i].key==key)
+    {
+      entries[i].gamma=gamma;
+      return;
+    }
+  }
+}
+
+void Pattern::LocalGammaTable::setGamma(Pattern::Local::Shape shape, const Go::Color *colors, float gamma)
+{
+  //an empty entry is marked by a zero gamma
+  if (gamma<=0)
+    gamma=0.0001;
+  
+  for (int sym=0;sym<PATTERN_LOCAL_SYMMETRIES;sym++)
+  {
+    Go::Color transformed[PATTERN_LOCAL_POINTS];
+    Go::Color inverted[PATTERN_LOCAL_POINTS];
+    for (int i=0;i<PATTERN_LOCAL_POINTS;i++)
+    {
+      int j=Pattern::Local::getSymmetry(shape,sym,i);
+      transformed[j]=colors[i];
+      inverted[j]=(colors[i]==Go::BLACK || colors[i]==Go::WHITE?Go::otherColor(colors[i]):colors[i]);
+    }
+    this->set(Pattern::LocalGammaTable::makeKey(Go::BLACK,Pattern::Local::makeHash(shape,transformed)),gamma);
+    this->set(Pattern::LocalGammaTable::makeKey(Go::WHITE,Pattern::Local::makeHash(shape,inverted)),gamma);
+  }
+}
+
+bool Pattern::LocalGammaTable::setGamma(Pattern::Local::Shape shape, std::string str, float gamma)
+{
+  Go::Color colors[PATTERN_LOCAL_POINTS];
+  if (!Pattern::Local::fromString(str,colors))
+    return false;
+  this->setGamma(shape,colors,gamma);
+  return true;
+}
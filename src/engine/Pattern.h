@@ -13,6 +13,16 @@
 
 #define PATTERN_CIRC_MAXSIZE 15
 #define PATTERN_CIRC_32BITPARTS 10
+#define PATTERN_CIRC_MAXPOINTS (PATTERN_CIRC_32BITPARTS*16)
+#define PATTERN_CIRC_SYMMETRIES 8
+#define PATTERN_CIRC_MAXBOARDSIZE 25
+#define PATTERN_CIRC_DATABASE_MAGIC "OAKFCDB"
+#define PATTERN_CIRC_DATABASE_VERSION 1
+
+#define PATTERN_LOCAL_SHAPES 2
+#define PATTERN_LOCAL_POINTS 24
+#define PATTERN_LOCAL_SYMMETRIES 8
+#define PATTERN_LOCAL_TABLE_INITSIZE 1024
 
 #define PATTERN_3x3_DEFAULTS " \
 +*BWBEE??? \
@@ -32,8 +42,17 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <boost/cstdint.hpp>
 #include "Go.h"
+//from <boost/interprocess/mapped_region.hpp>:
+namespace boost
+{
+  namespace interprocess
+  {
+    class mapped_region;
+  };
+};
 
 /** Patterns.
  * Matching and manipulation of patterns.
@@ -75,7 +94,7 @@ namespace Pattern
       /** Invert a hash.
        * Make black stones white and vica versa.
        */
-      static unsigned int invert(unsigned int hash);
+      static unsigned int invert(unsigned int hash) { return (((hash&0xAAAA)>>1) | ((hash&0x5555)<<1)); };
       /** Rotate a hash 90 degrees to the right. */
       static unsigned int rotateRight(unsigned int hash);
       /** Flip a hash horizontally. */
@@ -224,6 +243,29 @@ namespace Pattern
       unsigned int count;
   };
   
+  /** Direct lookup of 3x3 pattern gammas.
+   * Every raw hash maps to a 16-bit slot shared by all its equivalent hashes, which holds the gamma of
+   * their smallest equivalent (or 1 if there is none), so a lookup needs no canonicalisation.
+   * With white to play, the slot of the inverted hash is used.
+   */
+  class ThreeByThreeGammaTable
+  {
+    public:
+      ThreeByThreeGammaTable();
+      ~ThreeByThreeGammaTable() { free(slots); free(gammas); };
+      
+      /** Get the gamma for a raw hash, with the given colour to play. */
+      float getGamma(Go::Color col, unsigned int hash) const { return gammas[slots[col==Go::WHITE?Pattern::ThreeByThree::invert(hash):hash]]; };
+      /** Update all the entries equivalent to a smallest equivalent hash from the given gammas. */
+      void update(const Pattern::ThreeByThreeGammas *source, unsigned int hash);
+      /** Rebuild all the entries from the given gammas, as done after loading a gamma file. */
+      void updateAll(const Pattern::ThreeByThreeGammas *source);
+    
+    private:
+      boost::uint16_t *const slots;
+      float *gammas;
+  };
+  
   /** Dictionary used for circular pattern hashing. */
   class CircularDictionary
   {
@@ -260,11 +302,30 @@ namespace Pattern
       std::list<int> *getYOffsetsForSize(int size) { return &(dicty[size]); }; // XXX: no bounds checking!
       /** Get the offest in the hash for the start of data specific to the given size. */
       int getBaseOffset(int size) { return baseoffset[size]; };
+      /** Get the number of points in a pattern of the given size. */
+      int getNumPoints(int size) const { return baseoffset[size+1]; };
+      /** Get the largest x or y offset of a point in a pattern of the given size. */
+      int getRadius(int size) const { return radius[size]; };
+      /** Get the x offset of a point, in hash order. */
+      int getXOffset(int point) const { return offsetx[point]; };
+      /** Get the y offset of a point, in hash order. */
+      int getYOffset(int point) const { return offsety[point]; };
+      /** Get the position deltas of all points for a board size, or NULL if the board is too large. */
+      const int *getPosDeltas(int boardsize) const { return (boardsize<=PATTERN_CIRC_MAXBOARDSIZE?posdeltas[boardsize]:NULL); };
+      /** Get the source point of every point of a pattern under one of the symmetries.
+       * Symmetry 0 is the identity.
+       */
+      const int *getSymmetry(int sym) const { return symmetries[sym]; };
     
     private:
       std::list<int> dictx[PATTERN_CIRC_MAXSIZE+1];
       std::list<int> dicty[PATTERN_CIRC_MAXSIZE+1];
-      int baseoffset[PATTERN_CIRC_MAXSIZE+1];
+      int baseoffset[PATTERN_CIRC_MAXSIZE+2];
+      int radius[PATTERN_CIRC_MAXSIZE+1];
+      int offsetx[PATTERN_CIRC_MAXPOINTS];
+      int offsety[PATTERN_CIRC_MAXPOINTS];
+      int posdeltas[PATTERN_CIRC_MAXBOARDSIZE+1][PATTERN_CIRC_MAXPOINTS];
+      int symmetries[PATTERN_CIRC_SYMMETRIES][PATTERN_CIRC_MAXPOINTS];
       
       void setTrans(boost::uint32_t data[PATTERN_CIRC_32BITPARTS], int offset);
   };
@@ -278,6 +339,13 @@ namespace Pattern
       Circular(Pattern::CircularDictionary *dict, std::string fromString);
       Circular(boost::uint32_t hash_tmp[PATTERN_CIRC_32BITPARTS],int size_tmp):size(size_tmp) {
         memcpy(hash, hash_tmp, sizeof(boost::uint32_t)*PATTERN_CIRC_32BITPARTS);} 
+      /** Create the smallest equivalent pattern at a given board position.
+       * Equivalent to creating the pattern, optionally inverting it and calling convertToSmallestEquivalent(),
+       * but reads the board once and builds all symmetries from that.
+       * As every symmetry maps each ring of points onto itself, getSubPattern() of the result is
+       * the smallest equivalent pattern of each smaller size as well.
+       */
+      static Pattern::Circular makeSmallestEquivalent(Pattern::CircularDictionary *dict, const Go::Board *board, int pos, int sz, bool invertcolors=false);
       
       /** Get the size of this pattern. */
       int getSize() const { return size; };
@@ -298,11 +366,11 @@ namespace Pattern
       int countStones(Pattern::CircularDictionary *dict);
       
       /** Determine if two patterns are equal. */
-      bool operator==(const Pattern::Circular other) const;
+      bool operator==(const Pattern::Circular &other) const;
       /** Determine if two patterns are unequal. */
-      bool operator!=(const Pattern::Circular other) const { return !(*this == other); };
+      bool operator!=(const Pattern::Circular &other) const { return !(*this == other); };
       /** Determine if a pattern is smaller than another. */
-      bool operator<(const Pattern::Circular other) const;
+      bool operator<(const Pattern::Circular &other) const;
       /** Determine if a pattern is smaller than another. */
       bool operator<(const Pattern::Circular *other) const;
       
@@ -315,10 +383,12 @@ namespace Pattern
       void flipHorizontal(Pattern::CircularDictionary *dict);
       
       /** Compute the smallest equivalent pattern.
+       * The sub-patterns of the result are also in smallest equivalent form.
        * @see Pattern::ThreeByThree::smallestEquivalent()
        */
       void convertToSmallestEquivalent(Pattern::CircularDictionary *dict);
-      std::size_t hashf() const {size_t t=0; for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++) {t+=(2*i+1)*hash[i];}; return t+size*PATTERN_CIRC_32BITPARTS;};
+      /** Hash of the packed pattern, for use as a hash table key. */
+      std::size_t hashf() const {boost::uint64_t t=size; for (int i=0;i<PATTERN_CIRC_32BITPARTS;i++) {t=(t^hash[i])*0x9e3779b97f4a7c15ULL;}; return (std::size_t)(t^(t>>32));};
       
     private:
       Circular(int sz=0) : size(sz) {};
@@ -328,10 +398,211 @@ namespace Pattern
       
       static int hashColor(Go::Color col);
       static Go::Color hash2Color(int hash);
+      static void readColors(Pattern::CircularDictionary *dict, const Go::Board *board, int pos, int sz, bool invertcolors, unsigned char *cols);
+      void setFromColors(Pattern::CircularDictionary *dict, const unsigned char *cols);
+      void setSmallestFromColors(Pattern::CircularDictionary *dict, const unsigned char *cols);
       void initColor(int offset, Go::Color col);
       Go::Color getColor(int offset);
       void resetColor(int offset);
       Pattern::CircularDictionary *ldict; //needed for copy?!
   };
+  
+  /** Read-only database of circular patterns with a value for each, that is mapped into memory from a binary file.
+   * The file has a header, the patterns in increasing order and then their values, so lookups are
+   * binary searches on the mapped file and processes using the same file share its pages.
+   * The file is in the byte order of the machine that wrote it, files in another byte order are rejected.
+   */
+  class CircularDatabase
+  {
+    public:
+      /** Kinds of databases. */
+      enum Kind
+      {
+        /** Counts of patterns, as loaded with Features::loadCircFile(). */
+        COUNTS=1,
+        /** Values of patterns, as loaded with Features::loadCircValueFile(). */
+        VALUES=2,
+        /** Feature gammas, as loaded with Features::loadGammaFile().
+         * The patterns are the circular pattern levels, and the gammas of the other features follow the values as text.
+         */
+        GAMMAS=3
+      };
+      
+      ~CircularDatabase();
+      
+      /** Map a database file, returning NULL if it can't be read or isn't a valid database. */
+      static Pattern::CircularDatabase *open(std::string filename);
+      /** Determine if a file starts with the header of a database. */
+      static bool isDatabaseFile(std::string filename);
+      /** Write a database file of patterns and values.
+       * The entries don't need to be in order, but must all be different patterns.
+       * The text is only written for a GAMMAS database.
+       */
+      static bool write(std::string filename, Pattern::CircularDatabase::Kind kind, int patternsize, double total, const std::vector< std::pair<Pattern::Circular,double> > &entries, std::string text="");
+      
+      /** Get the kind of this database. */
+      Pattern::CircularDatabase::Kind getKind() const { return kind; };
+      /** Get the pattern size that was set when the database was written. */
+      int getPatternSize() const { return patternsize; };
+      /** Get the total that was set when the database was written. */
+      double getTotal() const { return total; };
+      /** Get the number of patterns. */
+      unsigned long getCount() const { return count; };
+      /** Get a pattern, in increasing order. */
+      Pattern::Circular getPattern(unsigned long i) const;
+      /** Get the value of a pattern, in increasing order. */
+      double getValue(unsigned long i) const { return values[i]; };
+      /** Find the value of a pattern, returning false if it isn't present. */
+      bool find(const Pattern::Circular &pc, double &value) const;
+      /** Get the text stored after the values of a GAMMAS database. */
+      std::string getText() const { return std::string(text,textlength); };
+    
+    private:
+      CircularDatabase(boost::interprocess::mapped_region *r);
+      
+      boost::interprocess::mapped_region *region;
+      Pattern::CircularDatabase::Kind kind;
+      int patternsize;
+      double total;
+      unsigned long count;
+      const boost::uint32_t *keys;
+      const double *values;
+      const char *text;
+      unsigned long textlength;
+  };
+  
+  /** Medium sized local patterns: the 5x5 square and the diamond of all points within a manhattan distance of 3.
+   * Both shapes have 24 points around the centre, which are listed row by row.
+   * Pattern hashes are Zobrist hashes: the xor of a key for the shape and a key for each stone and off-board point.
+   * As the keys are generated from a fixed seed, hashes are the same between runs.
+   * A pattern string has a character for each point: '.' empty, 'X' black, 'O' white and '#' off-board.
+   */
+  class Local
+  {
+    public:
+      enum Shape
+      {
+        SQUARE5X5,
+        DIAMOND
+      };
+      
+      /** Get the x offset of a point of a shape. */
+      static int getXOffset(Pattern::Local::Shape shape, int i) { return table.offsetx[shape][i]; };
+      /** Get the y offset of a point of a shape. */
+      static int getYOffset(Pattern::Local::Shape shape, int i) { return table.offsety[shape][i]; };
+      /** Get the key of a color at a point of a shape. */
+      static Go::ZobristHash getKey(Pattern::Local::Shape shape, int i, Go::Color col) { return table.keys[shape][i][col]; };
+      /** Get the index of the point that point @p i maps to under symmetry @p sym. */
+      static int getSymmetry(Pattern::Local::Shape shape, int sym, int i) { return table.symmetries[shape][sym][i]; };
+      
+      /** Make a hash from a board position. */
+      static Go::ZobristHash makeHash(Pattern::Local::Shape shape, const Go::Board *board, int pos);
+      /** Make a hash from the colors of the points of a shape. */
+      static Go::ZobristHash makeHash(Pattern::Local::Shape shape, const Go::Color *colors);
+      /** Read the colors of the points of a shape around a board position. */
+      static void readColors(Pattern::Local::Shape shape, const Go::Board *board, int pos, Go::Color *colors);
+      
+      /** Get the string representation of the given colors. */
+      static std::string toString(const Go::Color *colors);
+      /** Read the colors from a string representation.
+       * Returns false if the string is not a valid pattern.
+       */
+      static bool fromString(std::string str, Go::Color *colors);
+      
+      /** Get the name of a shape. */
+      static std::string getShapeName(Pattern::Local::Shape shape);
+      /** Get a shape, given its name.
+       * Returns false if there is no such shape.
+       */
+      static bool getShapeFromName(std::string name, Pattern::Local::Shape &shape);
+    
+    private:
+      struct Table
+      {
+        Table();
+        int offsetx[PATTERN_LOCAL_SHAPES][PATTERN_LOCAL_POINTS];
+        int offsety[PATTERN_LOCAL_SHAPES][PATTERN_LOCAL_POINTS];
+        int symmetries[PATTERN_LOCAL_SHAPES][PATTERN_LOCAL_SYMMETRIES][PATTERN_LOCAL_POINTS];
+        Go::ZobristHash keys[PATTERN_LOCAL_SHAPES][PATTERN_LOCAL_POINTS][4];
+        Go::ZobristHash shapekeys[PATTERN_LOCAL_SHAPES];
+      };
+      static const Pattern::Local::Table table;
+  };
+  
+  /** Local pattern hashes for every position on a board.
+   * The board keeps these up to date as stones are added and removed.
+   * @see Go::Board::setLocalPatternHashes()
+   */
+  class LocalHashes
+  {
+    public:
+      LocalHashes(int sz);
+      ~LocalHashes();
+      
+      /** Get the hash of a shape at a position. */
+      inline Go::ZobristHash getHash(Pattern::Local::Shape shape, int pos) const { return hashes[shape*sizedata+pos]; };
+      
+      /** Recompute all the hashes from a board. */
+      void refresh(const Go::Board *board);
+      /** Update the hashes around a position for a change in color. */
+      void update(int pos, Go::Color oldcol, Go::Color newcol);
+      /** Mark the positions whose hashes include the given position. */
+      void markAffected(int pos, Go::BitBoard *changes) const;
+      
+    private:
+      const int size,sizedata;
+      Go::ZobristHash *const hashes;
+  };
+  
+  /** Gamma values of local patterns.
+   * An open addressing hash table keyed by the pattern hash and color to play.
+   * Each gamma is stored under all the symmetries of its pattern, and under the inverted pattern for white,
+   * so a lookup is a single probe of the hash maintained by the board.
+   */
+  class LocalGammaTable
+  {
+    public:
+      LocalGammaTable();
+      ~LocalGammaTable();
+      
+      /** Get the gamma for a hash, with the given colour to play.
+       * Returns 1 if the pattern has no gamma.
+       */
+      float getGamma(Go::Color col, Go::ZobristHash hash) const
+      {
+        Go::ZobristHash key=Pattern::LocalGammaTable::makeKey(col,hash);
+        for (unsigned int i=(unsigned int)key&mask;;i=(i+1)&mask)
+        {
+          if (entries[i].gamma==0)
+            return 1;
+          else if (entries[i].key==key)
+            return entries[i].gamma;
+        }
+      };
+      /** Set the gamma of a pattern, given for black to play. */
+      void setGamma(Pattern::Local::Shape shape, const Go::Color *colors, float gamma);
+      /** Set the gamma of a pattern string, given for black to play.
+       * Returns false if the string is not a valid pattern.
+       */
+      bool setGamma(Pattern::Local::Shape shape, std::string str, float gamma);
+      /** Get the number of entries in the table.
+       * Zero means no local pattern has a gamma.
+       */
+      unsigned int getCount() const { return count; };
+    
+    private:
+      struct Entry
+      {
+        Go::ZobristHash key;
+        float gamma;
+      };
+      
+      Pattern::LocalGammaTable::Entry *entries;
+      unsigned int mask,count;
+      
+      static Go::ZobristHash makeKey(Go::Color col, Go::ZobristHash hash) { return (col==Go::WHITE?hash^0x9e3779b97f4a7c15ULL:hash); };
+      void set(Go::ZobristHash key, float gamma);
+      void resize(unsigned int newsize);
+  };
 };
 #endif
@@ -6,6 +6,7 @@
 #include "Pattern.h"
 #include "Random.h"
 #include "Worker.h"
+#include "Benson.h"
 
 #define LGRFCOUNT1 1
 #define LGRFCOUNT2 1
@@ -31,7 +32,9 @@ Playout::Playout(Parameters *prms) : params(prms)
   lgrf2hash=NULL;
   lgrf1count=NULL;
   lgrf2count=NULL;
+  lgrfgeneration=0;
   this->resetLGRF();
+  this->updatePolicy();
 }
 
 Playout::~Playout()
@@ -66,8 +69,12 @@ Playout::~Playout()
 
 void Playout::doPlayout(Worker::Settings *settings, Go::Board *board, float &finalscore, Tree *playouttree, std::list<Go::Move> &playoutmoves, Go::Color colfirst, Go::BitBoard *firstlist, Go::BitBoard *secondlist, Go::BitBoard *earlyfirstlist, Go::BitBoard *earlysecondlist, std::list<std::string> *movereasons)
 {
-  std::list<unsigned int> movehashes3x3;
-  std::list<unsigned long> movehashes5x5;
+  bool lgrfupdate=(params->playout_lgrf1_enabled || params->playout_lgrf2_enabled || params->playout_lgpf_enabled);
+  bool lgrfhashes=(params->playout_lgpf_enabled || params->playout_lgrf1_safe_enabled || params->playout_lgrf2_safe_enabled);
+  PlayoutLGRFBuffer::Entry *lgrfentry=settings->lgrfbuffer->getNextEntry(lgrfgeneration);
+  PlayoutScratch *scratch=settings->playoutscratch;
+  scratch->prepare(board);
+  PlayoutTrace *trace=(params->playout_trace_interval>0 && settings->trace->startPlayout(params->playout_trace_interval,params->playout_trace_size)?settings->trace:NULL);
 
   if (board->getPassesPlayed()>=2)
   {
@@ -81,14 +88,15 @@ void Playout::doPlayout(Worker::Settings *settings, Go::Board *board, float &fin
     gtpe->getOutput()->printfDebug("[playout]:");
   for(std::list<Go::Move>::iterator iter=playoutmoves.begin();iter!=playoutmoves.end();++iter)
   {
-    if (params->playout_lgpf_enabled || params->playout_lgrf1_safe_enabled || params->playout_lgrf2_safe_enabled)
+    if (lgrfhashes)
     {
-      movehashes3x3.push_back(Pattern::ThreeByThree::makeHash(board,(*iter).getPosition()));
-      if (params->playout_lgpf_enabled)
-        movehashes5x5.push_back(Pattern::FiveByFiveBorder::makeHash(board,(*iter).getPosition()));
+      lgrfentry->hashes3x3.push_back(Pattern::ThreeByThree::makeHash(board,(*iter).getPosition()));
+      lgrfentry->hashes5x5.push_back(params->playout_lgpf_enabled?Pattern::FiveByFiveBorder::makeHash(board,(*iter).getPosition()):0);
     }
     board->makeMove((*iter));
     treemovescount++;
+    if (trace!=NULL)
+      trace->addMove((*iter),Playout::STAGE_NUM+1);
     if (movereasons!=NULL)
       movereasons->push_back("given");
     if (params->debug_on)
@@ -127,15 +135,17 @@ void Playout::doPlayout(Worker::Settings *settings, Go::Board *board, float &fin
   }
 
   // setup poolRAVE and its variants
-  std::vector<int> pool;
-  std::vector<int> poolother;
-  std::vector<int> poolcrit;
+  boost::shared_ptr<const Tree::PoolRAVECache> poolcache;
+  const std::vector<int> *pool=NULL;
+  const std::vector<int> *poolcrit=NULL;
   Go::Color poolcol=Go::EMPTY;
   float *critarray=NULL;
   if (params->playout_criticality_random_n>0)
   {
     Tree *pooltree=playouttree;
-    critarray=new float[board->getPositionMax()];
+    critarray=scratch->critarray;
+    for (int i=0;i<board->getPositionMax();i++)
+      critarray[i]=0;
     if (playouttree!=NULL)
     {
       while (!pooltree->isRoot() && pooltree->getRAVEPlayouts()<params->playout_poolrave_min_playouts)
@@ -145,8 +155,6 @@ void Playout::doPlayout(Worker::Settings *settings, Go::Board *board, float &fin
     }
     if (pooltree!=NULL)
     {
-      for (int i=0;i<board->getPositionMax ();i++)
-        critarray[i]=0;
       for(std::list<Tree*>::iterator iter=pooltree->getChildren()->begin();iter!=pooltree->getChildren()->end();++iter) 
         {
           if (!(*iter)->getMove().isPass())
@@ -172,72 +180,17 @@ void Playout::doPlayout(Worker::Settings *settings, Go::Board *board, float &fin
 
     if (pooltree!=NULL)
     {
-      int k;
-      if ((int)pooltree->getChildren()->size()<params->playout_poolrave_k)
-        k=pooltree->getChildren()->size();
-      else
-        k=params->playout_poolrave_k;
-
-      // below method is simple but inefficient if log(n)<k
-      int totalused=0;
-      Go::BitBoard *used=new Go::BitBoard(board->getSize());
-      Go::BitBoard *usedother=new Go::BitBoard(board->getSize());
-      Go::BitBoard *usedcrit=new Go::BitBoard(board->getSize());
-      //fprintf(stderr,"playout\n");
-      while (totalused<k)
-      {
-        float bestval=-1; // accept any values
-        int bestpos=-1;
-        float bestvalother=-1;
-        int bestposother=-1;
-        float bestvalcrit=-1;
-        int bestposcrit=-1;
-        for(std::list<Tree*>::iterator iter=pooltree->getChildren()->begin();iter!=pooltree->getChildren()->end();++iter) 
-        {
-          if (!(*iter)->getMove().isPass() && !used->get((*iter)->getMove().getPosition()) && (*iter)->getRAVERatioForPool()>bestval)
-          {
-            bestpos=(*iter)->getMove().getPosition();
-            bestval=(*iter)->getRAVERatioForPool();
-            poolcol=(*iter)->getMove().getColor();
-          }
-          if (!(*iter)->getMove().isPass() && !usedother->get((*iter)->getMove().getPosition()) && (*iter)->getRAVERatioOtherForPool()>bestvalother)
-          {
-            bestposother=(*iter)->getMove().getPosition();
-            bestvalother=(*iter)->getRAVERatioOtherForPool();
-          }
-          if (!(*iter)->getMove().isPass() && !usedcrit->get((*iter)->getMove().getPosition()) && (*iter)->getCriticality()>bestvalcrit)
-          {
-            bestposcrit=(*iter)->getMove().getPosition();
-            bestvalcrit=(*iter)->getCriticality();
-          }
-        }
-        if (bestpos!=-1)
-        {
-          pool.push_back(bestpos);
-          used->set(bestpos);
-        }
-        if (bestposother!=-1)
-        {
-          poolother.push_back(bestposother);
-          usedother->set(bestposother);
-        }
-        if (bestposcrit!=-1)
-        {
-          poolcrit.push_back(bestposcrit);
-          usedcrit->set(bestposcrit);
-        }
-        totalused++;
-      }
-      delete used;
-      delete usedother;
-      delete usedcrit;
+      poolcache=pooltree->getPoolRAVE(params->playout_poolrave_k);
+      pool=&poolcache->pool;
+      poolcrit=&poolcache->poolcrit;
+      poolcol=poolcache->col;
     }
   }
 
   Go::Color coltomove=board->nextToMove();
   Go::Move move=Go::Move(coltomove,Go::Move::PASS);
   int movesalready=board->getMovesMade();
-  int *posarray = new int[board->getPositionMax()];
+  int *posarray=scratch->posarray;
   bool mercywin=false;
   std::string reason;
   board->resetCaptures(); // for mercy rule
@@ -252,29 +205,31 @@ void Playout::doPlayout(Worker::Settings *settings, Go::Board *board, float &fin
     bool resign;
     if (movereasons!=NULL)
     {
-      this->getPlayoutMove(settings,board,coltomove,move,posarray,critarray,(coltomove==Go::BLACK?bpasses:wpasses),(coltomove==poolcol?&pool:&poolcrit),&poolcrit,&reason,&trylocal_p);
+      this->getPlayoutMove(settings,board,coltomove,move,posarray,critarray,(coltomove==Go::BLACK?bpasses:wpasses),(coltomove==poolcol?pool:poolcrit),poolcrit,&reason,&trylocal_p);
       //fprintf(stderr,"move test %s\n",move.toString (9).c_str());
       if (params->playout_useless_move)
         this->checkUselessMove(settings,board,coltomove,move,posarray,&reason);
     }
     else
     {
-      this->getPlayoutMove(settings,board,coltomove,move,posarray,critarray,(coltomove==Go::BLACK?bpasses:wpasses),(coltomove==poolcol?&pool:&poolcrit),&poolcrit,NULL,&trylocal_p);
+      this->getPlayoutMove(settings,board,coltomove,move,posarray,critarray,(coltomove==Go::BLACK?bpasses:wpasses),(coltomove==poolcol?pool:poolcrit),poolcrit,NULL,&trylocal_p);
       //fprintf(stderr,"move test %s\n",move.toString (9).c_str());
       if (params->playout_useless_move)
         this->checkUselessMove(settings,board,coltomove,move,posarray);
     }
     
-    if ((params->playout_lgpf_enabled || params->playout_lgrf1_safe_enabled || params->playout_lgrf2_safe_enabled) && move.isNormal())
+    if (lgrfhashes)
     {
-      movehashes3x3.push_back(Pattern::ThreeByThree::makeHash(board,move.getPosition()));
-      if (params->playout_lgpf_enabled)
-        movehashes5x5.push_back(Pattern::FiveByFiveBorder::makeHash(board,move.getPosition()));
+      // keep the hashes aligned with the moves
+      lgrfentry->hashes3x3.push_back(move.isNormal()?Pattern::ThreeByThree::makeHash(board,move.getPosition()):0);
+      lgrfentry->hashes5x5.push_back(move.isNormal() && params->playout_lgpf_enabled?Pattern::FiveByFiveBorder::makeHash(board,move.getPosition()):0);
     }
     
     board->makeMove(move);
     playoutmoves.push_back(move);
     playoutmovescount++;
+    if (trace!=NULL)
+      trace->addMove(move,scratch->movestage);
     if (move.isPass())
       (coltomove==Go::BLACK)? bpasses++ : wpasses++;
     if (movereasons!=NULL)
@@ -310,205 +265,420 @@ void Playout::doPlayout(Worker::Settings *settings, Go::Board *board, float &fin
     }
     if (board->getMovesMade()>(board->getSize()*board->getSize()*PLAYOUT_MAX_MOVE_FACTOR+movesalready))
       break;
+    if (params->playout_settled_cutoff && kodelay==0 && board->getEmptyCount()<=(board->getSize()*board->getSize()*params->playout_settled_cutoff_empty))
+    {
+      if (this->isSettled(board,posarray,scratch->regionarray,scratch->benson))
+        break; // the remaining moves can't change the score
+    }
 
     if (board->isCurrentSimpleKo())
       kodelay=3;
     else if (kodelay>0)
       kodelay--;
   }
-  delete[] posarray;
-  if (critarray)
-    delete[] critarray;
   if (!mercywin)
     finalscore=board->score(params)-params->engine->getScoreKomi();
   //Go::Color playoutcol=playoutmoves.back().getColor();
   //bool playoutwin=Go::Board::isWinForColor(playoutcol,finalscore);
   bool playoutjigo=(finalscore==0);
   
+  if (lgrfupdate && !playoutjigo) // ignore jigos
+  {
+    bool blackwin=Go::Board::isWinForColor(Go::BLACK,finalscore);
+    Go::Color wincol=(blackwin?Go::BLACK:Go::WHITE);
+    
+    for(std::list<Go::Move>::iterator iter=playoutmoves.begin();iter!=playoutmoves.end();++iter)
+    {
+      Go::Color c=(*iter).getColor();
+      lgrfentry->moves.push_back((*iter));
+      if (params->playout_lgrf_local && (*iter).isNormal())
+        lgrfentry->wins.push_back(c==board->getScoredOwner((*iter).getPosition()) && (c==wincol));
+      else
+        lgrfentry->wins.push_back(c==wincol);
+    }
+    
+    settings->lgrfbuffer->commitEntry();
+    //with a single thread there is no lock to save, so the replies are merged straight away
+    if (params->thread_count==1 || settings->lgrfbuffer->getSize()>=params->playout_lgrf_merge_interval)
+      this->mergeLGRF(settings);
+  }
+}
+
+bool Playout::isSettled(Go::Board *board, int *posarray, Go::Color *regionarray, Benson *benson) const
+{
+  int size=board->getSize();
+  int emptycount=board->getEmptyCount();
+  if (emptycount==0)
+    return false;
+  
+  for (int i=0;i<emptycount;i++)
+    regionarray[board->getEmptyPosition(i)]=Go::EMPTY;
+  
+  // every empty region must be bordered by a single color
+  for (int i=0;i<emptycount;i++)
+  {
+    int p=board->getEmptyPosition(i);
+    if (regionarray[p]!=Go::EMPTY)
+      continue;
+    
+    Go::Color bordercol=Go::EMPTY;
+    int stacksize=0;
+    regionarray[p]=Go::OFFBOARD;
+    posarray[stacksize++]=p;
+    while (stacksize>0)
+    {
+      int q=posarray[--stacksize];
+      foreach_adjacent(q,r,{
+        Go::Color col=board->getColor(r);
+        if (col==Go::EMPTY)
+        {
+          if (regionarray[r]==Go::EMPTY)
+          {
+            regionarray[r]=Go::OFFBOARD;
+            posarray[stacksize++]=r;
+          }
+        }
+        else if (col!=Go::OFFBOARD)
+        {
+          if (bordercol==Go::EMPTY)
+            bordercol=col;
+          else if (bordercol!=col)
+            return false;
+        }
+      });
+    }
+    if (bordercol==Go::EMPTY)
+      return false;
+  }
+  
+  // the stones must also be pass-alive, else the region could still be invaded
+  benson->reset(board);
+  benson->solve();
+  bool settled=true;
+  for (int p=0;p<board->getPositionMax();p++)
+  {
+    if (board->onBoard(p) && benson->getSafePositions()->get(p)==Go::EMPTY)
+    {
+      settled=false;
+      break;
+    }
+  }
+  
+  return settled;
+}
+
+PlayoutScratch::~PlayoutScratch()
+{
+  if (posarray!=NULL)
+    delete[] posarray;
+  if (critarray!=NULL)
+    delete[] critarray;
+  if (regionarray!=NULL)
+    delete[] regionarray;
+  if (benson!=NULL)
+    delete benson;
+}
+
+void PlayoutScratch::prepare(Go::Board *board)
+{
+  if (board->getSize()==size && board->getPositionMax()==positionmax)
+    return;
+  
+  if (posarray!=NULL)
+    delete[] posarray;
+  if (critarray!=NULL)
+    delete[] critarray;
+  if (regionarray!=NULL)
+    delete[] regionarray;
+  if (benson!=NULL)
+    delete benson;
+  
+  size=board->getSize();
+  positionmax=board->getPositionMax();
+  posarray=new int[positionmax];
+  critarray=new float[positionmax];
+  regionarray=new Go::Color[positionmax];
+  benson=new Benson(board);
+}
+
+bool PlayoutTrace::startPlayout(int interval, int size)
+{
+  if (((calls++)%interval)!=0)
+    return false;
+  
+  if ((int)entries.size()!=size)
+  {
+    entries.resize(size);
+    this->clear();
+  }
+  playout++;
+  return (size>0);
+}
+
+void PlayoutTrace::addMove(Go::Move move, int stage)
+{
+  PlayoutTrace::Entry *entry=&entries[next];
+  entry->time=(boost::posix_time::microsec_clock::universal_time()-boost::posix_time::ptime(boost::gregorian::date(1970,1,1))).total_microseconds();
+  entry->playout=playout;
+  entry->position=move.getPosition();
+  entry->color=move.getColor();
+  entry->stage=stage;
+  
+  next++;
+  if (next>=(int)entries.size())
+    next=0;
+  if (used<(int)entries.size())
+    used++;
+}
+
+void PlayoutTrace::write(std::ostream &out) const
+{
+  boost::uint32_t count=used;
+  out.write((const char *)&count,sizeof(count));
+  int first=(used<(int)entries.size()?0:next);
+  for (int i=0;i<used;i++)
+  {
+    const PlayoutTrace::Entry *entry=&entries[(first+i)%entries.size()];
+    out.write((const char *)entry,sizeof(PlayoutTrace::Entry));
+  }
+}
+
+PlayoutLGRFBuffer::Entry *PlayoutLGRFBuffer::getNextEntry(int gen)
+{
+  if (gen!=generation)
+  {
+    used=0;
+    generation=gen;
+  }
+  if (used>=(int)entries.size())
+    entries.resize(used+1);
+  
+  PlayoutLGRFBuffer::Entry *entry=&entries[used];
+  entry->moves.clear();
+  entry->hashes3x3.clear();
+  entry->hashes5x5.clear();
+  entry->wins.clear();
+  return entry;
+}
+
+void Playout::mergeLGRF(Worker::Settings *settings)
+{
+  PlayoutLGRFBuffer *buffer=settings->lgrfbuffer;
+  boost::mutex::scoped_lock *lock=(params->thread_count>1?new boost::mutex::scoped_lock(lgrfmutex):NULL);
+  
+  if (buffer->getGeneration()==lgrfgeneration)
+  {
+    for (int i=0;i<buffer->getSize();i++)
+      this->updateLGRF(settings,buffer->getEntry(i));
+  }
+  
+  if (lock!=NULL)
+    delete lock;
+  buffer->clear();
+}
+
+void Playout::updateLGRF(Worker::Settings *settings, PlayoutLGRFBuffer::Entry *entry)
+{
+  int size=params->board_size;
+  int nummoves=entry->moves.size();
+  bool hashes=(entry->hashes3x3.size()==entry->moves.size());
+  
   if (params->playout_lgrf1_enabled)
   {
-    if (!playoutjigo) // ignore jigos
+    Go::Move move1=Go::Move(Go::EMPTY,Go::Move::PASS); // the last move
+    unsigned int poshashlast=0;
+    for (int i=0;i<nummoves;i++)
     {
-      bool blackwin=Go::Board::isWinForColor(Go::BLACK,finalscore);
-      Go::Color wincol=(blackwin?Go::BLACK:Go::WHITE);
-      
-      std::list<unsigned int>::iterator movehashiter=movehashes3x3.begin();
-      Go::Move move1=Go::Move(Go::EMPTY,Go::Move::PASS); // the last move
-      unsigned int poshashlast=0;
-      for(std::list<Go::Move>::iterator iter=playoutmoves.begin();iter!=playoutmoves.end();++iter)
+      Go::Move move=entry->moves[i];
+      if (!move.isPass() && !move1.isPass())
       {
-        if (!(*iter).isPass() && !move1.isPass())
+        Go::Color c=move.getColor();
+        int mp=move.getPosition();
+        int p1=move1.getPosition();
+        unsigned int poshash=(hashes?entry->hashes3x3[i]:0);
+        if (entry->wins[i])
         {
-          Go::Color c=(*iter).getColor();
-          int mp=(*iter).getPosition();
-          int p1=move1.getPosition();
-          unsigned int poshash=*movehashiter;
-          bool iswin;
-          if (params->playout_lgrf_local)
-            iswin=(c==board->getScoredOwner(mp) && (c==wincol));
+          if (params->debug_on)
+            fprintf(stderr,"adding LGRF1: %s %s\n",move1.toString(size).c_str(),move.toString(size).c_str());
+          if (params->playout_lgrf1_safe_enabled)
+            this->setLGRF1(c,p1,mp,poshash,poshashlast);
           else
-            iswin=(c==wincol);
-          // Below couldn't be disabled with parameter
-          // if ((*iter).is_useforlgrf ())
-          // {
-            if (iswin)
-            {
-              if (params->debug_on)
-                fprintf(stderr,"adding LGRF1: %s %s\n",move1.toString(board->getSize()).c_str(),(*iter).toString(board->getSize()).c_str());
-              if (params->playout_lgrf1_safe_enabled)
-                this->setLGRF1(c,p1,mp,poshash,poshashlast);
-              else
-                this->setLGRF1(c,p1,mp);
-              this->clearLGRF1n(c,p1,mp);
-            }
-            else
-            {
-              if (params->debug_on && this->hasLGRF1(c,p1))
-                fprintf(stderr,"forgetting LGRF1: %s %s\n",move1.toString(board->getSize()).c_str(),(*iter).toString(board->getSize()).c_str());
-              this->clearLGRF1(c,p1);
-              this->setLGRF1n(c,p1,mp);
-            }
-          // }
-          poshashlast=poshash;
+            this->setLGRF1(c,p1,mp);
+          this->clearLGRF1n(c,p1,mp);
         }
-        ++movehashiter;
-        if (!(*iter).isPass() && move1.isPass())
+        else
         {
-          Go::Color c=(*iter).getColor();
-          int mp=(*iter).getPosition();
-          //int p1=move1.getPosition();
-          bool iswin;
-          if (params->playout_lgrf_local)
-            iswin=(c==board->getScoredOwner(mp) && (c==wincol));
-          else
-            iswin=(c==wincol);
-          if (iswin)
-          {
-            //fprintf(stderr,"forgetting LGRF1n_PASS: %s %s\n",move1.toString(board->getSize()).c_str(),(*iter).toString(board->getSize()).c_str());
-            this->clearBadPassAnswer(c,mp);
-          }
-          else
-          {
-            //fprintf(stderr,"setting LGRF1n_PASS: %s %s\n",move1.toString(board->getSize()).c_str(),(*iter).toString(board->getSize()).c_str());
-            this->setBadPassAnswer(c,mp);
-          }
+          if (params->debug_on && this->hasLGRF1(c,p1))
+            fprintf(stderr,"forgetting LGRF1: %s %s\n",move1.toString(size).c_str(),move.toString(size).c_str());
+          this->clearLGRF1(c,p1);
+          this->setLGRF1n(c,p1,mp);
         }
-        move1=(*iter);
+        poshashlast=poshash;
+      }
+      if (!move.isPass() && move1.isPass())
+      {
+        Go::Color c=move.getColor();
+        int mp=move.getPosition();
+        if (entry->wins[i])
+          this->clearBadPassAnswer(c,mp);
+        else
+          this->setBadPassAnswer(c,mp);
       }
+      move1=move;
     }
   }
   
   if (params->playout_lgrf2_enabled)
   {
-    if (!playoutjigo) // ignore jigos
+    Go::Move move1=Go::Move(Go::EMPTY,Go::Move::PASS);
+    Go::Move move2=Go::Move(Go::EMPTY,Go::Move::PASS);
+    for (int i=0;i<nummoves;i++)
     {
-      bool blackwin=Go::Board::isWinForColor(Go::BLACK,finalscore);
-      Go::Color wincol=(blackwin?Go::BLACK:Go::WHITE);
-      
-      Go::Move move1=Go::Move(Go::EMPTY,Go::Move::PASS);
-      Go::Move move2=Go::Move(Go::EMPTY,Go::Move::PASS);
-      std::list<unsigned int>::iterator movehashiter=movehashes3x3.begin();
-      for(std::list<Go::Move>::iterator iter=playoutmoves.begin();iter!=playoutmoves.end();++iter)
+      Go::Move move=entry->moves[i];
+      if (!move.isPass() && !move1.isPass() && !move2.isPass())
       {
-        if (!(*iter).isPass() && !move1.isPass() && !move2.isPass())
+        Go::Color c=move.getColor();
+        int mp=move.getPosition();
+        int p1=move1.getPosition();
+        int p2=move2.getPosition();
+        unsigned int poshash=(hashes?entry->hashes3x3[i]:0);
+        if (entry->wins[i])
         {
-          Go::Color c=(*iter).getColor();
-          int mp=(*iter).getPosition();
-          int p1=move1.getPosition();
-          int p2=move2.getPosition();
-          unsigned int poshash=*movehashiter;
-          bool iswin;
-          if (params->playout_lgrf_local)
-            iswin=(c==board->getScoredOwner (mp) && (c==wincol));
+          if (params->debug_on)
+            fprintf(stderr,"adding LGRF2: %s %s %s\n",move1.toString(size).c_str(),move2.toString(size).c_str(),move.toString(size).c_str());
+          if (params->playout_lgrf2_safe_enabled)
+            this->setLGRF2(c,p1,p2,mp,poshash);
           else
-            iswin=(c==wincol);
-          // Below couldn't be disabled with parameter
-          // if ((*iter).is_useforlgrf())
-          // {
-            if (iswin)
-            {
-              if (params->debug_on)
-                fprintf(stderr,"adding LGRF2: %s %s %s\n",move1.toString(board->getSize()).c_str(),move2.toString(board->getSize()).c_str(),(*iter).toString(board->getSize()).c_str());
-              if (params->playout_lgrf2_safe_enabled)
-                this->setLGRF2(c,p1,p2,mp,poshash);
-              else
-                this->setLGRF2(c,p1,p2,mp);
-              this->setLGRF1o(c,p1,mp);
-            }
-            else
-            {
-              if (params->debug_on && this->hasLGRF2(c,p1,p2))
-                fprintf(stderr,"forgetting LGRF2: %s %s %s\n",move1.toString(board->getSize()).c_str(),move2.toString(board->getSize()).c_str(),(*iter).toString(board->getSize()).c_str());
-              this->clearLGRF2(c,p1,p2);
-              this->clearLGRF1o(c,p1);
-            }
-          // }
+            this->setLGRF2(c,p1,p2,mp);
+          this->setLGRF1o(c,p1,mp);
+        }
+        else
+        {
+          if (params->debug_on && this->hasLGRF2(c,p1,p2))
+            fprintf(stderr,"forgetting LGRF2: %s %s %s\n",move1.toString(size).c_str(),move2.toString(size).c_str(),move.toString(size).c_str());
+          this->clearLGRF2(c,p1,p2);
+          this->clearLGRF1o(c,p1);
         }
-        ++movehashiter;
-        move1=move2;
-        move2=(*iter);
       }
+      move1=move2;
+      move2=move;
     }
   }
-
-  if (params->playout_lgpf_enabled)
+  
+  if (params->playout_lgpf_enabled && hashes)
   {
-    if (!playoutjigo) // ignore jigos
+    for (int i=0;i<nummoves;i++)
     {
-      bool blackwin=Go::Board::isWinForColor(Go::BLACK,finalscore);
-      Go::Color wincol=(blackwin?Go::BLACK:Go::WHITE);
-      
-      std::list<unsigned int>::iterator movehashiter=movehashes3x3.begin();
-      std::list<unsigned long>::iterator movehashiter2=movehashes5x5.begin();
-      for(std::list<Go::Move>::iterator iter=playoutmoves.begin();iter!=playoutmoves.end();++iter)
+      Go::Move move=entry->moves[i];
+      if (!move.isPass())
       {
-        if (!(*iter).isPass())
+        Go::Color c=move.getColor();
+        int mp=move.getPosition();
+        unsigned int p1=entry->hashes3x3[i];
+        unsigned long p1_b=entry->hashes5x5[i];
+        if (entry->wins[i])
         {
-          Go::Color c=(*iter).getColor();
-          int mp=(*iter).getPosition();
-          unsigned int p1=*movehashiter;
-          unsigned long p1_b=*movehashiter2;
-          bool iswin;
-          if (params->playout_lgrf_local)
-            iswin=(c==board->getScoredOwner(mp) && (c==wincol));
-          else
-            iswin=(c==wincol);
-          if (iswin)
-          {
-            if (params->debug_on)
-              fprintf(stderr,"adding LGRP: %s %x\n",(*iter).toString(board->getSize()).c_str(),p1);
-            this->setLGPF(settings,c,mp,p1,p1_b);
-          }
-          else
-          {
-            this->clearLGPF(c,mp,p1,p1_b);
-            if (params->debug_on && this->hasLGPF(c,mp,p1,p1_b))
-              fprintf(stderr,"forgetting LGRP: %s %x\n",(*iter).toString(board->getSize()).c_str(),p1);
-          }
+          if (params->debug_on)
+            fprintf(stderr,"adding LGRP: %s %x\n",move.toString(size).c_str(),p1);
+          this->setLGPF(settings,c,mp,p1,p1_b);
+        }
+        else
+        {
+          this->clearLGPF(c,mp,p1,p1_b);
+          if (params->debug_on && this->hasLGPF(c,mp,p1,p1_b))
+            fprintf(stderr,"forgetting LGRP: %s %x\n",move.toString(size).c_str(),p1);
         }
-        ++movehashiter;
-        ++movehashiter2;
       }
     }
   }
 }
 
-void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, float critarray[], int passes, std::vector<int> *pool, std::vector<int> *poolCR, std::string *reason, float *trylocal_p)
+void Playout::updatePolicy()
 {
-  int *posarray = new int[board->getPositionMax()];
-  
-  this->getPlayoutMove(settings,board,col,move,posarray,critarray,passes,pool,poolCR,reason,trylocal_p);
+  policysize=0;
   
-  delete[] posarray;
+  if (params->playout_order==1 && params->playout_lastcapture_enabled)
+    policy[policysize++]=Playout::STAGE_LASTCAPTURE_FIRST;
+  if (params->playout_lgrf2_enabled)
+    policy[policysize++]=(params->playout_lgrf2_safe_enabled?Playout::STAGE_LGRF2_SAFE:Playout::STAGE_LGRF2);
+  if (params->playout_lgrf1_enabled)
+    policy[policysize++]=(params->playout_lgrf1_safe_enabled?Playout::STAGE_LGRF1_SAFE:Playout::STAGE_LGRF1);
+  if (params->playout_atari_enabled)
+    policy[policysize++]=Playout::STAGE_ATARI;
+  if (params->playout_lastatari_p>0.0)
+    policy[policysize++]=Playout::STAGE_LASTATARI;
+  if ((params->playout_order==0 || params->playout_order>3) && params->playout_lastcapture_enabled)
+    policy[policysize++]=Playout::STAGE_LASTCAPTURE;
+  if (params->playout_last2libatari_enabled)
+    policy[policysize++]=Playout::STAGE_LAST2LIBATARI;
+  if (params->playout_order==2 && params->playout_lastcapture_enabled)
+    policy[policysize++]=Playout::STAGE_LASTCAPTURE_LATE;
+  if (params->playout_nakade_enabled)
+    policy[policysize++]=Playout::STAGE_NAKADE;
+  if (params->playout_nearby_enabled)
+    policy[policysize++]=Playout::STAGE_NEARBY;
+  if (params->playout_order!=4 && params->playout_fillboard_enabled)
+    policy[policysize++]=Playout::STAGE_FILLBOARD;
+  if (params->playout_patterns_p>0)
+    policy[policysize++]=Playout::STAGE_PATTERN;
+  if (params->playout_anycapture_p>0)
+    policy[policysize++]=Playout::STAGE_ANYCAPTURE;
+  if (params->playout_circpattern_n>0)
+    policy[policysize++]=Playout::STAGE_CIRCPATTERN;
+  if (params->playout_poolrave_enabled)
+    policy[policysize++]=Playout::STAGE_POOLRAVE;
+  if (params->playout_poolrave_criticality)
+    policy[policysize++]=Playout::STAGE_POOLCRITICALITY;
+  if (params->playout_lgrf1o_enabled)
+    policy[policysize++]=Playout::STAGE_LGRF1O;
+  if (params->playout_lgpf_enabled)
+    policy[policysize++]=Playout::STAGE_LGPF;
+  if (params->playout_order==4 && params->playout_fillboard_enabled)
+    policy[policysize++]=Playout::STAGE_FILLBOARD_LATE;
+  if (params->playout_features_enabled)
+    policy[policysize++]=Playout::STAGE_FEATURES;
+}
+
+std::string Playout::getPolicyStageName(Playout::PolicyStage stage)
+{
+  switch (stage)
+  {
+    case Playout::STAGE_LASTCAPTURE_FIRST: return "lastcapture(first)";
+    case Playout::STAGE_LGRF2_SAFE: return "safe lgrf2";
+    case Playout::STAGE_LGRF2: return "lgrf2";
+    case Playout::STAGE_LGRF1_SAFE: return "safe lgrf1";
+    case Playout::STAGE_LGRF1: return "lgrf1";
+    case Playout::STAGE_ATARI: return "atari";
+    case Playout::STAGE_LASTATARI: return "lastatari";
+    case Playout::STAGE_LASTCAPTURE: return "lastcapture";
+    case Playout::STAGE_LAST2LIBATARI: return "last2libatari";
+    case Playout::STAGE_LASTCAPTURE_LATE: return "lastcapture(late)";
+    case Playout::STAGE_NAKADE: return "nakade";
+    case Playout::STAGE_NEARBY: return "nearby";
+    case Playout::STAGE_FILLBOARD: return "fillboard";
+    case Playout::STAGE_PATTERN: return "pattern";
+    case Playout::STAGE_ANYCAPTURE: return "anycapture";
+    case Playout::STAGE_CIRCPATTERN: return "circpattern";
+    case Playout::STAGE_POOLRAVE: return "poolrave";
+    case Playout::STAGE_POOLCRITICALITY: return "poolcriticality";
+    case Playout::STAGE_LGRF1O: return "lgrf1o";
+    case Playout::STAGE_LGPF: return "lgpf";
+    case Playout::STAGE_FILLBOARD_LATE: return "fillboard(late)";
+    case Playout::STAGE_FEATURES: return "features";
+    default: return "unknown";
+  }
+}
+
+void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, float critarray[], int passes, const std::vector<int> *pool, const std::vector<int> *poolCR, std::string *reason, float *trylocal_p)
+{
+  settings->playoutscratch->prepare(board);
+  this->getPlayoutMove(settings,board,col,move,settings->playoutscratch->posarray,critarray,passes,pool,poolCR,reason,trylocal_p);
 }
 
 void Playout::checkUselessMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, std::string *reason)
 {
-  int *posarray = new int[board->getPositionMax()];
-  
-  this->checkUselessMove(settings,board,col,move,posarray,reason);
-  
-  delete[] posarray;
+  settings->playoutscratch->prepare(board);
+  this->checkUselessMove(settings,board,col,move,settings->playoutscratch->posarray,reason);
 }
 
 
@@ -529,7 +699,7 @@ void Playout::checkUselessMove(Worker::Settings *settings, Go::Board *board, Go:
   }
 }
 
-void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, float critarray[], int passes, std::vector<int> *pool, std::vector<int> *poolcrit, std::string *reason, float *trylocal_p)
+void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, float critarray[], int passes, const std::vector<int> *pool, const std::vector<int> *poolcrit, std::string *reason, float *trylocal_p)
 {
   /* trylocal_p can be used to influence parameters from move to move in a playout. It starts with 1.0
    * 
@@ -544,375 +714,41 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
    5. Non local moves as random ...
    */
   Random *const rand=settings->rand;
-  int ncirc=0;
+  Engine::ThreadStatistics *const stats=params->engine->getThreadStatistics(settings);
 
   move=Go::Move(col,Go::Move::PASS);
+  settings->playoutscratch->movestage=Playout::STAGE_NUM;
   if (board->numOfValidMoves(col)==0)
     return;
   
-  if (params->playout_random_chance>0)
-  {
-    float f=rand->getRandomReal();
-    if (f<params->playout_random_chance)
-      goto random;
-  }
-
-  if (params->playout_order==1 && params->playout_lastcapture_enabled)
-  {
-    this->getLastCaptureMove(settings,board,col,move,posarray);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s lastcapture\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="lastcapture";
-      return;
-    }
-  }
-
-  // LGRF is back here because a parameter couldn't do it!
-  if (params->playout_lgrf2_enabled && params->playout_lgrf2_safe_enabled)
-  {
-    this->getLGRF2Move(settings, board,col,move);
-    if (!move.isPass())
-    {
-      int p=move.getPosition();
-      int pos1=board->getSecondLastMove().getPosition();
-      int pos2=board->getLastMove().getPosition();
-      unsigned int hash3x3=Pattern::ThreeByThree::makeHash(board,p);
-      if (hash3x3==this->getLGRF2hash(col,pos1,pos2))
-      {
-        if (params->debug_on)
-          gtpe->getOutput()->printfDebug("[playoutmove]: %s lgrf2\n",move.toString(board->getSize()).c_str());
-        if (reason!=NULL)
-          *reason="save lgrf2";
-        params->engine->statisticsPlus(Engine::LGRF2);
-      move.set_useforlgrf (true);
-        return;
-      }
-      move=Go::Move(col,Go::Move::PASS);
-    }
-  }
-  
-  if (params->playout_lgrf2_enabled && !params->playout_lgrf2_safe_enabled)
-  {
-    this->getLGRF2Move(settings, board,col,move);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s lgrf2\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="lgrf2";
-      params->engine->statisticsPlus(Engine::LGRF2);
-      move.set_useforlgrf (true);
-      return;
-    }
-  }
-
-  if (params->playout_lgrf1_enabled && params->playout_lgrf1_safe_enabled)
-  {
-    //safe LGRF1 move
-    this->getLGRF1Move(settings, board,col,move);
-    if (!move.isPass())
-    {
-      int p=move.getPosition();
-      unsigned int hash3x3=Pattern::ThreeByThree::makeHash(board,p);
-      int pos1=board->getLastMove().getPosition();
-      unsigned int hash3x3_2=Pattern::ThreeByThree::makeHash(board,pos1);
-      if (hash3x3!=0 && this->getLGRF1hash(col,pos1)==hash3x3 && this->getLGRF1hash2(col,pos1)==hash3x3_2) //,Pattern::FiveByFiveBorder::makeHash(board,p)))
-      {
-        if (params->debug_on)
-          gtpe->getOutput()->printfDebug("[playoutmove]: %s safe lgrf1\n",move.toString(board->getSize()).c_str());
-        if (reason!=NULL)
-          *reason="safe lgrf1";
-        move.set_useforlgrf (true);
-        return;
-      }
-      move=Go::Move(col,Go::Move::PASS);
-    }
-  }
-
-  if (params->playout_lgrf1_enabled  && !params->playout_lgrf1_safe_enabled)
-  {
-    this->getLGRF1Move(settings, board,col,move);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s lgrf1\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="lgrf1";
-      move.set_useforlgrf (true);
-      return;
-    }
-  }
-  
-  if (params->playout_atari_enabled)
-  {
-    this->getAtariMove(settings,board,col,move,posarray);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s atari\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="atari";
-      return;
-    }
-  }
-
-//  if (trylocal_p!=NULL && !WITH_P(*trylocal_p))
-//    goto notlocal;
-  
-  if (params->playout_lastatari_p>0.0) //p is used in the getLastAtariMove function
-  {
-    this->getLastAtariMove(settings,board,col,move,posarray);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s lastatari\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="lastatari";
-      params->engine->statisticsPlus(Engine::LASTATARI);
-      return;
-    }
-  }
-  
-  if ((params->playout_order==0 || params->playout_order>3) && params->playout_lastcapture_enabled)
-  {
-    this->getLastCaptureMove(settings,board,col,move,posarray);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s lastcapture\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="lastcapture";
-      params->engine->statisticsPlus(Engine::LASTCAPTURE);
-      return;
-    }
-  }
-
-  if (params->playout_last2libatari_enabled)
-  {
-    this->getLast2LibAtariMove(settings,board,col,move,posarray);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s last2libatari\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="last2libatari";
-      params->engine->statisticsPlus(Engine::LAST2LIBATARI);
-      return;
-    }
-  }
-
-  if (params->playout_order==2 && params->playout_lastcapture_enabled)
-  {
-    this->getLastCaptureMove(settings,board,col,move,posarray);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s lastcapture\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="lastcapture";
-      return;
-    }
-  }
-
-  if (params->playout_nakade_enabled)
-  {
-    this->getNakadeMove(settings,board,col,move,posarray);
-    //fprintf(stderr,"move nakade %s\n",move.toString (9).c_str());
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s nakade\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="nakade";
-      params->engine->statisticsPlus(Engine::NAKED);
-      return;
-    }
-  }
-
-  if (params->playout_nearby_enabled)
-  {
-    this->getNearbyMove(settings,board,col,move);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s nearby\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="nearby";
-      return;
-    }
-  }
-
-  if (params->playout_order!=4 && params->playout_fillboard_enabled)
-  {
-    std::string tmpreason="fillboard";
-    this->getFillBoardMove(settings,board,col,move,posarray,passes,&tmpreason);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s fillboard\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason=tmpreason;
-      return;
-    }
-  }
-  
-  if (WITH_P(params->playout_patterns_p))
-  {
-    this->getPatternMove(settings,board,col,move,posarray,passes);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s pattern\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-      	*reason="pattern";
-      params->engine->statisticsPlus(Engine::PATTERN);
-      return;
-    }
-  }
-
-//  notlocal:
-//  if (trylocal_p!=NULL) *trylocal_p*=params->test_p1;
-  
-  if (WITH_P(params->playout_anycapture_p))
-  {
-    this->getAnyCaptureMove(settings,board,col,move,posarray);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s anycapture\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="anycapture";
-      params->engine->statisticsPlus(Engine::ANYCAPTURE);
-      return;
-    }
-  }
-  
-  while (ncirc<params->playout_circpattern_n)
-  {
-    ncirc++;
-    int p=rand->getRandomInt(board->getPositionMax());
-    if (board->validMove(Go::Move(col,p)) && !this->isBadMove(settings,board,col,p,params->playout_avoid_lbrf1_p,params->playout_avoid_lbmf_p,passes))
-    {
-      Pattern::Circular pattcirc=Pattern::Circular(params->engine->getCircDict(),board,p,params->engine->getCircSize());
-      if (col==Go::WHITE)
-        pattcirc.invert();
-      pattcirc.convertToSmallestEquivalent(params->engine->getCircDict());
-      if (params->engine->isCircPattern(pattcirc.toString(params->engine->getCircDict())))
-      {
-        move=Go::Move(col,p);
-        if (params->debug_on)
-          gtpe->getOutput()->printfDebug("[playoutmove]: %s circpattern quick-pick %s\n",move.toString(board->getSize()).c_str(),pattcirc.toString(params->engine->getCircDict()).c_str());
-        if (reason!=NULL)
-          *reason="circpattern quick-pick";
-        params->engine->statisticsPlus(Engine::CIRCPATTERN_QUICK);
-        return;
-      }
-    }
-  }
-
-  if (params->playout_poolrave_enabled)
-  {
-    this->getPoolRAVEMove(settings,board,col,move,pool);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s poolrave\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-      {
-        *reason="poolrave";
-        for (unsigned int i=0;i<pool->size();i++)
-          *reason+=" "+Go::Position::pos2string(pool->at(i),board->getSize());
-      }
-      return;
-    }
-  }
-  
-  if (params->playout_poolrave_criticality)
-  {
-    this->getPoolRAVEMove(settings,board,col,move,poolcrit);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s poolcriticality\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-      {
-        *reason="poolcriticality";
-        for (unsigned int i=0;i<poolcrit->size();i++)
-          *reason+=" "+Go::Position::pos2string(poolcrit->at(i),board->getSize());
-      }
-      return;
-    }
-  }
-  
-  if (params->playout_lgrf1o_enabled)
-  {
-    this->getLGRF1oMove(settings,board,col,move);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s lgrf1o\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="lgrf1o";
-      return;
-    }
-  }
-  
-  if (params->playout_lgpf_enabled)
+  if (params->playout_random_chance>0)
   {
-    this->getLGPFMove(settings,board,col,move,posarray);
-    if (!move.isPass())
-    {
-      if (params->debug_on)
-        gtpe->getOutput()->printfDebug("[playoutmove]: %s lgpf\n",move.toString(board->getSize()).c_str());
-      if (reason!=NULL)
-        *reason="lgpf";
-      return;
-    }
+    float f=rand->getRandomReal();
+    if (f<params->playout_random_chance)
+      goto random;
   }
-  
- if (params->playout_order==4 && params->playout_fillboard_enabled)
+
+  for (int i=0;i<policysize;i++)
   {
-    if (params->playout_fillboard_bestcirc_enabled)
+    Playout::PolicyStage stage=policy[i];
+    bool found;
+    stats->stageattempts[stage]++;
+    if (params->playout_stats_timing)
     {
-      std::string tmpreason="fillboard bestpattern";
-      this->getFillBoardMoveBestPattern(settings,board,col,move,posarray,passes,&tmpreason);
-      if (!move.isPass())
-      {
-        if (params->debug_on)
-          gtpe->getOutput()->printfDebug("[playoutmove]: %s fillboard bestpattern\n",move.toString(board->getSize()).c_str());
-        if (reason!=NULL)
-          *reason=tmpreason;
-        return;
-      }
+      boost::posix_time::ptime timestart=boost::posix_time::microsec_clock::universal_time();
+      found=this->getPolicyStageMove(stage,settings,board,col,move,posarray,passes,pool,poolcrit,reason);
+      stats->stagetime[stage]+=(boost::posix_time::microsec_clock::universal_time()-timestart).total_microseconds();
     }
     else
+      found=this->getPolicyStageMove(stage,settings,board,col,move,posarray,passes,pool,poolcrit,reason);
+    if (found)
     {
-      std::string tmpreason="fillboard";
-      this->getFillBoardMove(settings,board,col,move,posarray,passes,&tmpreason);
-      if (!move.isPass())
-      {
-        if (params->debug_on)
-          gtpe->getOutput()->printfDebug("[playoutmove]: %s fillboard\n",move.toString(board->getSize()).c_str());
-        if (reason!=NULL)
-          *reason=tmpreason;
-        return;
-      }
+      stats->stagehits[stage]++;
+      settings->playoutscratch->movestage=stage;
+      return;
     }
   }
   
-  if (params->playout_features_enabled)
-  {
-    this->getFeatureMove(settings,board,col,move);
-    if (params->debug_on)
-      gtpe->getOutput()->printfDebug("[playoutmove]: %s features\n",move.toString(board->getSize()).c_str());
-    if (reason!=NULL)
-      *reason="features";
-    return;
-  }
-  
   random: // for playout_random_chance
 
   bool doapproachmoves=(rand->getRandomReal()<params->playout_random_approach_p);
@@ -924,7 +760,7 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
     
     for (int i=0;i<params->playout_criticality_random_n;i++)
     {
-      int p=rand->getRandomInt(board->getPositionMax());
+      int p=board->getEmptyPosition(rand->getRandomInt(board->getEmptyCount()));
       if (doapproachmoves)
         this->replaceWithApproachMove(settings,board,col,p);
       if (board->validMove(Go::Move(col,p)) && !this->isBadMove(settings,board,col,p,params->playout_avoid_lbrf1_p,params->playout_avoid_lbmf_p,passes))
@@ -951,7 +787,7 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
         gtpe->getOutput()->printfDebug("[playoutmove]: %s random quick-pick with territory\n",move.toString(board->getSize()).c_str());
       if (reason!=NULL)
         *reason="random quick-pick with territory";
-      params->engine->statisticsPlus(Engine::RANDOM_QUICK_TERRITORY);
+      params->engine->statisticsPlus(settings,Engine::RANDOM_QUICK_TERRITORY);
       return;
     }
   }
@@ -963,7 +799,7 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
     
     for (int i=0;i<params->playout_random_weight_territory_n;i++)
     {
-      int p=rand->getRandomInt(board->getPositionMax());
+      int p=board->getEmptyPosition(rand->getRandomInt(board->getEmptyCount()));
       if (doapproachmoves)
         this->replaceWithApproachMove(settings,board,col,p);
       if (board->validMove(Go::Move(col,p)) && !this->isBadMove(settings,board,col,p,params->playout_avoid_lbrf1_p,params->playout_avoid_lbmf_p,passes))
@@ -990,7 +826,7 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
         gtpe->getOutput()->printfDebug("[playoutmove]: %s random quick-pick with territory\n",move.toString(board->getSize()).c_str());
       if (reason!=NULL)
         *reason="random quick-pick with territory";
-      params->engine->statisticsPlus(Engine::RANDOM_QUICK_TERRITORY);
+      params->engine->statisticsPlus(settings,Engine::RANDOM_QUICK_TERRITORY);
       return;
     }
   }
@@ -1002,17 +838,14 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
     
     for (int i=0;i<params->playout_randomquick_bestcirc_n;i++)
     {
-      int p=rand->getRandomInt(board->getPositionMax());
+      int p=board->getEmptyPosition(rand->getRandomInt(board->getEmptyCount()));
       if (doapproachmoves)
         this->replaceWithApproachMove(settings,board,col,p);
       if (board->validMove(Go::Move(col,p)) && !this->isBadMove(settings,board,col,p,params->playout_avoid_lbrf1_p,params->playout_avoid_lbmf_p,passes))
       {
         // only circular pattern
-        Pattern::Circular pattcirc=Pattern::Circular(params->engine->getCircDict(),board,p,params->engine->getCircSize());
-        if (col==Go::WHITE)
-          pattcirc.invert();
-        pattcirc.convertToSmallestEquivalent(params->engine->getCircDict());
-        float v=params->engine->valueCircPattern(pattcirc.toString(params->engine->getCircDict()));
+        Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(params->engine->getCircDict(),board,p,params->engine->getCircSize(),col==Go::WHITE);
+        float v=params->engine->valueCircPattern(pattcirc);
         
         /*
         //full gamma
@@ -1043,14 +876,16 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
         gtpe->getOutput()->printfDebug("[playoutmove]: %s random quick-pick circ\n",move.toString(board->getSize()).c_str());
       if (reason!=NULL)
         *reason="random quick-pick circ";
-      params->engine->statisticsPlus(Engine::RANDOM_QUICK_CIRC);
+      params->engine->statisticsPlus(settings,Engine::RANDOM_QUICK_CIRC);
       return;
     }
   }
 
+  unsigned long quickpicks[10];
+  rand->getRandomInts(quickpicks,10,board->getEmptyCount());
   for (int i=0;i<10;i++)
   {
-    int p=rand->getRandomInt(board->getPositionMax());
+    int p=board->getEmptyPosition(quickpicks[i]);
     if (doapproachmoves)
       this->replaceWithApproachMove(settings,board,col,p);
     if (board->validMove(Go::Move(col,p)) && !this->isBadMove(settings,board,col,p,params->playout_avoid_lbrf1_p,params->playout_avoid_lbmf_p,passes))
@@ -1061,41 +896,24 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
         gtpe->getOutput()->printfDebug("[playoutmove]: %s random quick-pick\n",move.toString(board->getSize()).c_str());
       if (reason!=NULL)
         *reason="random quick-pick";
-      params->engine->statisticsPlus(Engine::RANDOM_QUICK);
+      params->engine->statisticsPlus(settings,Engine::RANDOM_QUICK);
       return;
     }
   }
   
   Go::BitBoard *validmoves=board->getValidMoves(col);
-  /*int *possiblemoves=posarray;
-  int possiblemovescount=0;
-  
-  for (int p=0;p<board->getPositionMax();p++)
-  {
-    if (validmoves->get(p) && !this->isBadMove(board,col,p))
-    {
-      possiblemoves[possiblemovescount]=p;
-      possiblemovescount++;
-    }
-  }
-  
-  if (possiblemovescount==0)
-    move=Go::Move(col,Go::Move::PASS);
-  else if (possiblemovescount==1)
-    move=Go::Move(col,possiblemoves[0]);
-  else
-  {
-    int r=rand->getRandomInt(possiblemovescount);
-    move=Go::Move(col,possiblemoves[r]);
-  }*/
   
-  int r=rand->getRandomInt(board->getPositionMax());
-  int d=rand->getRandomInt(1)*2-1;
-  for (int p=0;p<board->getPositionMax();p++)
-  {
-    int rp=(r+p*d);
-    if (rp<0) rp+=board->getPositionMax();
-    if (rp>=board->getPositionMax()) rp-=board->getPositionMax();
+  // draw the remaining empty positions without replacement, swapping rejected ones out of the window
+  int *candidates=posarray;
+  int candidatescount=board->getEmptyCount();
+  for (int i=0;i<candidatescount;i++)
+    candidates[i]=board->getEmptyPosition(i);
+  for (int window=candidatescount;window>0;window--)
+  {
+    int r=rand->getRandomInt(window);
+    int rp=candidates[r];
+    candidates[r]=candidates[window-1];
+    candidates[window-1]=rp;
     if (doapproachmoves)
       this->replaceWithApproachMove(settings,board,col,rp);
     if (validmoves->get(rp) && !this->isBadMove(settings,board,col,rp,params->playout_avoid_lbrf1_p,params->playout_avoid_lbmf_p,passes))
@@ -1106,7 +924,7 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
         gtpe->getOutput()->printfDebug("[playoutmove]: %s random\n",move.toString(board->getSize()).c_str());
       if (reason!=NULL)
         *reason="random";
-      params->engine->statisticsPlus(Engine::RANDOM);
+      params->engine->statisticsPlus(settings,Engine::RANDOM);
       return;
     }
   }
@@ -1114,11 +932,9 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
   if (params->playout_fill_weak_eyes)
   {
     //filling weak eyes, if not selfatari and no other move was possible
-    for (int p=0;p<board->getPositionMax();p++)
+    for (int i=0;i<candidatescount;i++)
     {
-      int rp=(r+p*d);
-      if (rp<0) rp+=board->getPositionMax();
-      if (rp>=board->getPositionMax()) rp-=board->getPositionMax();
+      int rp=candidates[i];
       if (validmoves->get(rp) && !this->isEyeFillMove(board,col,rp))
       {
         move=Go::Move(col,rp);
@@ -1126,13 +942,13 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
           gtpe->getOutput()->printfDebug("[playoutmove]: %s fill weak eye\n",move.toString(board->getSize()).c_str());
         if (reason!=NULL)
           *reason="fill weak eye";
-        params->engine->statisticsPlus(Engine::FILL_WEAK_EYE);
+        params->engine->statisticsPlus(settings,Engine::FILL_WEAK_EYE);
         return;
       }
     }
   }
 
-  params->engine->statisticsPlus(Engine::PASS);
+  params->engine->statisticsPlus(settings,Engine::PASS);
   move=Go::Move(col,Go::Move::PASS);
   if (params->debug_on)
     gtpe->getOutput()->printfDebug("[playoutmove]: %s pass\n",move.toString(board->getSize()).c_str());
@@ -1140,6 +956,372 @@ void Playout::getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::C
     *reason="pass";
 }
 
+bool Playout::getPolicyStageMove(Playout::PolicyStage stage, Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, int passes, const std::vector<int> *pool, const std::vector<int> *poolcrit, std::string *reason)
+{
+  Random *const rand=settings->rand;
+  
+  switch (stage)
+  {
+    case Playout::STAGE_LASTCAPTURE_FIRST:
+    {
+      this->getLastCaptureMove(settings,board,col,move,posarray);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s lastcapture\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="lastcapture";
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_LGRF2_SAFE:
+    {
+      this->getLGRF2Move(settings, board,col,move);
+      if (!move.isPass())
+      {
+        int p=move.getPosition();
+        int pos1=board->getSecondLastMove().getPosition();
+        int pos2=board->getLastMove().getPosition();
+        unsigned int hash3x3=Pattern::ThreeByThree::makeHash(board,p);
+        if (hash3x3==this->getLGRF2hash(col,pos1,pos2))
+        {
+          if (params->debug_on)
+            gtpe->getOutput()->printfDebug("[playoutmove]: %s lgrf2\n",move.toString(board->getSize()).c_str());
+          if (reason!=NULL)
+            *reason="save lgrf2";
+          params->engine->statisticsPlus(settings,Engine::LGRF2);
+          move.set_useforlgrf (true);
+          return true;
+        }
+        move=Go::Move(col,Go::Move::PASS);
+      }
+      break;
+    }
+    case Playout::STAGE_LGRF2:
+    {
+      this->getLGRF2Move(settings, board,col,move);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s lgrf2\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="lgrf2";
+        params->engine->statisticsPlus(settings,Engine::LGRF2);
+        move.set_useforlgrf (true);
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_LGRF1_SAFE:
+    {
+      //safe LGRF1 move
+      this->getLGRF1Move(settings, board,col,move);
+      if (!move.isPass())
+      {
+        int p=move.getPosition();
+        unsigned int hash3x3=Pattern::ThreeByThree::makeHash(board,p);
+        int pos1=board->getLastMove().getPosition();
+        unsigned int hash3x3_2=Pattern::ThreeByThree::makeHash(board,pos1);
+        if (hash3x3!=0 && this->getLGRF1hash(col,pos1)==hash3x3 && this->getLGRF1hash2(col,pos1)==hash3x3_2) //,Pattern::FiveByFiveBorder::makeHash(board,p)))
+        {
+          if (params->debug_on)
+            gtpe->getOutput()->printfDebug("[playoutmove]: %s safe lgrf1\n",move.toString(board->getSize()).c_str());
+          if (reason!=NULL)
+            *reason="safe lgrf1";
+          move.set_useforlgrf (true);
+          return true;
+        }
+        move=Go::Move(col,Go::Move::PASS);
+      }
+      break;
+    }
+    case Playout::STAGE_LGRF1:
+    {
+      this->getLGRF1Move(settings, board,col,move);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s lgrf1\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="lgrf1";
+        move.set_useforlgrf (true);
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_ATARI:
+    {
+      this->getAtariMove(settings,board,col,move,posarray);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s atari\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="atari";
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_LASTATARI:
+    {
+      this->getLastAtariMove(settings,board,col,move,posarray);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s lastatari\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="lastatari";
+        params->engine->statisticsPlus(settings,Engine::LASTATARI);
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_LASTCAPTURE:
+    {
+      this->getLastCaptureMove(settings,board,col,move,posarray);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s lastcapture\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="lastcapture";
+        params->engine->statisticsPlus(settings,Engine::LASTCAPTURE);
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_LAST2LIBATARI:
+    {
+      this->getLast2LibAtariMove(settings,board,col,move,posarray);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s last2libatari\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="last2libatari";
+        params->engine->statisticsPlus(settings,Engine::LAST2LIBATARI);
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_LASTCAPTURE_LATE:
+    {
+      this->getLastCaptureMove(settings,board,col,move,posarray);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s lastcapture\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="lastcapture";
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_NAKADE:
+    {
+      this->getNakadeMove(settings,board,col,move,posarray);
+      //fprintf(stderr,"move nakade %s\n",move.toString (9).c_str());
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s nakade\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="nakade";
+        params->engine->statisticsPlus(settings,Engine::NAKED);
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_NEARBY:
+    {
+      this->getNearbyMove(settings,board,col,move);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s nearby\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="nearby";
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_FILLBOARD:
+    {
+      std::string tmpreason="fillboard";
+      this->getFillBoardMove(settings,board,col,move,posarray,passes,&tmpreason);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s fillboard\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason=tmpreason;
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_PATTERN:
+    {
+      if (WITH_P(params->playout_patterns_p))
+      {
+        this->getPatternMove(settings,board,col,move,posarray,passes);
+        if (!move.isPass())
+        {
+          if (params->debug_on)
+            gtpe->getOutput()->printfDebug("[playoutmove]: %s pattern\n",move.toString(board->getSize()).c_str());
+          if (reason!=NULL)
+          	*reason="pattern";
+          params->engine->statisticsPlus(settings,Engine::PATTERN);
+          return true;
+        }
+      }
+      break;
+    }
+    case Playout::STAGE_ANYCAPTURE:
+    {
+      if (WITH_P(params->playout_anycapture_p))
+      {
+        this->getAnyCaptureMove(settings,board,col,move,posarray);
+        if (!move.isPass())
+        {
+          if (params->debug_on)
+            gtpe->getOutput()->printfDebug("[playoutmove]: %s anycapture\n",move.toString(board->getSize()).c_str());
+          if (reason!=NULL)
+            *reason="anycapture";
+          params->engine->statisticsPlus(settings,Engine::ANYCAPTURE);
+          return true;
+        }
+      }
+      break;
+    }
+    case Playout::STAGE_CIRCPATTERN:
+    {
+      for (int ncirc=0;ncirc<params->playout_circpattern_n;ncirc++)
+      {
+        int p=rand->getRandomInt(board->getPositionMax());
+        if (board->validMove(Go::Move(col,p)) && !this->isBadMove(settings,board,col,p,params->playout_avoid_lbrf1_p,params->playout_avoid_lbmf_p,passes) && params->playout_circpattern_match)
+        {
+          Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(params->engine->getCircDict(),board,p,params->engine->getCircSize(),col==Go::WHITE);
+          if (params->engine->isCircPattern(pattcirc))
+          {
+            move=Go::Move(col,p);
+            if (params->debug_on)
+              gtpe->getOutput()->printfDebug("[playoutmove]: %s circpattern quick-pick %s\n",move.toString(board->getSize()).c_str(),pattcirc.toString(params->engine->getCircDict()).c_str());
+            if (reason!=NULL)
+              *reason="circpattern quick-pick";
+            params->engine->statisticsPlus(settings,Engine::CIRCPATTERN_QUICK);
+            return true;
+          }
+        }
+      }
+      break;
+    }
+    case Playout::STAGE_POOLRAVE:
+    {
+      this->getPoolRAVEMove(settings,board,col,move,pool);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s poolrave\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+        {
+          *reason="poolrave";
+          for (unsigned int i=0;i<pool->size();i++)
+            *reason+=" "+Go::Position::pos2string(pool->at(i),board->getSize());
+        }
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_POOLCRITICALITY:
+    {
+      this->getPoolRAVEMove(settings,board,col,move,poolcrit);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s poolcriticality\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+        {
+          *reason="poolcriticality";
+          for (unsigned int i=0;i<poolcrit->size();i++)
+            *reason+=" "+Go::Position::pos2string(poolcrit->at(i),board->getSize());
+        }
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_LGRF1O:
+    {
+      this->getLGRF1oMove(settings,board,col,move);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s lgrf1o\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="lgrf1o";
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_LGPF:
+    {
+      this->getLGPFMove(settings,board,col,move,posarray);
+      if (!move.isPass())
+      {
+        if (params->debug_on)
+          gtpe->getOutput()->printfDebug("[playoutmove]: %s lgpf\n",move.toString(board->getSize()).c_str());
+        if (reason!=NULL)
+          *reason="lgpf";
+        return true;
+      }
+      break;
+    }
+    case Playout::STAGE_FILLBOARD_LATE:
+    {
+      if (params->playout_fillboard_bestcirc_enabled)
+      {
+        std::string tmpreason="fillboard bestpattern";
+        this->getFillBoardMoveBestPattern(settings,board,col,move,posarray,passes,&tmpreason);
+        if (!move.isPass())
+        {
+          if (params->debug_on)
+            gtpe->getOutput()->printfDebug("[playoutmove]: %s fillboard bestpattern\n",move.toString(board->getSize()).c_str());
+          if (reason!=NULL)
+            *reason=tmpreason;
+          return true;
+        }
+      }
+      else
+      {
+        std::string tmpreason="fillboard";
+        this->getFillBoardMove(settings,board,col,move,posarray,passes,&tmpreason);
+        if (!move.isPass())
+        {
+          if (params->debug_on)
+            gtpe->getOutput()->printfDebug("[playoutmove]: %s fillboard\n",move.toString(board->getSize()).c_str());
+          if (reason!=NULL)
+            *reason=tmpreason;
+          return true;
+        }
+      }
+      break;
+    }
+    case Playout::STAGE_FEATURES:
+    {
+      this->getFeatureMove(settings,board,col,move);
+      if (params->debug_on)
+        gtpe->getOutput()->printfDebug("[playoutmove]: %s features\n",move.toString(board->getSize()).c_str());
+      if (reason!=NULL)
+        *reason="features";
+      return true;
+    }
+    default:
+      break;
+  }
+
+  return false;
+}
+
 bool Playout::isBadMove(Worker::Settings *settings, Go::Board *board, Go::Color col, int pos, float p, float p2, int passes)
 {
   if (pos<0) return false;
@@ -1157,7 +1339,7 @@ bool Playout::isEyeFillMove(Go::Board *board, Go::Color col, int pos)
   return (board->strongEye(col,pos) || board->isSelfAtariOfSize(Go::Move(col,pos),2) || board->twoGroupEye(col,pos));
 }
 
-void Playout::getPoolRAVEMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, std::vector<int> *pool)
+void Playout::getPoolRAVEMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, const std::vector<int> *pool)
 {
   if (pool==NULL || pool->size()<=0)
     return;
@@ -1259,6 +1441,14 @@ void Playout::getFeatureMove(Worker::Settings *settings, Go::Board *board, Go::C
   float randomgamma=totalgamma*rand->getRandomReal();
   bool foundmove=false;
   
+  int sampledpos=board->findFeatureGamma(randomgamma);
+  if (sampledpos>=0 && board->validMove(Go::Move(col,sampledpos)))
+  {
+    move=Go::Move(col,sampledpos);
+    return;
+  }
+  
+  // the gammas outside the updated neighbourhoods can be stale, so fall back to a scan of the valid moves
   for (int p=0;p<board->getPositionMax();p++)
   {
     Go::Move m=Go::Move(col,p);
@@ -1290,8 +1480,8 @@ void Playout::getAnyCaptureMove(Worker::Settings *settings, Go::Board *board, Go
   int *possiblemoves=posarray;
   int possiblemovescount=0;
   
-  std::ourset<Go::Group*> *groups=board->getGroups();
-  for(std::ourset<Go::Group*>::iterator iter=groups->begin();iter!=groups->end();++iter) 
+  Go::group_set *groups=board->getGroups();
+  for(Go::group_set::iterator iter=groups->begin();iter!=groups->end();++iter) 
   {
     if ((*iter)->getColor()!=col && (*iter)->inAtari())
     {
@@ -1315,7 +1505,7 @@ void Playout::getPatternMove(Worker::Settings *settings, Go::Board *board, Go::C
 {
   Random *const rand=settings->rand;
   Pattern::ThreeByThreeTable *const patterntable=params->engine->getPatternTable();
-  Pattern::ThreeByThreeGammas *const patterngammas=params->engine->getFeatures()->getPatternGammas();
+  const Pattern::ThreeByThreeGammaTable *const patterngammatable=params->engine->getFeatures()->getPatternGammaTable();
 
   int *patternmoves=posarray;
   int patternmovescount=0;
@@ -1329,11 +1519,11 @@ void Playout::getPatternMove(Worker::Settings *settings, Go::Board *board, Go::C
       if (board->validMove(Go::Move(col,p)) && !this->isBadMove(settings,board,col,p,params->playout_avoid_lbrf1_p2,params->playout_avoid_lbmf_p2,passes))
       {
         unsigned int pattern=Pattern::ThreeByThree::makeHash(board,p);
-        if (col==Go::WHITE)
-          pattern=Pattern::ThreeByThree::invert(pattern);
         
         if (params->playout_patterns_gammas_p==0.0)
         {
+          if (col==Go::WHITE)
+            pattern=Pattern::ThreeByThree::invert(pattern);
           if (patterntable->isPattern(pattern))
           {
             patternmoves[patternmovescount]=p;
@@ -1342,7 +1532,7 @@ void Playout::getPatternMove(Worker::Settings *settings, Go::Board *board, Go::C
         }
         else
         {
-          if (rand->getRandomReal()*params->playout_patterns_gammas_p < patterngammas->getGamma(pattern))
+          if (rand->getRandomReal()*params->playout_patterns_gammas_p < patterngammatable->getGamma(col,pattern))
           {
             patternmoves[patternmovescount]=p;
             patternmovescount++;
@@ -1394,11 +1584,8 @@ void Playout::getFillBoardMove(Worker::Settings *settings, Go::Board *board, Go:
       move=Go::Move(col,p);
       if (params->playout_circreplace_enabled)
       {
-        Pattern::Circular pattcirc=Pattern::Circular(params->engine->getCircDict(),board,p,params->engine->getCircSize());
-        if (col==Go::WHITE)
-          pattcirc.invert();
-        pattcirc.convertToSmallestEquivalent(params->engine->getCircDict());
-        if (params->engine->isCircPattern(pattcirc.toString(params->engine->getCircDict())))
+        Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(params->engine->getCircDict(),board,p,params->engine->getCircSize(),col==Go::WHITE);
+        if (params->playout_circpattern_match && params->engine->isCircPattern(pattcirc))
         {
           patternmoves[patternmovescount]=p;
           patternmovescount++;
@@ -1408,11 +1595,8 @@ void Playout::getFillBoardMove(Worker::Settings *settings, Go::Board *board, Go:
         foreach_adjdiag(pos,p,{
           if (board->validMove(Go::Move(col,p)) && !this->isBadMove(settings,board,col,p,params->playout_avoid_lbrf1_p,params->playout_avoid_lbmf_p,passes))
           {
-            Pattern::Circular pattcirc=Pattern::Circular(params->engine->getCircDict(),board,p,params->engine->getCircSize());
-            if (col==Go::WHITE)
-              pattcirc.invert();
-            pattcirc.convertToSmallestEquivalent(params->engine->getCircDict());
-            if (params->engine->isCircPattern(pattcirc.toString(params->engine->getCircDict())))
+            Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(params->engine->getCircDict(),board,p,params->engine->getCircSize(),col==Go::WHITE);
+            if (params->playout_circpattern_match && params->engine->isCircPattern(pattcirc))
             {
               move=Go::Move(col,p);
               patternmoves[patternmovescount]=p;
@@ -1429,10 +1613,10 @@ void Playout::getFillBoardMove(Worker::Settings *settings, Go::Board *board, Go:
           gtpe->getOutput()->printfDebug("[playoutmove]: %s circpattern replace fillboard \n");
         if (reason!=NULL)
           *reason="circpattern replace fillboard";
-        params->engine->statisticsPlus(Engine::REPLACE_WITH_CIRC);
+        params->engine->statisticsPlus(settings,Engine::REPLACE_WITH_CIRC);
         return;        
       }
-      params->engine->statisticsPlus(Engine::FILL_BOARD);
+      params->engine->statisticsPlus(settings,Engine::FILL_BOARD);
       return;
     }
   }
@@ -1448,11 +1632,8 @@ void Playout::getFillBoardMoveBestPattern(Worker::Settings *settings, Go::Board
     int p=rand->getRandomInt(board->getPositionMax());
     if (board->getColor(p)==Go::EMPTY && board->surroundingEmpty(p)==8 && board->validMove(Go::Move(col,p)))
     {
-      Pattern::Circular pattcirc=Pattern::Circular(params->engine->getCircDict(),board,p,params->engine->getCircSize());
-      if (col==Go::WHITE)
-        pattcirc.invert();
-      pattcirc.convertToSmallestEquivalent(params->engine->getCircDict());
-      float v=params->engine->valueCircPattern(pattcirc.toString(params->engine->getCircDict()));
+      Pattern::Circular pattcirc=Pattern::Circular::makeSmallestEquivalent(params->engine->getCircDict(),board,p,params->engine->getCircSize(),col==Go::WHITE);
+      float v=params->engine->valueCircPattern(pattcirc);
       if (v>bestvalue)
       {
         patternmove=p;
@@ -1935,6 +2116,7 @@ void Playout::getAtariMove(Worker::Settings *settings, Go::Board *board, Go::Col
 
 void Playout::resetLGRF()
 {
+  lgrfgeneration++; // discard any buffered playouts
   if (lgrf1!=NULL)
     delete[] lgrf1;
   if (lgrf1n!=NULL)
@@ -1,7 +1,13 @@
 #ifndef DEF_OAKFOAM_PLAYOUT_H
 #define DEF_OAKFOAM_PLAYOUT_H
 
+#include <vector>
+#include <ostream>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
 #include "Go.h"
+//from "Benson.h":
+class Benson;
 //from "Parameters.h":
 class Parameters;
 //from "Tree.h":
@@ -13,6 +19,118 @@ namespace Worker
 };
 #include "../gtp/Gtp.h"
 
+/** Playout results waiting to be merged into the shared LGRF tables.
+ * Each worker thread has its own buffer, so that the shared tables are only written in batches.
+ */
+class PlayoutLGRFBuffer
+{
+  public:
+    /** The moves of a single playout, along with what is needed to update the LGRF tables. */
+    struct Entry
+    {
+      std::vector<Go::Move> moves;
+      std::vector<unsigned int> hashes3x3;
+      std::vector<unsigned long> hashes5x5;
+      std::vector<bool> wins;
+    };
+    
+    PlayoutLGRFBuffer() : used(0), generation(0) {};
+    
+    /** Get an empty entry for the next playout.
+     * Entries from an older generation of the LGRF tables are discarded.
+     */
+    PlayoutLGRFBuffer::Entry *getNextEntry(int gen);
+    /** Keep the entry last returned by getNextEntry(). */
+    void commitEntry() { used++; };
+    /** Get the @p i th committed entry. */
+    PlayoutLGRFBuffer::Entry *getEntry(int i) { return &entries[i]; };
+    /** Get the number of committed entries. */
+    int getSize() const { return used; };
+    /** Get the generation of the LGRF tables these entries are for. */
+    int getGeneration() const { return generation; };
+    /** Discard all entries. */
+    void clear() { used=0; };
+  
+  private:
+    std::vector<PlayoutLGRFBuffer::Entry> entries;
+    int used;
+    int generation;
+};
+
+/** Scratch space used during playouts.
+ * Each worker thread has its own instance, which is only reallocated when the board size changes.
+ */
+class PlayoutScratch
+{
+  public:
+    PlayoutScratch() : posarray(NULL), critarray(NULL), regionarray(NULL), benson(NULL), movestage(0), size(0), positionmax(0) {};
+    ~PlayoutScratch();
+    
+    /** Make sure the scratch space fits @p board. */
+    void prepare(Go::Board *board);
+    
+    /** Array of positions, as used by the playout move heuristics. */
+    int *posarray;
+    /** Criticality of each position. */
+    float *critarray;
+    /** Region marks, as used by the settled playout cutoff. */
+    Go::Color *regionarray;
+    /** Benson solver, as used by the settled playout cutoff. */
+    Benson *benson;
+    /** Policy stage that chose the last playout move, or Playout::STAGE_NUM if none did. */
+    int movestage;
+  
+  private:
+    int size,positionmax;
+};
+
+/** Binary trace of sampled playouts.
+ * Each worker thread has its own ring buffer of fixed-size entries, so that tracing can be left on in a normal build.
+ * When the buffer is full, the oldest entries are overwritten.
+ */
+class PlayoutTrace
+{
+  public:
+    /** A single traced move. */
+    struct Entry
+    {
+      /** Time of the move, in microseconds since the epoch. */
+      boost::uint64_t time;
+      /** Sequence number of the traced playout in this buffer. */
+      boost::uint32_t playout;
+      /** Position of the move, or a negative value for a pass or resign. */
+      boost::int16_t position;
+      /** Color of the move. */
+      boost::uint8_t color;
+      /** Policy stage that chose the move.
+       * Playout::STAGE_NUM is used for moves chosen at random, and Playout::STAGE_NUM+1 for the moves given by the tree.
+       */
+      boost::uint8_t stage;
+    };
+    
+    PlayoutTrace() : next(0), used(0), calls(0), playout(0) {};
+    
+    /** Start a new playout.
+     * Returns true if this playout is sampled, which is every @p interval playouts.
+     * The buffer is resized to @p size entries if needed, which discards its contents.
+     */
+    bool startPlayout(int interval, int size);
+    /** Record a move of the sampled playout. */
+    void addMove(Go::Move move, int stage);
+    /** Get the number of entries held. */
+    int getSize() const { return used; };
+    /** Write the entries, oldest first, in binary form. */
+    void write(std::ostream &out) const;
+    /** Discard all entries. */
+    void clear() { next=0; used=0; };
+  
+  private:
+    std::vector<PlayoutTrace::Entry> entries;
+    int next,used;
+    long calls;
+    boost::uint32_t playout;
+};
+
 /** Playouts. */
 class Playout
 {
@@ -34,14 +152,50 @@ class Playout
      */
     void doPlayout(Worker::Settings *settings, Go::Board *board, float &finalscore, Tree *playouttree, std::list<Go::Move> &playoutmoves, Go::Color colfirst, Go::BitBoard *firstlist, Go::BitBoard *secondlist, Go::BitBoard *earlyfirstlist, Go::BitBoard *earlysecondlist, std::list<std::string> *movereasons=NULL);
     /** Get a playout move for a given situation. */
-    void getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, float critarray[], int passes=0, std::vector<int> *pool=NULL, std::vector<int> *poolcrit=NULL, std::string *reason=NULL,float *trylocal_p=NULL);
+    void getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, float critarray[], int passes=0, const std::vector<int> *pool=NULL, const std::vector<int> *poolcrit=NULL, std::string *reason=NULL,float *trylocal_p=NULL);
     /** Check for a useless move according to the Crazy Stone heuristic.
      * @todo Consider incorporating this into getPlayoutMove()
      */
     void checkUselessMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, std::string *reason=NULL);
     
+    /** Stages of the playout policy, in the order they are tried. */
+    enum PolicyStage
+    {
+      STAGE_LASTCAPTURE_FIRST,
+      STAGE_LGRF2_SAFE,
+      STAGE_LGRF2,
+      STAGE_LGRF1_SAFE,
+      STAGE_LGRF1,
+      STAGE_ATARI,
+      STAGE_LASTATARI,
+      STAGE_LASTCAPTURE,
+      STAGE_LAST2LIBATARI,
+      STAGE_LASTCAPTURE_LATE,
+      STAGE_NAKADE,
+      STAGE_NEARBY,
+      STAGE_FILLBOARD,
+      STAGE_PATTERN,
+      STAGE_ANYCAPTURE,
+      STAGE_CIRCPATTERN,
+      STAGE_POOLRAVE,
+      STAGE_POOLCRITICALITY,
+      STAGE_LGRF1O,
+      STAGE_LGPF,
+      STAGE_FILLBOARD_LATE,
+      STAGE_FEATURES,
+      STAGE_NUM
+    };
+    /** Get a short name for a stage of the playout policy. */
+    static std::string getPolicyStageName(Playout::PolicyStage stage);
+    
     /** Reset LGRF values. */
     void resetLGRF();
+    /** Merge the buffered playouts of a worker thread into the LGRF tables. */
+    void mergeLGRF(Worker::Settings *settings);
+    /** Rebuild the list of heuristics used to select playout moves.
+     * Must be called whenever a parameter that enables or orders the heuristics changes.
+     */
+    void updatePolicy();
   
   private:
     Parameters *const params;
@@ -60,10 +214,20 @@ class Playout
     bool *badpassanswer;
     
     int lgrfpositionmax;
+    int lgrfgeneration;
+    boost::mutex lgrfmutex;
     
-    void getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, float critarray[], int passes=0, std::vector<int> *pool=NULL, std::vector<int> *poolcrit=NULL, std::string *reason=NULL,float *trylocal_p=NULL);
+    Playout::PolicyStage policy[STAGE_NUM];
+    int policysize;
+    
+    /** Try a single stage of the playout policy.
+     * @return Whether the stage selected the move.
+     */
+    bool getPolicyStageMove(Playout::PolicyStage stage, Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, int passes, const std::vector<int> *pool, const std::vector<int> *poolcrit, std::string *reason);
+    void getPlayoutMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, float critarray[], int passes=0, const std::vector<int> *pool=NULL, const std::vector<int> *poolcrit=NULL, std::string *reason=NULL,float *trylocal_p=NULL);
     void checkUselessMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, std::string *reason=NULL);
-    void getPoolRAVEMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, std::vector<int> *pool=NULL);
+    bool isSettled(Go::Board *board, int *posarray, Go::Color *regionarray, Benson *benson) const;
+    void getPoolRAVEMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, const std::vector<int> *pool=NULL);
     void getLGRF2Move(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move);
     void getLGRF1Move(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move);
     void getLGRF1oMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move);
@@ -83,6 +247,8 @@ class Playout
     void checkEyeMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, Go::Move &replacemove);
     void checkAntiEyeMove(Worker::Settings *settings, Go::Board *board, Go::Color col, Go::Move &move, int *posarray, Go::Move &replacemove);
 
+    void updateLGRF(Worker::Settings *settings, PlayoutLGRFBuffer::Entry *entry);
+    
     bool isBadMove(Worker::Settings *settings, Go::Board *board, Go::Color col, int pos, float p=0.0, float p2=0.0, int passes=0);
     bool isEyeFillMove(Go::Board *board, Go::Color col, int pos);
     int getTwoLibertyMoveLevel(Go::Board *board, Go::Move move, Go::Group *group);
@@ -15,29 +15,44 @@ Random::Random(unsigned long s, int threadid)
   if (s==0)
     seed=Random::makeSeed(threadid);
   else
-    seed=s^((unsigned long)threadid);
-}
-
-unsigned long Random::getRandomInt()
-{
-  //Park-Miller "Minimal Standard" PRNG
-  
-  unsigned long hi, lo;
+    seed=s;
   
-  lo= 16807 * (seed & 0xffff);
-  hi= 16807 * (seed >> 16);
+  //splitmix64 to spread the seed over the whole state
+  boost::uint64_t x=seed;
+  for (int i=0;i<4;i++)
+  {
+    x+=0x9E3779B97F4A7C15ULL;
+    boost::uint64_t z=x;
+    z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+    z=(z^(z>>27))*0x94D049BB133111EBULL;
+    state[i]=z^(z>>31);
+  }
   
-  lo+= (hi & 0x7fff) << 16;
-  lo+= hi >> 15;
-  
-  if (lo >= 0x7FFFFFFF) lo-=0x7FFFFFFF;
-
-  return (seed=lo);
+  //give each thread its own stream
+  for (int i=0;i<threadid;i++)
+    this->jump();
 }
 
-unsigned long Random::getRandomInt(unsigned long max)
+void Random::jump()
 {
-  return this->getRandomInt() % max; //XXX: not uniform, but good enough
+  static const boost::uint64_t jumps[4]={0x180EC6D33CFD0ABAULL,0xD5A61266F0C9392CULL,0xA9582618E03FC9AAULL,0x39ABDC4529B1661CULL};
+  boost::uint64_t s[4]={0,0,0,0};
+  
+  for (int i=0;i<4;i++)
+  {
+    for (int b=0;b<64;b++)
+    {
+      if (jumps[i] & ((boost::uint64_t)1<<b))
+      {
+        for (int j=0;j<4;j++)
+          s[j]^=state[j];
+      }
+      this->next();
+    }
+  }
+  
+  for (int j=0;j<4;j++)
+    state[j]=s[j];
 }
 
 unsigned long Random::getRandomInt(unsigned long max, float a)
@@ -47,9 +62,10 @@ unsigned long Random::getRandomInt(unsigned long max, float a)
   return r;
 }
 
-float Random::getRandomReal()
+void Random::getRandomInts(unsigned long *buffer, int count, unsigned long max)
 {
-  return (float)this->getRandomInt() / ((unsigned long)(1) << 31);
+  for (int i=0;i<count;i++)
+    buffer[i]=this->getRandomInt(max);
 }
 
 unsigned long Random::makeSeed(int threadid)
@@ -1,31 +1,71 @@
 #ifndef DEF_OAKFOAM_RANDOM_H
 #define DEF_OAKFOAM_RANDOM_H
 
+#include <boost/cstdint.hpp>
+
 /** Pseudo Random Number Generator.
- * Uses of a Park-Miller PRNG.
+ * Uses a xoshiro256** PRNG, seeded with splitmix64.
+ * Ranges are reduced with Lemire's multiply-shift method, which is unbiased.
  */
 class Random
 {
   public:
-    /** Create a new Random object with specific seeds. */
+    /** Create a new Random object with specific seeds.
+     * Generators with the same seed and different thread ids produce non-overlapping streams.
+     */
     Random(unsigned long s=0, int threadid=0);
-    /** Return the current seed. */
+    /** Return the seed this generator was started with. */
     unsigned long getSeed() const { return seed; };
     
-    /** Generate a random integer. */
-    unsigned long getRandomInt();
-    /** Generate a random integer in a range. */
-    unsigned long getRandomInt(unsigned long max);
+    /** Generate a random 32-bit integer. */
+    inline unsigned long getRandomInt() { return (unsigned long)(this->next()>>32); };
+    /** Generate a random integer in the range [0,max). */
+    inline unsigned long getRandomInt(unsigned long max)
+    {
+      boost::uint64_t m=(this->next()>>32)*(boost::uint64_t)max;
+      boost::uint32_t l=(boost::uint32_t)m;
+      if (l<max)
+      {
+        boost::uint32_t t=(boost::uint32_t)(-(boost::uint32_t)max)%(boost::uint32_t)max;
+        while (l<t)
+        {
+          m=(this->next()>>32)*(boost::uint64_t)max;
+          l=(boost::uint32_t)m;
+        }
+      }
+      return (unsigned long)(m>>32);
+    };
     /** Generate with distribution function. */
     unsigned long getRandomInt(unsigned long max, float a);
-    /** Generate a random float in the range (0,1). */
-    float getRandomReal();
+    /** Generate a random float in the range (0,1).
+     * The value is never 0, so it can be passed to log(), and 23 bits are used so that it can't round up to 1.
+     */
+    inline float getRandomReal() { return ((float)(this->next()>>41)+0.5f)*(1.0f/8388608.0f); };
+    /** Fill a buffer with random integers in the range [0,max). */
+    void getRandomInts(unsigned long *buffer, int count, unsigned long max);
     
     /** Create a new seed. */
     static unsigned long makeSeed(int threadid=0);
   
   private:
     unsigned long seed;
+    boost::uint64_t state[4];
+    
+    /** Advance the state by 2^128 draws. */
+    void jump();
+    static inline boost::uint64_t rotl(boost::uint64_t x, int k) { return (x<<k)|(x>>(64-k)); };
+    inline boost::uint64_t next()
+    {
+      boost::uint64_t result=rotl(state[1]*5,7)*9;
+      boost::uint64_t t=state[1]<<17;
+      state[2]^=state[0];
+      state[3]^=state[1];
+      state[1]^=state[2];
+      state[0]^=state[3];
+      state[2]^=t;
+      state[3]=rotl(state[3],45);
+      return result;
+    };
 };
 
 #endif
@@ -0,0 +1,359 @@
+#include "Trainer.h"
+
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include "Parameters.h"
+#include "Features.h"
+#include "Worker.h"
+#include "Random.h"
+
+Trainer::Trainer(Parameters *prms, Features *feat, Worker::Pool *pl)
+  : params(prms),
+    features(feat),
+    pool(pl)
+{
+  std::istringstream iss(features->getFeatureIdList());
+  std::string line;
+  while (std::getline(iss,line))
+  {
+    std::istringstream issline(line);
+    unsigned int id;
+    std::string name;
+    if (!(issline >> id >> name) || id!=names.size())
+      continue;
+    names.push_back(name);
+
+    //the features of a class have consecutive ids and a group is made up of a class
+    std::string groupname=name.substr(0,name.find(':'));
+    if (groups.size()==0 || groups.back().name!=groupname)
+    {
+      Trainer::Group group;
+      group.name=groupname;
+      group.first=id;
+      groups.push_back(group);
+    }
+    groups.back().last=id;
+  }
+
+  gammas.assign(names.size(),1.0);
+  wins.assign(names.size(),0);
+  teamstart.push_back(0);
+  compstart.push_back(0);
+  nextgame=0;
+  nextaddgame=0;
+  loglikelihood=0;
+}
+
+Trainer::~Trainer()
+{
+}
+
+void Trainer::doThreadWork(Worker::Settings *settings)
+{
+  switch (stage)
+  {
+    case Trainer::EXTRACT:
+      this->extractThread(settings);
+      break;
+    case Trainer::STRENGTHS:
+      this->strengthsThread(settings);
+      break;
+    case Trainer::TOTALS:
+      this->totalsThread(settings);
+      break;
+    case Trainer::SUMS:
+      this->sumsThread(settings);
+      break;
+  }
+}
+
+void Trainer::runStage(Trainer::Stage s)
+{
+  stage=s;
+  params->thread_job=Parameters::TJ_TRAIN;
+  pool->startAll();
+  pool->waitAll();
+}
+
+void Trainer::extractCompetitions(std::vector<std::string> gamelist)
+{
+  games=gamelist;
+  nextgame=0;
+  nextaddgame=0;
+  this->runStage(Trainer::EXTRACT);
+  games.clear();
+  pendinggames.clear();
+  teamindex.clear();
+
+  wins.assign(names.size(),0);
+  for (unsigned int j=0;j<compwinner.size();j++)
+  {
+    unsigned int t=compwinner[j];
+    for (unsigned int k=teamstart[t];k<teamstart[t+1];k++)
+      wins[teamfeatures[k]]++;
+  }
+
+  unsigned int numteams=this->getTeamCount();
+  teamcompstart.assign(numteams+1,0);
+  for (unsigned int k=0;k<compteams.size();k++)
+    teamcompstart[compteams[k]+1]++;
+  for (unsigned int t=0;t<numteams;t++)
+    teamcompstart[t+1]+=teamcompstart[t];
+  teamcomps.resize(compteams.size());
+  teamcompcounts.resize(compteams.size());
+  std::vector<unsigned int> next(teamcompstart.begin(),teamcompstart.end()-1);
+  for (unsigned int j=0;j<compwinner.size();j++)
+  {
+    for (unsigned int k=compstart[j];k<compstart[j+1];k++)
+    {
+      unsigned int i=next[compteams[k]]++;
+      teamcomps[i]=j;
+      teamcompcounts[i]=compcounts[k];
+    }
+  }
+}
+
+unsigned int Trainer::addTeam(const std::vector<unsigned int> &team)
+{
+  std::map<std::vector<unsigned int>,unsigned int>::iterator it=teamindex.find(team);
+  if (it!=teamindex.end())
+    return it->second;
+
+  unsigned int t=teamstart.size()-1;
+  teamfeatures.insert(teamfeatures.end(),team.begin(),team.end());
+  teamstart.push_back(teamfeatures.size());
+  teamindex[team]=t;
+  return t;
+}
+
+void Trainer::extractThread(Worker::Settings *settings)
+{
+  std::vector<unsigned int> ids;
+
+  while (true)
+  {
+    unsigned int gameindex;
+    {
+      boost::mutex::scoped_lock lock(datamutex);
+      if (nextgame>=games.size())
+        break;
+      gameindex=nextgame++;
+    }
+    std::string game=games[gameindex];
+
+    //each competition is a list of teams (sets of feature ids), the first is the move played
+    std::list<Trainer::Competition> gamecomps;
+    int size;
+    std::list<Go::Move> setup,moves;
+    if (!Go::loadSGFGame(game,size,setup,moves))
+      fprintf(stderr,"[train] skipping game: '%s'\n",game.c_str());
+    else
+    {
+      //the sampled positions only depend on the seed and the game, not on the thread that extracts it
+      unsigned long gameseed=params->rand_seed+gameindex;
+      Random rand((gameseed!=0?gameseed:1));
+
+      Go::Board *board=new Go::Board(size);
+      for (std::list<Go::Move>::iterator iter=setup.begin();iter!=setup.end();++iter)
+      {
+        if (board->validMove(*iter))
+          board->makeMove(*iter);
+      }
+
+      for (std::list<Go::Move>::iterator iter=moves.begin();iter!=moves.end();++iter)
+      {
+        Go::Move move=(*iter);
+        if (!board->validMove(move))
+          break;
+
+        if (params->mm_train_sample>=1.0 || rand.getRandomReal()<params->mm_train_sample)
+        {
+          Go::ObjectBoard<int> *cfglastdist=NULL;
+          Go::ObjectBoard<int> *cfgsecondlastdist=NULL;
+          features->computeCFGDist(board,&cfglastdist,&cfgsecondlastdist);
+
+          gamecomps.push_back(Trainer::Competition());
+          Trainer::Competition &comp=gamecomps.back();
+          Go::Color col=move.getColor();
+          for (int p=-1;p<board->getPositionMax();p++)
+          {
+            Go::Move m=(p<0?move:(p==0?Go::Move(col,Go::Move::PASS):Go::Move(col,p)));
+            if (p>=0 && (m==move || !board->validMove(m)))
+              continue;
+
+            features->getMatchingFeatureIds(board,cfglastdist,cfgsecondlastdist,m,ids);
+            //decision tree leaves are not trained here
+            while (ids.size()>0 && ids.back()>=names.size())
+              ids.pop_back();
+            comp.push_back(ids);
+          }
+
+          if (cfglastdist!=NULL)
+            delete cfglastdist;
+          if (cfgsecondlastdist!=NULL)
+            delete cfgsecondlastdist;
+        }
+
+        board->makeMove(move);
+      }
+      delete board;
+    }
+
+    //competitions are added in the order of the games, so the teams and the sums don't depend on the threads
+    boost::mutex::scoped_lock lock(datamutex);
+    pendinggames[gameindex].swap(gamecomps);
+    while (pendinggames.count(nextaddgame)>0)
+    {
+      this->addCompetitions(pendinggames[nextaddgame]);
+      pendinggames.erase(nextaddgame);
+      nextaddgame++;
+    }
+  }
+}
+
+void Trainer::addCompetitions(const std::list<Trainer::Competition> &comps)
+{
+  for (std::list<Trainer::Competition>::const_iterator iter=comps.begin();iter!=comps.end();++iter)
+  {
+    //moves with the same features are merged, as only their number matters
+    std::map<unsigned int,unsigned int> counts;
+    for (unsigned int i=0;i<iter->size();i++)
+    {
+      unsigned int t=this->addTeam((*iter)[i]);
+      if (i==0)
+        compwinner.push_back(t);
+      counts[t]++;
+    }
+    for (std::map<unsigned int,unsigned int>::iterator it=counts.begin();it!=counts.end();++it)
+    {
+      compteams.push_back(it->first);
+      compcounts.push_back(it->second);
+    }
+    compstart.push_back(compteams.size());
+  }
+}
+
+void Trainer::train(int iterations)
+{
+  unsigned int numteams=this->getTeamCount();
+  unsigned int numcomps=compwinner.size();
+  strengths.resize(numteams);
+  sums.resize(numteams);
+  totals.resize(numcomps);
+  likelihoods.resize(numcomps);
+
+  for (int i=0;i<iterations;i++)
+  {
+    for (unsigned int g=0;g<groups.size();g++)
+    {
+      this->runStage(Trainer::STRENGTHS);
+      this->runStage(Trainer::TOTALS);
+      this->runStage(Trainer::SUMS);
+
+      if (g==0)
+      {
+        loglikelihood=0;
+        for (unsigned int j=0;j<numcomps;j++)
+          loglikelihood+=likelihoods[j];
+        fprintf(stderr,"[train] iteration %d: log-likelihood %.4f (%.4f per competition)\n",i+1,loglikelihood,(numcomps>0?loglikelihood/numcomps:0));
+      }
+
+      this->updateGroup(groups[g]);
+    }
+  }
+
+  strengths.clear();
+  sums.clear();
+  totals.clear();
+  likelihoods.clear();
+}
+
+void Trainer::strengthsThread(Worker::Settings *settings)
+{
+  unsigned int numteams=this->getTeamCount();
+  int id=settings->thread->getID();
+  int n=pool->getSize();
+  unsigned int start=(unsigned int)((unsigned long)numteams*id/n);
+  unsigned int end=(unsigned int)((unsigned long)numteams*(id+1)/n);
+
+  for (unsigned int t=start;t<end;t++)
+  {
+    double s=1.0;
+    for (unsigned int k=teamstart[t];k<teamstart[t+1];k++)
+      s*=gammas[teamfeatures[k]];
+    strengths[t]=s;
+  }
+}
+
+void Trainer::totalsThread(Worker::Settings *settings)
+{
+  unsigned int numcomps=compwinner.size();
+  int id=settings->thread->getID();
+  int n=pool->getSize();
+  unsigned int start=(unsigned int)((unsigned long)numcomps*id/n);
+  unsigned int end=(unsigned int)((unsigned long)numcomps*(id+1)/n);
+
+  for (unsigned int j=start;j<end;j++)
+  {
+    double total=0;
+    for (unsigned int k=compstart[j];k<compstart[j+1];k++)
+      total+=compcounts[k]*strengths[compteams[k]];
+    totals[j]=total;
+    likelihoods[j]=log(strengths[compwinner[j]]/total);
+  }
+}
+
+void Trainer::sumsThread(Worker::Settings *settings)
+{
+  unsigned int numteams=this->getTeamCount();
+  int id=settings->thread->getID();
+  int n=pool->getSize();
+  unsigned int start=(unsigned int)((unsigned long)numteams*id/n);
+  unsigned int end=(unsigned int)((unsigned long)numteams*(id+1)/n);
+
+  //the sum over the competitions, of the number of times a team takes part divided by the total strength
+  //each team is summed by one thread in the order of the competitions, so the result doesn't depend on the number of threads
+  for (unsigned int t=start;t<end;t++)
+  {
+    double sum=0;
+    for (unsigned int k=teamcompstart[t];k<teamcompstart[t+1];k++)
+      sum+=teamcompcounts[k]/totals[teamcomps[k]];
+    sums[t]=sum;
+  }
+}
+
+void Trainer::updateGroup(const Trainer::Group &group)
+{
+  unsigned int numteams=this->getTeamCount();
+  std::vector<double> denominators(group.last-group.first+1,0);
+
+  for (unsigned int t=0;t<numteams;t++)
+  {
+    for (unsigned int k=teamstart[t];k<teamstart[t+1];k++)
+    {
+      unsigned int f=teamfeatures[k];
+      if (f>=group.first && f<=group.last)
+        denominators[f-group.first]+=sums[t]*strengths[t]/gammas[f];
+    }
+  }
+
+  //a prior of one win and one loss against a virtual opponent with a gamma of 1 keeps the gammas finite
+  for (unsigned int f=group.first;f<=group.last;f++)
+    gammas[f]=(wins[f]+1)/(denominators[f-group.first]+2/(gammas[f]+1));
+}
+
+bool Trainer::saveGammaFile(std::string filename) const
+{
+  std::ofstream fout(filename.c_str());
+
+  if (!fout)
+    return false;
+
+  for (unsigned int i=0;i<names.size();i++)
+    fout<<names[i]<<" "<<gammas[i]<<"\n";
+  fout.close();
+
+  return true;
+}
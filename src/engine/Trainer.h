@@ -0,0 +1,107 @@
+#ifndef DEF_OAKFOAM_TRAINER_H
+#define DEF_OAKFOAM_TRAINER_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <boost/thread/mutex.hpp>
+#include "Go.h"
+//from "Parameters.h":
+class Parameters;
+//from "Features.h":
+class Features;
+//from "Worker.h":
+namespace Worker
+{
+  class Settings;
+  class Pool;
+};
+
+/** Training of feature gammas.
+ * Each training position is a competition between the move played and all the other legal moves,
+ * where the strength of a move is the product of the gammas of its features.
+ * The gammas are fitted with minorization-maximization, see:
+ * R. Coulom, "Computing Elo Ratings of Move Patterns in the Game of Go", 2007.
+ * Both the extraction of competitions from the games and the MM updates are shared between the worker threads.
+ */
+class Trainer
+{
+  public:
+    /** Create a trainer for the features with ids from Features::getFeatureIdList(). */
+    Trainer(Parameters *prms, Features *feat, Worker::Pool *pool);
+    ~Trainer();
+
+    /** Extract the competitions from a list of SGF games.
+     * Games that can't be read are skipped with a warning.
+     */
+    void extractCompetitions(std::vector<std::string> games);
+    /** Run a number of MM iterations over all the feature groups. */
+    void train(int iterations);
+    /** Save the trained gammas in the format of Features::loadGammaFile(). */
+    bool saveGammaFile(std::string filename) const;
+
+    /** Get the number of competitions extracted. */
+    unsigned int getCompetitionCount() const { return compwinner.size(); };
+    /** Get the number of distinct sets of features amongst all the moves. */
+    unsigned int getTeamCount() const { return teamstart.size()-1; };
+    /** Get the log-likelihood of the played moves, as computed by the last iteration. */
+    double getLogLikelihood() const { return loglikelihood; };
+
+    /** Do a share of the current stage of work for a worker thread. */
+    void doThreadWork(Worker::Settings *settings);
+
+  private:
+    enum Stage
+    {
+      EXTRACT,
+      STRENGTHS,
+      TOTALS,
+      SUMS
+    };
+
+    struct Group
+    {
+      std::string name;
+      unsigned int first,last;
+    };
+    /** The teams of one position, the first is the move played. */
+    typedef std::vector< std::vector<unsigned int> > Competition;
+
+    Parameters *const params;
+    Features *const features;
+    Worker::Pool *const pool;
+
+    Trainer::Stage stage;
+    std::vector<std::string> names;
+    std::vector<Trainer::Group> groups;
+    std::vector<double> gammas;
+    std::vector<double> wins;
+
+    std::vector<unsigned int> teamstart,teamfeatures;
+    std::map<std::vector<unsigned int>,unsigned int> teamindex;
+    std::vector<unsigned int> compstart,compteams,compcounts,compwinner;
+
+    std::vector<std::string> games;
+    unsigned int nextgame,nextaddgame;
+    std::map<unsigned int,std::list<Trainer::Competition> > pendinggames;
+    boost::mutex datamutex;
+
+    //the competitions each team takes part in, in the order of the competitions
+    std::vector<unsigned int> teamcompstart,teamcomps,teamcompcounts;
+
+    std::vector<double> strengths;
+    std::vector<double> totals,likelihoods,sums;
+    double loglikelihood;
+
+    void runStage(Trainer::Stage s);
+    void extractThread(Worker::Settings *settings);
+    void strengthsThread(Worker::Settings *settings);
+    void totalsThread(Worker::Settings *settings);
+    void sumsThread(Worker::Settings *settings);
+    void updateGroup(const Trainer::Group &group);
+    unsigned int addTeam(const std::vector<unsigned int> &team);
+    void addCompetitions(const std::list<Trainer::Competition> &comps);
+};
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <sstream>
+#include <algorithm>
 #include "Parameters.h"
 #include "Engine.h"
 #include "Pattern.h"
@@ -52,6 +53,10 @@ Tree::Tree(Parameters *prms, Go::ZobristHash h, Go::Move mov, Tree *p) : params(
   decayedwins=0;
   decayedplayouts=0;
   unprunednum=0;
+  robustchild=NULL;
+  secondrobustchild=NULL;
+  poolstale.store(false,boost::memory_order_relaxed);
+  poolbuilding.store(false,boost::memory_order_relaxed);
   
   #ifdef HAVE_MPI
     this->resetMpiDiff();
@@ -86,6 +91,7 @@ void Tree::addChild(Tree *node)
   
   children->push_back(node);
   node->parent=this;
+  this->invalidatePoolRAVE();
 }
 
 float Tree::getScoreMean() const
@@ -370,6 +376,8 @@ void Tree::addPartialResult(float win, float playout, bool invertwin)
     delete lock;
   if (!this->isRoot())
   {
+    if (playout!=0)
+      parent->updateRobustChildren(this);
     if (invertwin)
       parent->addPartialResult(-win,playout,invertwin);
     else
@@ -413,7 +421,50 @@ bool Tree::hasOneUnprunedChildNotTerminalLoss()
   return false;
 }
 
+void Tree::addBatchResult(float batchwins, float batchplayouts, float batchscoresum, float batchscoresumsq, Tree *source)
+{
+  boost::mutex::scoped_lock *lock=(params->uct_lock_free?NULL:new boost::mutex::scoped_lock(updatemutex));
+  
+  wins+=batchwins;
+  playouts+=batchplayouts;
+  scoresum+=batchscoresum;
+  scoresumsq+=batchscoresumsq;
+  if (params->uct_decay_alpha!=1 || params->uct_decay_k!=0)
+  {
+    float batchratio=batchwins/batchplayouts;
+    for (int i=0;i<(int)batchplayouts;i++)
+      this->addDecayResult(batchratio);
+  }
+  
+  if (lock!=NULL)
+    delete lock;
+  
+  this->updateTerminalResult((batchwins*2)>batchplayouts,source);
+  //assume alternating colours going up
+  if (!this->isRoot())
+  {
+    parent->updateRobustChildren(this);
+    parent->addBatchResult(batchplayouts-batchwins,batchplayouts,batchscoresum,batchscoresumsq,this);
+  }
+  this->checkForUnPruning();
+}
+
 void Tree::passPlayoutUp(int fscore, bool win, Tree *source)
+{
+  this->updateTerminalResult(win,source);
+  
+  if (!this->isRoot())
+  {
+    parent->updateRobustChildren(this);
+    //assume alternating colours going up
+    if (win)
+      parent->addLose(fscore,this);
+    else
+      parent->addWin(fscore,this);
+  }
+}
+
+void Tree::updateTerminalResult(bool win, Tree *source)
 {
   if (params->uct_terminal_handling)
   {
@@ -450,15 +501,6 @@ void Tree::passPlayoutUp(int fscore, bool win, Tree *source)
     hasTerminalWin=win;
     hasTerminalWinrate=true;
   }
-  
-  if (!this->isRoot())
-  {
-    //assume alternating colours going up
-    if (win)
-      parent->addLose(fscore,this);
-    else
-      parent->addWin(fscore,this);
-  }
 }
 
 float Tree::getVal(bool skiprave) const
@@ -570,8 +612,14 @@ bool Tree::isTerminal() const
 
 void Tree::divorceChild(Tree *child)
 {
+  if (child==robustchild || child==secondrobustchild)
+  {
+    robustchild=NULL;
+    secondrobustchild=NULL;
+  }
   children->remove(child);
   child->parent=NULL;
+  this->invalidatePoolRAVE();
 }
 
 float Tree::variance(int wins, int playouts)
@@ -1012,6 +1060,21 @@ void Tree::allowContinuedPlay()
 }
 
 Tree *Tree::getRobustChild(bool descend) const
+{
+  Tree *besttree=robustchild;
+  if (besttree==NULL || besttree->isTerminalLose() || besttree->isSuperkoViolation())
+    besttree=this->findRobustChild();
+  
+  if (besttree==NULL)
+    return NULL;
+  
+  if (besttree->isLeaf() || !descend)
+    return besttree;
+  else
+    return besttree->getRobustChild(descend);
+}
+
+Tree *Tree::findRobustChild() const
 {
   float bestsims=0;
   Tree *besttree=NULL;
@@ -1027,13 +1090,52 @@ Tree *Tree::getRobustChild(bool descend) const
     }
   }
   
-  if (besttree==NULL)
-    return NULL;
+  return besttree;
+}
+
+void Tree::updateRobustChildren(Tree *child)
+{
+  boost::mutex::scoped_lock lock(updatemutex,boost::defer_lock);
+  if (!params->uct_lock_free)
+    lock.lock();
   
-  if (besttree->isLeaf() || !descend)
-    return besttree;
+  bool rescan=false;
+  if (robustchild==NULL)
+    rescan=true;
+  else if (child==robustchild)
+  {
+    //the robust child can only lose its place by becoming invalid or being reset
+    if (child->isTerminalLose() || child->isSuperkoViolation() || (secondrobustchild!=NULL && secondrobustchild->getPlayouts()>child->getPlayouts()))
+      rescan=true;
+  }
+  else if (child->isTerminalLose() || child->isSuperkoViolation())
+  {
+    //an invalid child can't stay the second robust child
+    if (child==secondrobustchild)
+      rescan=true;
+  }
   else
-    return besttree->getRobustChild(descend);
+  {
+    if (!robustchild->isTerminalWin() && (child->isTerminalWin() || child->getPlayouts()>robustchild->getPlayouts()))
+    {
+      secondrobustchild=robustchild;
+      robustchild=child;
+    }
+    else if (child!=secondrobustchild && (secondrobustchild==NULL || child->getPlayouts()>secondrobustchild->getPlayouts()))
+      secondrobustchild=child;
+  }
+  
+  if (rescan)
+  {
+    secondrobustchild=NULL;
+    robustchild=this->findRobustChild();
+    if (robustchild!=NULL)
+    {
+      Tree *second=this->getSecondRobustChild(robustchild);
+      if (second!=NULL && !second->isTerminalLose() && !second->isSuperkoViolation())
+        secondrobustchild=second;
+    }
+  }
 }
 
 Tree *Tree::getUrgentChild(Worker::Settings *settings)
@@ -1300,8 +1402,8 @@ bool Tree::expandLeaf(Worker::Settings *settings)
 
     if (params->uct_atari_prior>0)
     {
-      std::ourset<Go::Group*> *groups=startboard->getGroups();
-      for(std::ourset<Go::Group*>::iterator iter=groups->begin();iter!=groups->end();++iter) 
+      Go::group_set *groups=startboard->getGroups();
+      for(Go::group_set::iterator iter=groups->begin();iter!=groups->end();++iter) 
       {
         if ((*iter)->inAtari())
         {
@@ -1349,6 +1451,8 @@ bool Tree::expandLeaf(Worker::Settings *settings)
     Go::ObjectBoard<int> *cfglastdist=NULL;
     Go::ObjectBoard<int> *cfgsecondlastdist=NULL;
     params->engine->getFeatures()->computeCFGDist(startboard,&cfglastdist,&cfgsecondlastdist);
+    Go::ObjectBoard<float> *gammas=new Go::ObjectBoard<float>(startboard->getSize());
+    params->engine->getFeatures()->getBoardGammas(startboard,cfglastdist,cfgsecondlastdist,col,gammas);
 
     //int now_unpruned=this->getUnprunedNum();
     //fprintf(stderr,"debugging %d\n",now_unpruned);
@@ -1356,13 +1460,21 @@ bool Tree::expandLeaf(Worker::Settings *settings)
     {
       if ((*iter)->isPrimary())
       {
-        float gamma=params->engine->getFeatures()->getMoveGamma(startboard,cfglastdist,cfgsecondlastdist,(*iter)->getMove(),true,true);
+        Go::Move move=(*iter)->getMove();
+        float gamma;
+        if (move.isPass())
+          gamma=gammas->get(0);
+        else if (move.isNormal())
+          gamma=gammas->get(move.getPosition());
+        else
+          gamma=params->engine->getFeatures()->getMoveGamma(startboard,cfglastdist,cfgsecondlastdist,move,true,true);
         (*iter)->setFeatureGamma(gamma);
         //if ((*iter)->getMove().toString(params->board_size).compare("B:E1")==0)
         //  fprintf(stderr,"move %s %f\n",(*iter)->getMove().toString(params->board_size).c_str(),gamma);
       }
     }
     
+    delete gammas;
     if (cfglastdist!=NULL)
       delete cfglastdist;
     if (cfgsecondlastdist!=NULL)
@@ -1381,6 +1493,7 @@ bool Tree::expandLeaf(Worker::Settings *settings)
   }
   
   beenexpanded=true;
+  this->invalidatePoolRAVE();
   delete startboard;
   expandmutex.unlock();
   return true;
@@ -1561,6 +1674,9 @@ Tree *Tree::getSecondRobustChild(const Tree *firstchild) const
 {
   if (firstchild==NULL)
     firstchild=this->getRobustChild();
+  Tree *second=secondrobustchild;
+  if (firstchild!=NULL && firstchild==robustchild && second!=NULL && !second->isTerminalLose() && !second->isSuperkoViolation())
+    return second;
   
   Tree *besttree=NULL;
   float bestsims=0;
@@ -1770,10 +1886,84 @@ void Tree::resetNode()
   hasTerminalWin=false;
   decayedwins=0;
   decayedplayouts=0;
+  this->invalidatePoolRAVE();
   
   #ifdef HAVE_MPI
     this->resetMpiDiff();
   #endif
+  
+  if (!this->isRoot())
+    parent->updateRobustChildren(this);
+}
+
+boost::shared_ptr<const Tree::PoolRAVECache> Tree::getPoolRAVE(int k)
+{
+  boost::shared_ptr<const Tree::PoolRAVECache> cache=boost::atomic_load(&poolcache);
+  if (cache && !poolstale.load(boost::memory_order_relaxed) && cache->k==k && playouts<=cache->playouts*(1+params->playout_poolrave_refresh))
+    return cache;
+  
+  //only one thread rebuilds the pools, the others keep using the old snapshot meanwhile
+  if (cache && poolbuilding.exchange(true,boost::memory_order_acquire))
+    return cache;
+  
+  //clear the flag before reading the children, so that a child added during the rebuild marks the new snapshot stale again
+  poolstale.store(false,boost::memory_order_relaxed);
+  cache=this->buildPoolRAVE(k);
+  boost::atomic_store(&poolcache,cache);
+  poolbuilding.store(false,boost::memory_order_release);
+  return cache;
+}
+
+boost::shared_ptr<const Tree::PoolRAVECache> Tree::buildPoolRAVE(int k) const
+{
+  std::vector<Tree::PoolCandidate> rave,raveother,crit;
+  Go::Color col=Go::EMPTY;
+  
+  int order=0;
+  for(std::list<Tree*>::iterator iter=children->begin();iter!=children->end();++iter,order++) 
+  {
+    if ((*iter)->getMove().isPass())
+      continue;
+    int pos=(*iter)->getMove().getPosition();
+    Tree::PoolCandidate c;
+    c.order=order;
+    c.pos=pos;
+    c.value=(*iter)->getRAVERatioForPool();
+    if (c.value>-1) // accept any values
+    {
+      rave.push_back(c);
+      col=(*iter)->getMove().getColor();
+    }
+    c.value=(*iter)->getRAVERatioOtherForPool();
+    if (c.value>-1)
+      raveother.push_back(c);
+    c.value=(*iter)->getCriticality();
+    if (c.value>-1)
+      crit.push_back(c);
+  }
+  
+  Tree::PoolRAVECache *cache=new Tree::PoolRAVECache();
+  Tree::selectPool(rave,k,cache->pool);
+  Tree::selectPool(raveother,k,cache->poolother);
+  Tree::selectPool(crit,k,cache->poolcrit);
+  cache->col=(cache->pool.size()>0?col:Go::EMPTY);
+  cache->k=k;
+  cache->playouts=playouts;
+  return boost::shared_ptr<const Tree::PoolRAVECache>(cache);
+}
+
+void Tree::selectPool(std::vector<Tree::PoolCandidate> &candidates, int k, std::vector<int> &pool)
+{
+  int n=((int)candidates.size()<k?candidates.size():k);
+  std::partial_sort(candidates.begin(),candidates.begin()+n,candidates.end());
+  pool.clear();
+  for (int i=0;i<n;i++)
+    pool.push_back(candidates[i].pos);
+}
+
+void Tree::invalidatePoolRAVE()
+{
+  poolstale.store(true,boost::memory_order_relaxed);
 }
 
 #ifdef HAVE_MPI
@@ -1789,6 +1979,8 @@ void Tree::addMpiDiff(float plts, float wns)
   playouts+=plts;
   wins+=wns;
   this->resetMpiDiff();
+  if (!this->isRoot())
+    parent->updateRobustChildren(this);
   if (!this->isRoot() && parent->isRoot())
     parent->addMpiDiff(plts,plts-wns);
 }
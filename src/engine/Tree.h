@@ -7,7 +7,10 @@
 #include "config.h"
 #include <list>
 #include <string>
+#include <vector>
 #include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
 #include "Go.h"
 //from "Parameters.h":
 class Parameters;
@@ -135,6 +138,24 @@ class Tree
     float getRAVERatioForPool() const;
     /** Get the ratio of RAVE wins to playouts for the other color used for poolRAVE (excluding any initial wins). */
     float getRAVERatioOtherForPool() const;
+    /** PoolRAVE pools of a node's children. */
+    struct PoolRAVECache
+    {
+      /** Size the pools were built with. */
+      int k;
+      /** Playouts through the node when the pools were built. */
+      float playouts;
+      /** Color of the moves in pool, or EMPTY if it is empty. */
+      Go::Color col;
+      /** Children with the best RAVE ratios, the best RAVE ratios for the other color and the highest criticality. */
+      std::vector<int> pool,poolother,poolcrit;
+    };
+    /** Get the poolRAVE pools of this node's children.
+     * The pools are an immutable snapshot that is only rebuilt once the playouts through this node have grown by playout_poolrave_refresh.
+     * The snapshot stays valid for as long as the returned pointer is held.
+     * @param k  Size of the pools.
+     */
+    boost::shared_ptr<const Tree::PoolRAVECache> getPoolRAVE(int k);
     /** Get the value for this node.
      * This is a combination of normal and RAVE values.
      */
@@ -157,6 +178,14 @@ class Tree
      * @param source The child that this result is coming from.
      */
     void addLose(int fscore, Tree *source=NULL);
+    /** Add the aggregated results of a batch of playouts to this node.
+     * @param batchwins       The number of wins in the batch, for this node's color.
+     * @param batchplayouts   The number of playouts in the batch.
+     * @param batchscoresum   The sum of the final scores of the batch.
+     * @param batchscoresumsq The sum of the squared final scores of the batch.
+     * @param source          The child that this result is coming from.
+     */
+    void addBatchResult(float batchwins, float batchplayouts, float batchscoresum, float batchscoresumsq, Tree *source=NULL);
     /** Add a virtual loss. */
     void addVirtualLoss();
     /** Remove a virtual loss from this node and the path up to the root. */
@@ -193,6 +222,7 @@ class Tree
     bool expandLeaf(Worker::Settings *settings);
     /** Get this robust child of this node.
      * The robust child is the child with the most playouts through it.
+     * The two most robust children are tracked as results are backed up, so this is normally O(1).
      * @param descend If set, descend down the tree to a leaf node, picking the robust child at each node.
      */
     Tree *getRobustChild(bool descend=false) const;
@@ -306,13 +336,39 @@ class Tree
     bool superkoprunedchildren,superkoviolation,superkochecked;
     int superkochildrenviolations;
     Go::ZobristHash hash;
+    Tree *robustchild,*secondrobustchild;
     boost::mutex expandmutex,updatemutex,unprunemutex,superkomutex;
     
+    /** Snapshot of the poolRAVE pools, only built for nodes used as a pool source.
+     * The pointer is only accessed with boost::atomic_load() and boost::atomic_store().
+     */
+    boost::shared_ptr<const Tree::PoolRAVECache> poolcache;
+    /** Set when the children have changed since poolcache was built. */
+    boost::atomic<bool> poolstale;
+    /** Set while a thread is rebuilding poolcache. */
+    boost::atomic<bool> poolbuilding;
+    /** Candidate for a poolRAVE pool. */
+    struct PoolCandidate
+    {
+      float value;
+      int order;
+      int pos;
+      
+      //higher values first, earlier children win ties
+      bool operator<(const Tree::PoolCandidate &other) const { return (value>other.value || (value==other.value && order<other.order)); };
+    };
+    
     #ifdef HAVE_MPI
       float mpi_lastplayouts,mpi_lastwins;
     #endif
     
     void passPlayoutUp(int fscore, bool win, Tree *source);
+    void updateTerminalResult(bool win, Tree *source);
+    Tree *findRobustChild() const;
+    void updateRobustChildren(Tree *child);
+    boost::shared_ptr<const Tree::PoolRAVECache> buildPoolRAVE(int k) const;
+    static void selectPool(std::vector<Tree::PoolCandidate> &candidates, int k, std::vector<int> &pool);
+    void invalidatePoolRAVE();
     bool allChildrenTerminalLoses();
     bool hasOneUnprunedChildNotTerminalLoss();
     
@@ -5,8 +5,9 @@
 #include "Engine.h"
 #include "Parameters.h"
 #include "Random.h"
+#include "Playout.h"
 
-Worker::Thread::Thread(int i, Engine *eng)
+Worker::Thread::Thread(int i, Engine *eng, unsigned long seed)
   : id(i),
     engine(eng),
     settings(new Worker::Settings()),
@@ -17,7 +18,10 @@ Worker::Thread::Thread(int i, Engine *eng)
     thisthread(Worker::Thread::Functional(this))
 {
   settings->thread=this;
-  settings->rand=new Random(0,id);
+  settings->rand=new Random(seed,id);
+  settings->lgrfbuffer=new PlayoutLGRFBuffer();
+  settings->playoutscratch=new PlayoutScratch();
+  settings->trace=new PlayoutTrace();
 }
 
 Worker::Thread::~Thread()
@@ -28,6 +32,9 @@ Worker::Thread::~Thread()
   runbarrier.wait();
   thisthread.join();
   delete settings->rand;
+  delete settings->lgrfbuffer;
+  delete settings->playoutscratch;
+  delete settings->trace;
   delete settings;
 }
 
@@ -76,7 +83,7 @@ Worker::Pool::Pool(Parameters *prms)
 {
   for(int i=0;i<size;i++)
   {
-    threads.push_back(new Worker::Thread(i,params->engine));
+    threads.push_back(new Worker::Thread(i,params->engine,params->rand_seed));
   }
 }
 
@@ -88,6 +95,16 @@ Worker::Pool::~Pool()
   }
 }
 
+Worker::Thread *Worker::Pool::getThread(int id) const
+{
+  for(std::list<Worker::Thread*>::const_iterator iter=threads.begin();iter!=threads.end();++iter) 
+  {
+    if ((*iter)->getID()==id)
+      return (*iter);
+  }
+  return NULL;
+}
+
 void Worker::Pool::startAll()
 {
   for(std::list<Worker::Thread*>::iterator iter=threads.begin();iter!=threads.end();++iter) 
@@ -13,6 +13,10 @@ class Engine;
 class Parameters;
 //from "Random.h":
 class Random;
+//from "Playout.h":
+class PlayoutLGRFBuffer;
+class PlayoutScratch;
+class PlayoutTrace;
 
 /** Worker thread management. */
 namespace Worker
@@ -27,14 +31,20 @@ namespace Worker
       Worker::Thread *thread;
       /** The random number generator for this thread. */
       Random *rand;
+      /** Playout results of this thread still to be merged into the LGRF tables. */
+      PlayoutLGRFBuffer *lgrfbuffer;
+      /** Scratch space for the playouts of this thread. */
+      PlayoutScratch *playoutscratch;
+      /** Trace of the sampled playouts of this thread. */
+      PlayoutTrace *trace;
   };
   
   /** Worker thread. */
   class Thread
   {
     public:
-      /** Create a worker thread. */
-      Thread(int i, Engine *eng);
+      /** Create a worker thread, with its own random stream for the given seed. */
+      Thread(int i, Engine *eng, unsigned long seed);
       ~Thread();
       
       /** Get the worker ID. */
@@ -90,6 +100,8 @@ namespace Worker
       int getSize() const { return size; };
       /** Get the first worker. */
       Worker::Thread *getThreadZero() const { return threads.front(); };
+      /** Get the worker with the given ID. */
+      Worker::Thread *getThread(int id) const;
       
       /** Start all the workers in this pool. */
       void startAll();